@@ -12,6 +12,7 @@
 #include "ConcurrentContainers.h"
 #include "MethodOverrideGraph.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -273,17 +274,34 @@ Edge::Edge(NodeId caller, NodeId callee, const IRList::iterator& invoke_it)
       m_callee(std::move(callee)),
       m_invoke_it(invoke_it) {}
 
-Graph::Graph(const BuildStrategy& strat)
-    : m_entry(std::make_shared<Node>(Node::GHOST_ENTRY)),
-      m_exit(std::make_shared<Node>(Node::GHOST_EXIT)) {
+Graph::Graph(const BuildStrategy& strat) {
+  // Nodes are identified by their index while the graph is being built; the
+  // first two are the ghost entry and exit nodes.
+  std::vector<const DexMethod*> methods{nullptr, nullptr};
+  std::unordered_map<const DexMethod*, uint32_t> method_indices;
+  auto make_node = [&](const DexMethod* m) {
+    auto it = method_indices.find(m);
+    if (it != method_indices.end()) {
+      return it->second;
+    }
+    auto index = static_cast<uint32_t>(methods.size());
+    method_indices.emplace(m, index);
+    methods.push_back(m);
+    return index;
+  };
+
+  struct EdgeInfo {
+    uint32_t caller;
+    uint32_t callee;
+    IRList::iterator invoke_it;
+  };
+  std::vector<EdgeInfo> edge_infos;
+
   // Add edges from the single "ghost" entry node to all the "real" entry
   // nodes in the graph.
   auto roots = strat.get_roots();
   for (const DexMethod* root : roots) {
-    auto edge =
-        std::make_shared<Edge>(m_entry, make_node(root), IRList::iterator());
-    m_entry->m_successors.emplace_back(edge);
-    make_node(root)->m_predecessors.emplace_back(edge);
+    edge_infos.push_back({ENTRY_INDEX, make_node(root), IRList::iterator()});
   }
 
   // Obtain the callsites of each method recursively, building the graph in the
@@ -297,11 +315,12 @@ Graph::Graph(const BuildStrategy& strat)
       visited.emplace(caller);
       auto callsites = strat.get_callsites(caller);
       if (callsites.empty()) {
-        this->add_edge(make_node(caller), m_exit, IRList::iterator());
+        edge_infos.push_back(
+            {make_node(caller), EXIT_INDEX, IRList::iterator()});
       }
       for (const auto& callsite : callsites) {
-        this->add_edge(
-            make_node(caller), make_node(callsite.callee), callsite.invoke);
+        edge_infos.push_back(
+            {make_node(caller), make_node(callsite.callee), callsite.invoke});
         visit_fn(callsite.callee, visit_fn);
       }
     };
@@ -311,23 +330,59 @@ Graph::Graph(const BuildStrategy& strat)
   for (const DexMethod* root : roots) {
     visit(root);
   }
-}
 
-NodeId Graph::make_node(const DexMethod* m) {
-  auto it = m_nodes.find(m);
-  if (it != m_nodes.end()) {
-    return it->second;
+  auto storage = std::make_shared<Storage>();
+  auto& nodes = storage->nodes;
+  nodes.reserve(methods.size());
+  nodes.emplace_back(Node::GHOST_ENTRY);
+  nodes.emplace_back(Node::GHOST_EXIT);
+  for (size_t i = EXIT_INDEX + 1; i < methods.size(); ++i) {
+    nodes.emplace_back(methods[i]);
+    storage->method_to_node.emplace(methods[i], &nodes[i]);
   }
-  m_nodes.emplace(m, std::make_shared<Node>(m));
-  return m_nodes.at(m);
-}
 
-void Graph::add_edge(const NodeId& caller,
-                     const NodeId& callee,
-                     const IRList::iterator& invoke_it) {
-  auto edge = std::make_shared<Edge>(caller, callee, invoke_it);
-  caller->m_successors.emplace_back(edge);
-  callee->m_predecessors.emplace_back(edge);
+  auto& edges = storage->edges;
+  edges.reserve(edge_infos.size());
+  for (const auto& info : edge_infos) {
+    edges.emplace_back(&nodes[info.caller], &nodes[info.callee],
+                       info.invoke_it);
+  }
+
+  // Lay out the successor and predecessor arrays with a stable counting sort
+  // on the caller and callee index respectively. Both arrays are independent,
+  // so we build them in parallel.
+  auto build_edge_array = [&](bool by_caller) {
+    auto& sorted = by_caller ? storage->successors : storage->predecessors;
+    auto node_index = [by_caller](const EdgeInfo& info) {
+      return by_caller ? info.caller : info.callee;
+    };
+    std::vector<uint32_t> offsets(nodes.size() + 1, 0);
+    for (const auto& info : edge_infos) {
+      ++offsets[node_index(info) + 1];
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+      offsets[i] += offsets[i - 1];
+    }
+    sorted.resize(edges.size());
+    std::vector<uint32_t> positions(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < edge_infos.size(); ++i) {
+      sorted[positions[node_index(edge_infos[i])]++] = &edges[i];
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      Edges range(sorted.data() + offsets[i], sorted.data() + offsets[i + 1]);
+      if (by_caller) {
+        nodes[i].m_successors = range;
+      } else {
+        nodes[i].m_predecessors = range;
+      }
+    }
+  };
+  auto wq = workqueue_foreach<bool>(build_edge_array, 2);
+  wq.add_item(true);
+  wq.add_item(false);
+  wq.run_all();
+
+  m_storage = std::move(storage);
 }
 
 std::unordered_set<const DexMethod*> resolve_callees_in_graph(
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "DexClass.h"
 #include "IRCode.h"
@@ -69,9 +71,38 @@ class BuildStrategy {
   virtual CallSites get_callsites(const DexMethod*) const = 0;
 };
 
+class Node;
 class Edge;
-using EdgeId = std::shared_ptr<Edge>;
-using Edges = std::vector<std::shared_ptr<Edge>>;
+using NodeId = const Node*;
+using EdgeId = const Edge*;
+
+/*
+ * A contiguous range of edges, pointing into the compact edge arrays owned by
+ * the graph.
+ */
+class Edges {
+ public:
+  using iterator = const EdgeId*;
+  using const_iterator = const EdgeId*;
+  using value_type = EdgeId;
+
+  Edges() = default;
+  Edges(const EdgeId* begin, const EdgeId* end) : m_begin(begin), m_end(end) {}
+
+  iterator begin() const { return m_begin; }
+  iterator end() const { return m_end; }
+  size_t size() const { return m_end - m_begin; }
+  bool empty() const { return m_begin == m_end; }
+  EdgeId operator[](size_t i) const { return m_begin[i]; }
+
+  operator std::vector<EdgeId>() const {
+    return std::vector<EdgeId>(m_begin, m_end);
+  }
+
+ private:
+  const EdgeId* m_begin{nullptr};
+  const EdgeId* m_end{nullptr};
+};
 
 class Node {
   enum NodeType {
@@ -89,8 +120,8 @@ class Node {
   const Edges& callers() const { return m_predecessors; }
   const Edges& callees() const { return m_successors; }
 
-  bool is_entry() { return m_type == GHOST_ENTRY; }
-  bool is_exit() { return m_type == GHOST_EXIT; }
+  bool is_entry() const { return m_type == GHOST_ENTRY; }
+  bool is_exit() const { return m_type == GHOST_EXIT; }
 
  private:
   const DexMethod* m_method;
@@ -101,8 +132,6 @@ class Node {
   friend class Graph;
 };
 
-using NodeId = std::shared_ptr<Node>;
-
 class Edge {
  public:
   Edge(NodeId caller, NodeId callee, const IRList::iterator& invoke_it);
@@ -116,34 +145,49 @@ class Edge {
   IRList::iterator m_invoke_it;
 };
 
+/*
+ * Nodes and edges are stored in flat arrays, and the callers and callees of
+ * each node are contiguous slices of two edge arrays sorted by callee and
+ * caller respectively (i.e. in compressed sparse row form). The graph is
+ * immutable once built, so copies share the same storage.
+ */
 class Graph final {
  public:
   explicit Graph(const BuildStrategy&);
 
-  NodeId entry() const { return m_entry; }
-  NodeId exit() const { return m_exit; }
+  NodeId entry() const { return &m_storage->nodes[ENTRY_INDEX]; }
+  NodeId exit() const { return &m_storage->nodes[EXIT_INDEX]; }
 
   bool has_node(const DexMethod* m) const {
-    return m_nodes.count(const_cast<DexMethod*>(m)) != 0;
+    return m_storage->method_to_node.count(m) != 0;
   }
 
   NodeId node(const DexMethod* m) const {
     if (m == nullptr) {
-      return m_entry;
+      return entry();
     }
-    return m_nodes.at(m);
+    return m_storage->method_to_node.at(m);
   }
 
- private:
-  NodeId make_node(const DexMethod*);
+  size_t num_nodes() const { return m_storage->nodes.size(); }
+
+  size_t num_edges() const { return m_storage->edges.size(); }
 
-  void add_edge(const NodeId& caller,
-                const NodeId& callee,
-                const IRList::iterator& invoke_it);
+ private:
+  static constexpr size_t ENTRY_INDEX = 0;
+  static constexpr size_t EXIT_INDEX = 1;
+
+  struct Storage {
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    // Edges sorted by caller, then creation order.
+    std::vector<EdgeId> successors;
+    // Edges sorted by callee, then creation order.
+    std::vector<EdgeId> predecessors;
+    std::unordered_map<const DexMethod*, NodeId> method_to_node;
+  };
 
-  std::shared_ptr<Node> m_entry;
-  std::shared_ptr<Node> m_exit;
-  std::unordered_map<const DexMethod*, NodeId> m_nodes;
+  std::shared_ptr<const Storage> m_storage;
 };
 
 class SingleCalleeStrategy : public BuildStrategy {
@@ -193,8 +237,8 @@ class MultipleCalleeStrategy : public BuildStrategy {
 class GraphInterface {
  public:
   using Graph = call_graph::Graph;
-  using NodeId = std::shared_ptr<Node>;
-  using EdgeId = std::shared_ptr<Edge>;
+  using NodeId = call_graph::NodeId;
+  using EdgeId = call_graph::EdgeId;
 
   static NodeId entry(const Graph& graph) { return graph.entry(); }
   static NodeId exit(const Graph& graph) { return graph.exit(); }
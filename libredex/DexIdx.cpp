@@ -12,6 +12,7 @@
 #include "DexCallSite.h"
 #include "DexClass.h"
 #include "DexMethodHandle.h"
+#include "WorkQueue.h"
 
 #define INIT_DMAP_ID(TYPE, CACHETYPE)                                  \
   always_assert_log(dh->TYPE##_ids_off < dh->file_size,                \
@@ -67,6 +68,59 @@ DexIdx::~DexIdx() {
   }
 }
 
+namespace {
+
+// Large enough to amortize the work queue overhead, small enough to balance
+// the load across threads for typical dex files.
+constexpr uint32_t kDecodeChunkSize = 4096;
+
+struct DecodeChunk {
+  DexIdx* idx;
+  uint32_t begin;
+  uint32_t end;
+};
+
+template <typename Fn>
+void decode_chunks(const std::vector<DexIdx*>& idxs,
+                   uint32_t (*size_fn)(const DexIdx*),
+                   const Fn& decode) {
+  auto wq = workqueue_foreach<DecodeChunk>([&](const DecodeChunk& chunk) {
+    for (uint32_t i = chunk.begin; i < chunk.end; i++) {
+      decode(chunk.idx, i);
+    }
+  });
+  for (auto idx : idxs) {
+    uint32_t size = size_fn(idx);
+    for (uint32_t begin = 0; begin < size; begin += kDecodeChunkSize) {
+      wq.add_item({idx, begin, std::min(size, begin + kDecodeChunkSize)});
+    }
+  }
+  wq.run_all();
+}
+
+} // namespace
+
+void DexIdx::decode_all(const std::vector<DexIdx*>& idxs) {
+  // Types refer to strings, and protos to both, so the sections are decoded
+  // one after the other; each phase then only reads the caches filled by the
+  // previous ones.
+  decode_chunks(
+      idxs, [](const DexIdx* idx) { return idx->m_string_ids_size; },
+      [](DexIdx* idx, uint32_t i) {
+        idx->m_string_cache[i] = idx->get_stringidx_fromdex(i);
+      });
+  decode_chunks(
+      idxs, [](const DexIdx* idx) { return idx->m_type_ids_size; },
+      [](DexIdx* idx, uint32_t i) {
+        idx->m_type_cache[i] = idx->get_typeidx_fromdex(i);
+      });
+  decode_chunks(
+      idxs, [](const DexIdx* idx) { return idx->m_proto_ids_size; },
+      [](DexIdx* idx, uint32_t i) {
+        idx->m_proto_cache[i] = idx->get_protoidx_fromdex(i);
+      });
+}
+
 DexCallSite* DexIdx::get_callsiteidx_fromdex(uint32_t csidx) {
   redex_assert(csidx < m_callsite_ids_size);
   // callsites are indirected through the callsite_id table, because
@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <string>
+#include <vector>
 
 #include "Debug.h"
 #include "DexDefs.h"
@@ -63,6 +64,14 @@ class DexIdx {
   explicit DexIdx(const dex_header* dh);
   ~DexIdx();
 
+  /*
+   * Decodes all strings, types and protos of the given dex files up front,
+   * with the sections split into chunks that are decoded in parallel, so that
+   * loading classes afterwards mostly boils down to cache lookups. The
+   * indices must not be in use by other threads while this runs.
+   */
+  static void decode_all(const std::vector<DexIdx*>& idxs);
+
   DexString* get_stringidx(uint32_t stridx) {
     if (m_string_cache[stridx] == nullptr) {
       m_string_cache[stridx] = get_stringidx_fromdex(stridx);
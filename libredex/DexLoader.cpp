@@ -17,6 +17,7 @@
 
 #include <exception>
 #include <stdexcept>
+#include <unordered_set>
 #include <vector>
 
 DexLoader::DexLoader(const char* location)
@@ -475,19 +476,26 @@ DexClasses DexLoader::load_dex(const char* location,
   return load_dex(dh, stats);
 }
 
-DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
-  if (dh->class_defs_size == 0) {
-    return DexClasses(0);
-  }
+void DexLoader::init_dex(const dex_header* dh, DexClasses* classes) {
   m_idx = std::make_unique<DexIdx>(dh);
   auto off = (uint64_t)dh->class_defs_off;
   m_class_defs =
       reinterpret_cast<const dex_class_def*>((const uint8_t*)dh + off);
-  DexClasses classes(dh->class_defs_size);
-  m_classes = &classes;
+  classes->resize(dh->class_defs_size);
+  m_classes = classes;
+}
 
-  auto lwork = new class_load_work[dh->class_defs_size];
-  auto num_threads = redex_parallel::default_num_threads();
+DexType* DexLoader::get_class_type(int num) {
+  return m_idx->get_typeidx(m_class_defs[num].typeidx);
+}
+
+/*
+ * Runs the given class loading work, possibly across several dex files, and
+ * rethrows whatever the workers threw as an aggregate_exception. With a
+ * single thread, the work items are processed in order.
+ */
+static void run_class_load_work(std::vector<class_load_work>& work,
+                                size_t num_threads) {
   std::vector<std::vector<std::exception_ptr>> exceptions_vec(num_threads);
   auto wq = workqueue_foreach<class_load_work*>(
       [&exceptions_vec](sparta::SpartaWorkerState<class_load_work*>* state,
@@ -501,13 +509,10 @@ DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
         }
       },
       num_threads);
-  for (uint32_t i = 0; i < dh->class_defs_size; i++) {
-    lwork[i].dl = this;
-    lwork[i].num = i;
-    wq.add_item(&lwork[i]);
+  for (auto& clw : work) {
+    wq.add_item(&clw);
   }
   wq.run_all();
-  delete[] lwork;
 
   std::vector<std::exception_ptr> all_exceptions;
   for (auto& exceptions : exceptions_vec) {
@@ -519,13 +524,32 @@ DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
     aggregate_exception ae(all_exceptions);
     throw ae;
   }
+}
 
-  gather_input_stats(stats, dh);
-
-  // Remove nulls from the classes list. They may have been introduced by benign
-  // duplicate classes.
+// Remove nulls from the classes list. They may have been introduced by benign
+// duplicate classes.
+static void remove_null_classes(DexClasses& classes) {
   classes.erase(std::remove(classes.begin(), classes.end(), nullptr),
                 classes.end());
+}
+
+DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
+  if (dh->class_defs_size == 0) {
+    return DexClasses(0);
+  }
+  DexClasses classes;
+  init_dex(dh, &classes);
+  DexIdx::decode_all({m_idx.get()});
+
+  std::vector<class_load_work> work(dh->class_defs_size);
+  for (uint32_t i = 0; i < dh->class_defs_size; i++) {
+    work[i].dl = this;
+    work[i].num = i;
+  }
+  run_class_load_work(work, redex_parallel::default_num_threads());
+
+  gather_input_stats(stats, dh);
+  remove_null_classes(classes);
 
   return classes;
 }
@@ -572,6 +596,94 @@ DexClasses load_classes_from_dex(const dex_header* dh,
   return classes;
 }
 
+std::vector<DexClasses> load_classes_from_dexes(
+    const std::vector<std::string>& locations,
+    std::vector<dex_stats_t>* stats,
+    bool balloon,
+    int support_dex_version) {
+  size_t num_dexes = locations.size();
+  std::vector<std::unique_ptr<DexLoader>> loaders;
+  loaders.reserve(num_dexes);
+  for (const auto& location : locations) {
+    TRACE(MAIN, 1, "Loading classes from dex from %s", location.c_str());
+    loaders.emplace_back(std::make_unique<DexLoader>(location.c_str()));
+  }
+  std::vector<const dex_header*> headers(num_dexes);
+  std::vector<DexClasses> all_classes(num_dexes);
+  auto num_threads = redex_parallel::default_num_threads();
+
+  // Map the files and validate their headers in order, so that a bad dex file
+  // gets reported the same way as by the sequential loader.
+  for (size_t i = 0; i < num_dexes; i++) {
+    auto& dl = *loaders[i];
+    auto dh = dl.get_dex_header(locations[i].c_str());
+    validate_dex_header(dh, dl.get_file_size(), support_dex_version);
+    headers[i] = dh;
+  }
+
+  // Set up their indices, one dex file per work item.
+  auto init_wq = workqueue_foreach<size_t>(
+      [&](size_t i) { loaders[i]->init_dex(headers[i], &all_classes[i]); },
+      num_threads);
+  for (size_t i = 0; i < num_dexes; i++) {
+    init_wq.add_item(i);
+  }
+  init_wq.run_all();
+
+  std::vector<DexIdx*> idxs;
+  for (auto& dl : loaders) {
+    idxs.push_back(dl->get_idx());
+  }
+  DexIdx::decode_all(idxs);
+
+  // Among classes with the same type, the first one in the order of the
+  // locations and class definitions gets loaded. All others are loaded only
+  // after it has been published, so that they get reported as duplicates
+  // deterministically.
+  std::vector<class_load_work> work;
+  std::vector<class_load_work> duplicates;
+  std::unordered_set<const DexType*> seen;
+  for (size_t i = 0; i < num_dexes; i++) {
+    for (uint32_t num = 0; num < headers[i]->class_defs_size; num++) {
+      class_load_work clw{loaders[i].get(), (int)num};
+      if (seen.insert(loaders[i]->get_class_type(num)).second) {
+        work.push_back(clw);
+      } else {
+        duplicates.push_back(clw);
+      }
+    }
+  }
+  TRACE(MAIN, 1, "Loading %zu classes from %zu dex files", work.size(),
+        num_dexes);
+  run_class_load_work(work, num_threads);
+  run_class_load_work(duplicates, 1);
+
+  if (stats) {
+    stats->resize(num_dexes);
+  }
+  auto finish_wq = workqueue_foreach<size_t>(
+      [&](size_t i) {
+        if (stats) {
+          loaders[i]->gather_input_stats(&stats->at(i), headers[i]);
+        }
+        remove_null_classes(all_classes[i]);
+      },
+      num_threads);
+  for (size_t i = 0; i < num_dexes; i++) {
+    finish_wq.add_item(i);
+  }
+  finish_wq.run_all();
+
+  if (balloon) {
+    Scope scope;
+    for (const auto& classes : all_classes) {
+      scope.insert(scope.end(), classes.begin(), classes.end());
+    }
+    balloon_all(scope);
+  }
+  return all_classes;
+}
+
 std::string load_dex_magic_from_dex(const char* location) {
   DexLoader dl(location);
   auto dh = dl.get_dex_header(location);
@@ -30,9 +30,14 @@ class DexLoader {
                       dex_stats_t* stats,
                       int support_dex_version);
   DexClasses load_dex(const dex_header* hdr, dex_stats_t* stats);
+  // Sets up the index of the dex file, and sizes classes to hold one entry per
+  // class definition, to be filled in by load_dex_class.
+  void init_dex(const dex_header* hdr, DexClasses* classes);
+  DexType* get_class_type(int num);
   void load_dex_class(int num);
   void gather_input_stats(dex_stats_t* stats, const dex_header* dh);
   DexIdx* get_idx() { return m_idx.get(); }
+  size_t get_file_size() const { return m_file->size(); }
 };
 
 DexClasses load_classes_from_dex(const char* location,
@@ -45,6 +50,19 @@ DexClasses load_classes_from_dex(const char* location,
 DexClasses load_classes_from_dex(const dex_header* dh,
                                  const char* location,
                                  bool balloon = true);
+/*
+ * Loads the classes of several dex files with a single work queue, rather than
+ * one dex file after another. The classes of each dex file are returned in
+ * the order of the locations, just like loading them one by one would.
+ * Duplicate classes are resolved deterministically: the first definition in
+ * the order of the locations wins, and all later ones are reported as
+ * duplicates.
+ */
+std::vector<DexClasses> load_classes_from_dexes(
+    const std::vector<std::string>& locations,
+    std::vector<dex_stats_t>* stats,
+    bool balloon = true,
+    int support_dex_version = 35);
 std::string load_dex_magic_from_dex(const char* location);
 void balloon_for_test(const Scope& scope);
 
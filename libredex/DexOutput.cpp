@@ -17,6 +17,8 @@
 #include <sys/stat.h>
 #include <unordered_set>
 
+#include <boost/functional/hash.hpp>
+
 #ifdef _MSC_VER
 // TODO: Rewrite open/write/close with C/C++ standards. But it works for now.
 #include <io.h>
@@ -207,7 +209,7 @@ DexOutputIdx* GatheredTypes::get_dodx(const uint8_t* base) {
 }
 
 dexstring_to_idx* GatheredTypes::get_string_index(cmp_dstring cmp) {
-  std::sort(m_lstring.begin(), m_lstring.end(), cmp);
+  parallel_sort(m_lstring, cmp);
   dexstring_to_idx* sidx = new dexstring_to_idx();
   uint32_t idx = 0;
   for (auto it = m_lstring.begin(); it != m_lstring.end(); it++) {
@@ -657,11 +659,24 @@ void DexOutput::generate_string_data(SortMode mode) {
   std::unordered_set<DexString*> type_names = m_gtypes->index_type_names();
   unsigned locator_size = 0;
 
+  // Locators only depend on the strings, so we compute them up front, in
+  // parallel.
+  std::vector<std::unique_ptr<Locator>> string_locators(string_order.size());
+  if (m_locator_index != nullptr) {
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      string_locators[i] = locator_for_descriptor(type_names, string_order[i]);
+    });
+    for (size_t i = 0; i < string_order.size(); i++) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+  }
+
   // If we're generating locator strings, we need to include them in
   // the total count of strings in this section.
   size_t locators = 0;
-  for (DexString* str : string_order) {
-    if (locator_for_descriptor(type_names, str)) {
+  for (const auto& locator : string_locators) {
+    if (locator) {
       ++locators;
     }
   }
@@ -674,9 +689,10 @@ void DexOutput::generate_string_data(SortMode mode) {
   size_t nrstr = string_order.size() + locators;
   const uint32_t str_data_start = m_offset;
 
-  for (DexString* str : string_order) {
+  for (size_t i = 0; i < string_order.size(); i++) {
+    DexString* str = string_order[i];
     // Emit lookup acceleration string if requested
-    std::unique_ptr<Locator> locator = locator_for_descriptor(type_names, str);
+    const auto& locator = string_locators[i];
     if (locator) {
       unsigned orig_offset = m_offset;
       emit_locator(*locator);
@@ -928,6 +944,30 @@ static void sync_all(const Scope& scope) {
   wq.run_all();
 }
 
+namespace {
+
+// An upper bound of the number of bytes DexCode::encode writes.
+size_t get_code_item_size_bound(const DexCode* code) {
+  size_t insns_units = 0;
+  for (const auto& opc : code->get_instructions()) {
+    size_t units = opc->size();
+    // The size of the largest possible payloads doesn't fit into 16 bits.
+    insns_units += units != 0 ? units : 0x10000;
+  }
+  // One more code unit for the padding before the tries.
+  size_t bound = sizeof(dex_code_item) + (insns_units + 1) * sizeof(uint16_t);
+  const auto& tries = code->get_tries();
+  // The number of handlers, and for each handler its size, and the type and
+  // address of each catch, as LEB128s of at most five bytes each.
+  bound += tries.size() * sizeof(dex_tries_item) + 5;
+  for (const auto& dextry : tries) {
+    bound += 5 + dextry->m_catches.size() * 10;
+  }
+  return bound;
+}
+
+} // namespace
+
 void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
   TRACE(MAIN, 2, "generate_code_items");
   /*
@@ -969,26 +1009,55 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
       break;
     }
   }
+  std::vector<DexMethod*> code_methods;
   for (DexMethod* meth : lmeth) {
     if (meth->get_access() & (ACC_ABSTRACT | ACC_NATIVE)) {
       // There is no code item for ABSTRACT or NATIVE methods.
       continue;
     }
-    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
-          SHOW(meth));
-    DexCode* code = meth->get_dex_code();
     always_assert_log(
-        meth->is_concrete() && code != nullptr,
+        meth->is_concrete() && meth->get_dex_code() != nullptr,
         "Undefined method in generate_code_items()\n\t prototype: %s\n",
         SHOW(meth));
-    align_output();
-    int size = code->encode(dodx, (uint32_t*)(m_output + m_offset));
+    code_methods.push_back(meth);
+  }
+
+  // Code items don't refer to their own offsets, so we encode them into
+  // separate buffers in parallel, and then lay them out in the sorted order.
+  // The sizes get checked when laying them out, as an exception must not
+  // escape a worker thread.
+  std::vector<std::vector<uint8_t>> code_items(code_methods.size());
+  std::vector<int> code_item_sizes(code_methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    DexCode* code = code_methods[i]->get_dex_code();
+    auto& buffer = code_items[i];
+    // The buffer must start out zeroed, just like the output, as the encoding
+    // skips the padding before the tries.
+    buffer.resize(get_code_item_size_bound(code));
+    code_item_sizes[i] = code->encode(dodx, (uint32_t*)buffer.data());
+  });
+  for (size_t i = 0; i < code_methods.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  for (size_t i = 0; i < code_methods.size(); i++) {
+    DexMethod* meth = code_methods[i];
+    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
+          SHOW(meth));
+    DexCode* code = meth->get_dex_code();
+    auto& buffer = code_items[i];
+    int size = code_item_sizes[i];
+    always_assert(size >= 0 && (size_t)size <= buffer.size());
     check_method_instruction_size_limit(m_config_files, size, SHOW(meth));
+    buffer.resize(size);
+    align_output();
+    memcpy(m_output + m_offset, buffer.data(), buffer.size());
     m_method_bytecode_offsets.emplace_back(meth->get_name()->c_str(), m_offset);
     m_code_item_emits.emplace_back(meth, code,
                                    (dex_code_item*)(m_output + m_offset));
     auto insns_size = ((const dex_code_item*)(m_output + m_offset))->insns_size;
-    m_offset += size;
+    m_offset += buffer.size();
     m_stats.num_instructions += code->get_instructions().size();
     m_stats.instruction_bytes += insns_size * 2;
   }
@@ -1108,21 +1177,54 @@ static bool annotation_cmp(const DexAnnotationDirectory* a,
   return (a->viz_score() < b->viz_score());
 }
 
+namespace {
+
+/*
+ * Encodes the distinct elements of the list in parallel. The encodings are
+ * indexed like the list; repeated elements are only encoded at their first
+ * occurrence. Laying out the encodings is left to the caller, so that the
+ * output doesn't depend on the order in which they were computed.
+ */
+template <typename Encoding, typename T, typename Encode>
+std::vector<Encoding> encode_distinct(const std::vector<T*>& list,
+                                      const Encode& encode) {
+  std::vector<Encoding> encodings(list.size());
+  std::unordered_set<T*> seen;
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { encode(list[i], encodings[i]); });
+  for (size_t i = 0; i < list.size(); i++) {
+    if (seen.insert(list[i]).second) {
+      wq.add_item(i);
+    }
+  }
+  wq.run_all();
+  return encodings;
+}
+
+} // namespace
+
 void DexOutput::unique_annotations(annomap_t& annomap,
                                    std::vector<DexAnnotation*>& annolist) {
   int annocnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint8_t>, uint32_t> annotation_byte_offsets;
-  for (auto anno : annolist) {
+  auto encodings = encode_distinct<std::vector<uint8_t>>(
+      annolist, [this](DexAnnotation* anno, std::vector<uint8_t>& bytes) {
+        anno->vencode(dodx, bytes);
+      });
+  std::unordered_map<std::vector<uint8_t>, uint32_t,
+                     boost::hash<std::vector<uint8_t>>>
+      annotation_byte_offsets;
+  for (size_t i = 0; i < annolist.size(); i++) {
+    auto anno = annolist[i];
     if (annomap.count(anno)) continue;
-    std::vector<uint8_t> annotation_bytes;
-    anno->vencode(dodx, annotation_bytes);
-    if (annotation_byte_offsets.count(annotation_bytes)) {
-      annomap[anno] = annotation_byte_offsets[annotation_bytes];
+    const auto& annotation_bytes = encodings[i];
+    auto it = annotation_byte_offsets.find(annotation_bytes);
+    if (it != annotation_byte_offsets.end()) {
+      annomap[anno] = it->second;
       continue;
     }
     /* Insert new annotation in tracking structs */
-    annotation_byte_offsets[annotation_bytes] = m_offset;
+    annotation_byte_offsets.emplace(annotation_bytes, m_offset);
     annomap[anno] = m_offset;
     /* Not a dupe, encode... */
     uint8_t* annoout = (uint8_t*)(m_output + m_offset);
@@ -1142,17 +1244,25 @@ void DexOutput::unique_asets(annomap_t& annomap,
                              std::vector<DexAnnotationSet*>& asetlist) {
   int asetcnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> aset_offsets;
-  for (auto aset : asetlist) {
+  auto encodings = encode_distinct<std::vector<uint32_t>>(
+      asetlist,
+      [this, &annomap](DexAnnotationSet* aset, std::vector<uint32_t>& bytes) {
+        aset->vencode(dodx, bytes, annomap);
+      });
+  std::unordered_map<std::vector<uint32_t>, uint32_t,
+                     boost::hash<std::vector<uint32_t>>>
+      aset_offsets;
+  for (size_t i = 0; i < asetlist.size(); i++) {
+    auto aset = asetlist[i];
     if (asetmap.count(aset)) continue;
-    std::vector<uint32_t> aset_bytes;
-    aset->vencode(dodx, aset_bytes, annomap);
-    if (aset_offsets.count(aset_bytes)) {
-      asetmap[aset] = aset_offsets[aset_bytes];
+    const auto& aset_bytes = encodings[i];
+    auto it = aset_offsets.find(aset_bytes);
+    if (it != aset_offsets.end()) {
+      asetmap[aset] = it->second;
       continue;
     }
     /* Insert new aset in tracking structs */
-    aset_offsets[aset_bytes] = m_offset;
+    aset_offsets.emplace(aset_bytes, m_offset);
     asetmap[aset] = m_offset;
     /* Not a dupe, encode... */
     uint8_t* asetout = (uint8_t*)(m_output + m_offset);
@@ -1207,17 +1317,25 @@ void DexOutput::unique_adirs(asetmap_t& asetmap,
                              std::vector<DexAnnotationDirectory*>& adirlist) {
   int adircnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> adir_offsets;
-  for (auto adir : adirlist) {
+  auto encodings = encode_distinct<std::vector<uint32_t>>(
+      adirlist, [this, &asetmap, &xrefmap](DexAnnotationDirectory* adir,
+                                           std::vector<uint32_t>& bytes) {
+        adir->vencode(dodx, bytes, xrefmap, asetmap);
+      });
+  std::unordered_map<std::vector<uint32_t>, uint32_t,
+                     boost::hash<std::vector<uint32_t>>>
+      adir_offsets;
+  for (size_t i = 0; i < adirlist.size(); i++) {
+    auto adir = adirlist[i];
     if (adirmap.count(adir)) continue;
-    std::vector<uint32_t> adir_bytes;
-    adir->vencode(dodx, adir_bytes, xrefmap, asetmap);
-    if (adir_offsets.count(adir_bytes)) {
-      adirmap[adir] = adir_offsets[adir_bytes];
+    const auto& adir_bytes = encodings[i];
+    auto it = adir_offsets.find(adir_bytes);
+    if (it != adir_offsets.end()) {
+      adirmap[adir] = it->second;
       continue;
     }
     /* Insert new adir in tracking structs */
-    adir_offsets[adir_bytes] = m_offset;
+    adir_offsets.emplace(adir_bytes, m_offset);
     adirmap[adir] = m_offset;
     /* Not a dupe, encode... */
     uint8_t* adirout = (uint8_t*)(m_output + m_offset);
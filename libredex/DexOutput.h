@@ -19,6 +19,7 @@
 #include "PostLowering.h"
 #include "ProguardMap.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 #include <locator.h>
 using facebook::Locator;
@@ -270,10 +271,57 @@ class GatheredTypes {
   std::unordered_set<DexString*> index_type_names();
 };
 
+/*
+ * Sorts chunks of the vector in parallel, and then merges them pairwise, also
+ * in parallel. For a strict total order, such as the ones we use to order the
+ * strings of a dex, the result is the same as with std::sort.
+ */
+template <class T, class Cmp>
+void parallel_sort(std::vector<T>& vec, const Cmp& cmp) {
+  constexpr size_t kMinChunkSize = 4096;
+  size_t num_chunks =
+      std::min<size_t>(redex_parallel::default_num_threads(),
+                       vec.size() / kMinChunkSize);
+  if (num_chunks <= 1) {
+    std::sort(vec.begin(), vec.end(), cmp);
+    return;
+  }
+  std::vector<size_t> bounds;
+  for (size_t i = 0; i < num_chunks; i++) {
+    bounds.push_back(vec.size() * i / num_chunks);
+  }
+  bounds.push_back(vec.size());
+  auto sort_wq = workqueue_foreach<size_t>([&](size_t i) {
+    std::sort(vec.begin() + bounds[i], vec.begin() + bounds[i + 1], cmp);
+  });
+  for (size_t i = 0; i < num_chunks; i++) {
+    sort_wq.add_item(i);
+  }
+  sort_wq.run_all();
+  while (bounds.size() > 2) {
+    auto merge_wq = workqueue_foreach<size_t>([&](size_t i) {
+      std::inplace_merge(vec.begin() + bounds[i], vec.begin() + bounds[i + 1],
+                         vec.begin() + bounds[i + 2], cmp);
+    });
+    std::vector<size_t> merged_bounds;
+    size_t i = 0;
+    for (; i + 2 < bounds.size(); i += 2) {
+      merge_wq.add_item(i);
+      merged_bounds.push_back(bounds[i]);
+    }
+    // An odd chunk out gets merged in the next round.
+    for (; i < bounds.size(); i++) {
+      merged_bounds.push_back(bounds[i]);
+    }
+    merge_wq.run_all();
+    bounds = std::move(merged_bounds);
+  }
+}
+
 template <class T>
 std::vector<DexString*> GatheredTypes::get_dexstring_emitlist(T cmp) {
   std::vector<DexString*> strlist(m_lstring);
-  std::sort(strlist.begin(), strlist.end(), std::cref(cmp));
+  parallel_sort(strlist, cmp);
   return strlist;
 }
 
@@ -21,6 +21,18 @@ void InlinerConfig::bind_config() {
   bind("run_dedup_blocks", run_dedup_blocks, run_dedup_blocks);
   bind("run_copy_prop", run_copy_prop, run_copy_prop);
   bind("run_local_dce", run_local_dce, run_local_dce);
+  bind("max_concurrent_shrinking", max_concurrent_shrinking,
+       max_concurrent_shrinking,
+       "Upper bound on the number of methods the inliner shrinks at the same "
+       "time, limiting the memory held by the shrinking analyses. This does "
+       "not limit how many CFGs are alive when use_cfg_inliner is set, as "
+       "all CFGs are then built up front. When the bound is reached, waiting "
+       "methods are admitted in order of their critical-path priority. Zero "
+       "means unbounded.");
+  bind("use_summary_cache", use_summary_cache, use_summary_cache,
+       "Whether inliner invocations reuse constant-argument and cost "
+       "summaries of methods whose code did not change since they were "
+       "computed by an earlier inliner invocation.");
   bind("no_inline_annos", {}, m_no_inline_annos);
   bind("force_inline_annos", {}, m_force_inline_annos);
   bind("black_list", {}, m_black_list);
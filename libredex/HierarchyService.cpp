@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "HierarchyService.h"
+
+#include <unordered_set>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include "DexAccess.h"
+#include "Show.h"
+#include "Trace.h"
+#include "WorkQueue.h"
+
+namespace mog = method_override_graph;
+
+namespace {
+
+bool operator==(const mog::Node& lhs, const mog::Node& rhs) {
+  return lhs.parents == rhs.parents && lhs.children == rhs.children;
+}
+
+bool equals(const mog::Graph& lhs, const mog::Graph& rhs) {
+  if (lhs.nodes().size() != rhs.nodes().size()) {
+    return false;
+  }
+  for (const auto& pair : lhs.nodes()) {
+    if (!rhs.nodes().count(pair.first) ||
+        !(pair.second == rhs.get_node(pair.first))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+HierarchyService::ClassSnapshot HierarchyService::take_snapshot(
+    const DexClass* cls) {
+  size_t methods_hash = 0;
+  for (const auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+    for (const auto* method : *methods) {
+      boost::hash_combine(methods_hash, method);
+      boost::hash_combine(methods_hash, method->get_name());
+      boost::hash_combine(methods_hash, method->get_proto());
+      boost::hash_combine(methods_hash, method->get_access());
+    }
+    // Separate direct from virtual methods.
+    boost::hash_combine(methods_hash, methods->size());
+  }
+  return ClassSnapshot{cls->get_type(), cls->get_super_class(),
+                       cls->get_interfaces(), cls->get_access(), methods_hash};
+}
+
+void HierarchyService::sync(const Scope& scope) {
+  std::vector<ClassSnapshot> snapshots(scope.size());
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { snapshots[i] = take_snapshot(scope[i]); });
+  for (size_t i = 0; i < scope.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  std::unordered_map<const DexClass*, ClassSnapshot> new_snapshots;
+  new_snapshots.reserve(scope.size());
+  for (size_t i = 0; i < scope.size(); ++i) {
+    new_snapshots.emplace(scope[i], snapshots[i]);
+  }
+
+  bool changed = new_snapshots.size() != m_snapshots.size();
+  for (auto it = new_snapshots.begin(); !changed && it != new_snapshots.end();
+       ++it) {
+    auto old_it = m_snapshots.find(it->first);
+    if (old_it == m_snapshots.end()) {
+      changed = true;
+      break;
+    }
+    const auto& a = old_it->second;
+    const auto& b = it->second;
+    changed = a.type != b.type || a.super != b.super ||
+              a.interfaces != b.interfaces || a.access != b.access ||
+              a.methods_hash != b.methods_hash;
+  }
+  if (!changed) {
+    return;
+  }
+
+  TRACE(PM, 2, "Hierarchy service: scope changed, updating");
+  if (m_class_hierarchy) {
+    update_class_hierarchy(m_snapshots, new_snapshots);
+  }
+  // Any change to classes or their methods may affect overriding.
+  m_method_override_graph.reset();
+  m_snapshots = std::move(new_snapshots);
+}
+
+void HierarchyService::update_class_hierarchy(
+    const std::unordered_map<const DexClass*, ClassSnapshot>& old_snapshots,
+    const std::unordered_map<const DexClass*, ClassSnapshot>& new_snapshots) {
+  // Interfaces are not part of the class hierarchy.
+  auto in_hierarchy = [](const ClassSnapshot& snapshot) {
+    return !(snapshot.access & ACC_INTERFACE);
+  };
+  // Returns the snapshot if the class contributes the same parent-child
+  // relationship in both snapshot maps.
+  auto unchanged = [&](const DexClass* cls,
+                       const ClassSnapshot& snapshot,
+                       const std::unordered_map<const DexClass*,
+                                                ClassSnapshot>& other) {
+    auto it = other.find(cls);
+    return it != other.end() && in_hierarchy(it->second) &&
+           it->second.type == snapshot.type &&
+           it->second.super == snapshot.super;
+  };
+
+  std::vector<const ClassSnapshot*> removed;
+  for (const auto& pair : old_snapshots) {
+    if (in_hierarchy(pair.second) &&
+        !unchanged(pair.first, pair.second, new_snapshots)) {
+      removed.push_back(&pair.second);
+    }
+  }
+  std::vector<const ClassSnapshot*> added;
+  for (const auto& pair : new_snapshots) {
+    if (in_hierarchy(pair.second) &&
+        !unchanged(pair.first, pair.second, old_snapshots)) {
+      added.push_back(&pair.second);
+    }
+  }
+  if (removed.empty() && added.empty()) {
+    return;
+  }
+
+  if (m_class_hierarchy.use_count() > 1) {
+    // Somebody is still using the current one, don't pull the rug out from
+    // under their feet.
+    m_class_hierarchy = std::make_shared<ClassHierarchy>(*m_class_hierarchy);
+  }
+  auto& hierarchy = *m_class_hierarchy;
+  std::unordered_set<const DexType*> affected;
+  for (const auto* snapshot : removed) {
+    affected.insert(snapshot->type);
+    if (snapshot->super != nullptr) {
+      auto it = hierarchy.find(snapshot->super);
+      if (it != hierarchy.end()) {
+        it->second.erase(snapshot->type);
+      }
+      affected.insert(snapshot->super);
+    }
+  }
+  for (const auto* snapshot : added) {
+    hierarchy[snapshot->type];
+    if (snapshot->super != nullptr) {
+      hierarchy[snapshot->super].insert(snapshot->type);
+    }
+  }
+  // A fresh build only has entries for supertypes, classes of the scope and
+  // external classes; drop entries that are no longer any of those.
+  for (const auto* type : affected) {
+    auto it = hierarchy.find(type);
+    if (it == hierarchy.end() || !it->second.empty()) {
+      continue;
+    }
+    auto cls = type_class(type);
+    bool keep = false;
+    if (cls != nullptr && cls->is_external()) {
+      keep = !is_interface(cls);
+    } else if (cls != nullptr) {
+      auto snapshot_it = new_snapshots.find(cls);
+      keep = snapshot_it != new_snapshots.end() &&
+             in_hierarchy(snapshot_it->second) &&
+             snapshot_it->second.type == type;
+    }
+    if (!keep) {
+      hierarchy.erase(it);
+    }
+  }
+  ++m_stats.incremental_updates;
+  TRACE(PM, 2, "Hierarchy service: %zu classes removed, %zu added",
+        removed.size(), added.size());
+}
+
+std::shared_ptr<const ClassHierarchy> HierarchyService::get_class_hierarchy(
+    const Scope& scope) {
+  auto incremental_updates = m_stats.incremental_updates;
+  sync(scope);
+  if (!m_class_hierarchy) {
+    m_class_hierarchy =
+        std::make_shared<ClassHierarchy>(build_type_hierarchy(scope));
+    ++m_stats.full_builds;
+  } else if (incremental_updates == m_stats.incremental_updates) {
+    ++m_stats.reused;
+  }
+  if (m_validate) {
+    always_assert_log(*m_class_hierarchy == build_type_hierarchy(scope),
+                      "Class hierarchy differs from a fresh rebuild");
+  }
+  return m_class_hierarchy;
+}
+
+std::shared_ptr<const mog::Graph> HierarchyService::get_method_override_graph(
+    const Scope& scope) {
+  sync(scope);
+  if (!m_method_override_graph) {
+    m_method_override_graph = mog::build_graph(scope);
+    ++m_stats.full_builds;
+  } else {
+    ++m_stats.reused;
+  }
+  if (m_validate) {
+    always_assert_log(equals(*m_method_override_graph, *mog::build_graph(scope)),
+                      "Method override graph differs from a fresh rebuild");
+  }
+  return m_method_override_graph;
+}
+
+void HierarchyService::invalidate() {
+  m_snapshots.clear();
+  m_class_hierarchy.reset();
+  m_method_override_graph.reset();
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "ClassHierarchy.h"
+#include "DexClass.h"
+#include "MethodOverrideGraph.h"
+
+/*
+ * Many passes start by building the class hierarchy and the method override
+ * graph of the whole scope, even though most passes don't change the
+ * hierarchy at all. The HierarchyService, owned by the PassManager, keeps
+ * these structures around across passes.
+ *
+ * Every request takes a cheap structural snapshot of the scope (supertypes
+ * and method signatures of every class) and compares it with the snapshot
+ * the cached structures were built from:
+ * - the class hierarchy gets updated incrementally for classes that were
+ *   added, removed, or whose supertype changed;
+ * - the method override graph gets rebuilt if any class changed in a way
+ *   that may affect overriding, and is reused otherwise.
+ *
+ * Results are handed out as shared pointers to immutable structures, so they
+ * stay valid even if a later request updates the service.
+ *
+ * In validation mode, every result is compared against a fresh rebuild.
+ */
+class HierarchyService {
+ public:
+  explicit HierarchyService(bool validate = false) : m_validate(validate) {}
+
+  std::shared_ptr<const ClassHierarchy> get_class_hierarchy(
+      const Scope& scope);
+
+  std::shared_ptr<const method_override_graph::Graph>
+  get_method_override_graph(const Scope& scope);
+
+  // Drop all cached state.
+  void invalidate();
+
+  struct Stats {
+    // Requests answered without any change to the cached state.
+    size_t reused{0};
+    // Class hierarchies that were updated incrementally.
+    size_t incremental_updates{0};
+    // Structures that had to be built from scratch.
+    size_t full_builds{0};
+  };
+
+  const Stats& get_stats() const { return m_stats; }
+
+ private:
+  struct ClassSnapshot {
+    const DexType* type;
+    const DexType* super;
+    const DexTypeList* interfaces;
+    DexAccessFlags access;
+    // Hash of the identities, names, protos and access flags of all methods.
+    size_t methods_hash;
+  };
+
+  static ClassSnapshot take_snapshot(const DexClass* cls);
+
+  // Updates the cached state to match the scope.
+  void sync(const Scope& scope);
+
+  void update_class_hierarchy(
+      const std::unordered_map<const DexClass*, ClassSnapshot>& old_snapshots,
+      const std::unordered_map<const DexClass*, ClassSnapshot>& new_snapshots);
+
+  bool m_validate;
+  Stats m_stats;
+  std::unordered_map<const DexClass*, ClassSnapshot> m_snapshots;
+  // Only updated in place when no client holds on to it.
+  std::shared_ptr<ClassHierarchy> m_class_hierarchy;
+  std::shared_ptr<const method_override_graph::Graph> m_method_override_graph;
+};
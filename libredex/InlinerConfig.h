@@ -32,6 +32,14 @@ struct InlinerConfig {
   bool shrink_other_methods{true};
   bool unique_inlined_registers{true};
   bool debug{false};
+  // Upper bound on the number of methods that may be shrunk concurrently,
+  // which limits the transient memory of the shrinking analyses. This does not
+  // bound the number of live CFGs when use_cfg_inliner is set, as all CFGs are
+  // then built up front. Zero means unbounded.
+  size_t max_concurrent_shrinking{0};
+  // Reuse caller and callee summaries computed by earlier inliner invocations
+  // for methods whose code did not change since.
+  bool use_summary_cache{true};
   std::unordered_set<DexType*> whitelist_no_method_limit;
   // We will populate the information to rstate of classes and methods.
   std::unordered_set<DexType*> m_no_inline_annos;
@@ -5,9 +5,21 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/optional.hpp>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <zlib.h>
@@ -25,8 +37,10 @@
 #include "DexClass.h"
 #include "DuplicateClasses.h"
 #include "JarLoader.h"
+#include "Sha1.h"
 #include "Trace.h"
 #include "Util.h"
+#include "WorkQueue.h"
 
 /******************
  * Begin Class Loading code.
@@ -56,6 +70,8 @@ static const uint32_t kClassMagic = 0xcafebabe;
 
 struct cp_entry {
   uint8_t tag;
+  // Whether a UTF-8 entry has been NUL-terminated in place.
+  bool terminated{false};
   union {
     struct {
       uint16_t s0;
@@ -197,24 +213,6 @@ static bool extract_utf8(std::vector<cp_entry>& cpool,
   return true;
 }
 
-static DexField* make_dexfield(std::vector<cp_entry>& cpool,
-                               DexType* self,
-                               cp_field_info& finfo) {
-  char dbuffer[MAX_CLASS_NAMELEN];
-  char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-      !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
-    return nullptr;
-  }
-  DexString* name = DexString::make_string(nbuffer);
-  DexType* desc = DexType::make_type(dbuffer);
-  DexField* field =
-      static_cast<DexField*>(DexField::make_field(self, name, desc));
-  field->set_access((DexAccessFlags)finfo.aflags);
-  field->set_external();
-  return field;
-}
-
 static DexType* simpleTypeB;
 static DexType* simpleTypeC;
 static DexType* simpleTypeD;
@@ -312,48 +310,59 @@ static DexTypeList* extract_arguments(const char*& buf) {
   return DexTypeList::make_type_list(std::move(args));
 }
 
-static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
-                                 DexType* self,
-                                 cp_method_info& finfo) {
-  char dbuffer[MAX_CLASS_NAMELEN];
-  char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-      !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
+namespace {
+
+struct ParsedMember {
+  uint16_t aflags;
+  DexString* name;
+  // The type for fields, nullptr for methods.
+  DexType* type;
+  // The prototype for methods, nullptr for fields.
+  DexProto* proto;
+  uint8_t* attributes;
+};
+
+/*
+ * The result of parsing a class file, before anything gets defined. Parsing
+ * only interns strings, types and prototypes, which is thread-safe, so class
+ * files can be parsed in parallel.
+ *
+ * Parsing happens in two steps: the header, up to the type of the class, and
+ * the body with the supertypes and members. Duplicate classes are detected in
+ * between, so that their members don't need to be parsed.
+ */
+struct ParsedClass {
+  std::vector<cp_entry> cpool;
+  uint16_t aflags;
+  DexType* self;
+  // Where the body of the class file starts.
+  uint8_t* body{nullptr};
+  DexType* super;
+  std::vector<DexType*> interfaces;
+  std::vector<ParsedMember> fields;
+  std::vector<ParsedMember> methods;
+};
+
+/*
+ * Returns the DexString of a UTF-8 entry. Modified UTF-8 never contains NUL
+ * bytes, so entries that were terminated in place are interned directly out
+ * of the class file buffer.
+ */
+DexString* make_string_from_cp(std::vector<cp_entry>& cpool,
+                               uint16_t utf8ref) {
+  const cp_entry& utf8cpe = cpool[utf8ref];
+  if (utf8cpe.tag != CP_CONST_UTF8) {
+    fprintf(stderr, "Non-utf8 ref in get_utf8, bailing\n");
     return nullptr;
   }
-  DexString* name = DexString::make_string(nbuffer);
-  const char* ptr = dbuffer;
-  DexTypeList* tlist = extract_arguments(ptr);
-  if (tlist == nullptr) return nullptr;
-  DexType* rtype = parse_type(ptr);
-  if (rtype == nullptr) return nullptr;
-  DexProto* proto = DexProto::make_proto(rtype, tlist);
-  DexMethod* method =
-      static_cast<DexMethod*>(DexMethod::make_method(self, name, proto));
-  if (method->is_concrete()) {
-    fprintf(stderr, "Pre-concrete method attempted to load '%s', bailing\n",
-            SHOW(method));
-    return nullptr;
+  if (utf8cpe.terminated) {
+    return DexString::make_string(reinterpret_cast<const char*>(utf8cpe.data));
   }
-  uint32_t access = finfo.aflags;
-  bool is_virt = true;
-  if (nbuffer[0] == '<') {
-    is_virt = false;
-    if (nbuffer[1] == 'i') {
-      access |= ACC_CONSTRUCTOR;
-    }
-  } else if (access & (ACC_PRIVATE | ACC_STATIC))
-    is_virt = false;
-  method->set_access((DexAccessFlags)access);
-  method->set_virtual(is_virt);
-  method->set_external();
-  return method;
+  std::string str(reinterpret_cast<const char*>(utf8cpe.data), utf8cpe.len);
+  return DexString::make_string(str);
 }
 
-bool parse_class(uint8_t* buffer,
-                 Scope* classes,
-                 attribute_hook_t attr_hook,
-                 const std::string& jar_location) {
+bool parse_class_header(uint8_t* buffer, ParsedClass& parsed) {
   uint32_t magic = read32(buffer);
   uint16_t vminor DEBUG_ONLY = read16(buffer);
   uint16_t vmajor DEBUG_ONLY = read16(buffer);
@@ -362,7 +371,7 @@ bool parse_class(uint8_t* buffer,
     fprintf(stderr, "Bad class magic %08x, Bailing\n", magic);
     return false;
   }
-  std::vector<cp_entry> cpool;
+  auto& cpool = parsed.cpool;
   cpool.resize(cp_count);
   /* The zero'th entry is always empty.  Java is annoying. */
   for (int i = 1; i < cp_count; i++) {
@@ -372,11 +381,100 @@ bool parse_class(uint8_t* buffer,
       i++;
     }
   }
-  uint16_t aflags = read16(buffer);
+  // The byte after a UTF-8 entry is the tag of the next entry, which we don't
+  // need anymore, so we can overwrite it with a NUL. That's not the case for
+  // the last entry, which is followed by the access flags.
+  for (auto& cpe : cpool) {
+    if (cpe.tag == CP_CONST_UTF8 && cpe.data + cpe.len < buffer) {
+      cpe.data[cpe.len] = '\0';
+      cpe.terminated = true;
+    }
+  }
+
+  parsed.aflags = read16(buffer);
   uint16_t clazz = read16(buffer);
+  parsed.self = make_dextype_from_cref(cpool, clazz);
+  if (parsed.self == nullptr) return false;
+  parsed.body = buffer;
+  return true;
+}
+
+bool parse_class_body(ParsedClass& parsed) {
+  auto& cpool = parsed.cpool;
+  uint8_t* buffer = parsed.body;
   uint16_t super = read16(buffer);
   uint16_t ifcount = read16(buffer);
-  DexType* self = make_dextype_from_cref(cpool, clazz);
+  parsed.super = nullptr;
+  if (super != 0) {
+    parsed.super = make_dextype_from_cref(cpool, super);
+  }
+  parsed.interfaces.reserve(ifcount);
+  for (int i = 0; i < ifcount; i++) {
+    uint16_t iface = read16(buffer);
+    parsed.interfaces.push_back(make_dextype_from_cref(cpool, iface));
+  }
+
+  uint16_t fcount = read16(buffer);
+  parsed.fields.reserve(fcount);
+  for (int i = 0; i < fcount; i++) {
+    ParsedMember field;
+    field.aflags = read16(buffer);
+    uint16_t name_ndx = read16(buffer);
+    uint16_t desc_ndx = read16(buffer);
+    field.attributes = buffer;
+    skip_attributes(buffer);
+    field.name = make_string_from_cp(cpool, name_ndx);
+    auto desc = make_string_from_cp(cpool, desc_ndx);
+    if (field.name == nullptr || desc == nullptr) return false;
+    field.type = DexType::make_type(desc);
+    field.proto = nullptr;
+    parsed.fields.push_back(field);
+  }
+
+  uint16_t mcount = read16(buffer);
+  parsed.methods.reserve(mcount);
+  for (int i = 0; i < mcount; i++) {
+    ParsedMember method;
+    method.aflags = read16(buffer);
+    uint16_t name_ndx = read16(buffer);
+    uint16_t desc_ndx = read16(buffer);
+    method.attributes = buffer;
+    skip_attributes(buffer);
+    method.name = make_string_from_cp(cpool, name_ndx);
+    if (method.name == nullptr) return false;
+    const cp_entry& desc_cpe = cpool[desc_ndx];
+    if (desc_cpe.tag != CP_CONST_UTF8 || desc_cpe.len >= MAX_CLASS_NAMELEN) {
+      fprintf(stderr, "Invalid method descriptor, bailing\n");
+      return false;
+    }
+    const char* ptr = reinterpret_cast<const char*>(desc_cpe.data);
+    std::string desc;
+    if (!desc_cpe.terminated) {
+      desc.assign(ptr, desc_cpe.len);
+      ptr = desc.c_str();
+    }
+    DexTypeList* tlist = extract_arguments(ptr);
+    if (tlist == nullptr) return false;
+    DexType* rtype = parse_type(ptr);
+    if (rtype == nullptr) return false;
+    method.type = nullptr;
+    method.proto = DexProto::make_proto(rtype, tlist);
+    parsed.methods.push_back(method);
+  }
+  return true;
+}
+
+/*
+ * Defines the external class parsed before, unless a class of the same name
+ * was already defined. This must happen in a deterministic order, as the
+ * first definition wins.
+ */
+bool define_class(ParsedClass& parsed,
+                  Scope* classes,
+                  const attribute_hook_t& attr_hook,
+                  const std::string& jar_location) {
+  auto& cpool = parsed.cpool;
+  DexType* self = parsed.self;
   DexClass* cls = type_class(self);
   if (cls) {
     // We are seeing duplicate classes when parsing jar file
@@ -409,19 +507,13 @@ bool parse_class(uint8_t* buffer,
 
   ClassCreator cc(self, jar_location);
   cc.set_external();
-  if (super != 0) {
-    DexType* sclazz = make_dextype_from_cref(cpool, super);
-    cc.set_super(sclazz);
+  if (parsed.super != nullptr) {
+    cc.set_super(parsed.super);
   }
-  cc.set_access((DexAccessFlags)aflags);
-  if (ifcount) {
-    for (int i = 0; i < ifcount; i++) {
-      uint16_t iface = read16(buffer);
-      DexType* iftype = make_dextype_from_cref(cpool, iface);
-      cc.add_interface(iftype);
-    }
+  cc.set_access((DexAccessFlags)parsed.aflags);
+  for (auto iftype : parsed.interfaces) {
+    cc.add_interface(iftype);
   }
-  uint16_t fcount = read16(buffer);
 
   auto invoke_attr_hook =
       [&](const boost::variant<DexField*, DexMethod*>& field_or_method,
@@ -445,34 +537,38 @@ bool parse_class(uint8_t* buffer,
         }
       };
 
-  for (int i = 0; i < fcount; i++) {
-    cp_field_info cpfield;
-    cpfield.aflags = read16(buffer);
-    cpfield.nameNdx = read16(buffer);
-    cpfield.descNdx = read16(buffer);
-    uint8_t* attrPtr = buffer;
-    skip_attributes(buffer);
-    DexField* field = make_dexfield(cpool, self, cpfield);
-    if (field == nullptr) return false;
+  for (const auto& cpfield : parsed.fields) {
+    DexField* field = static_cast<DexField*>(
+        DexField::make_field(self, cpfield.name, cpfield.type));
+    field->set_access((DexAccessFlags)cpfield.aflags);
+    field->set_external();
     cc.add_field(field);
-    invoke_attr_hook({field}, attrPtr);
+    invoke_attr_hook({field}, cpfield.attributes);
   }
 
-  uint16_t mcount = read16(buffer);
-  if (mcount) {
-    for (int i = 0; i < mcount; i++) {
-      cp_method_info cpmethod;
-      cpmethod.aflags = read16(buffer);
-      cpmethod.nameNdx = read16(buffer);
-      cpmethod.descNdx = read16(buffer);
-
-      uint8_t* attrPtr = buffer;
-      skip_attributes(buffer);
-      DexMethod* method = make_dexmethod(cpool, self, cpmethod);
-      if (method == nullptr) return false;
-      cc.add_method(method);
-      invoke_attr_hook({method}, attrPtr);
+  for (const auto& cpmethod : parsed.methods) {
+    DexMethod* method = static_cast<DexMethod*>(
+        DexMethod::make_method(self, cpmethod.name, cpmethod.proto));
+    if (method->is_concrete()) {
+      fprintf(stderr, "Pre-concrete method attempted to load '%s', bailing\n",
+              SHOW(method));
+      return false;
     }
+    uint32_t access = cpmethod.aflags;
+    bool is_virt = true;
+    const char* name = cpmethod.name->c_str();
+    if (name[0] == '<') {
+      is_virt = false;
+      if (name[1] == 'i') {
+        access |= ACC_CONSTRUCTOR;
+      }
+    } else if (access & (ACC_PRIVATE | ACC_STATIC))
+      is_virt = false;
+    method->set_access((DexAccessFlags)access);
+    method->set_virtual(is_virt);
+    method->set_external();
+    cc.add_method(method);
+    invoke_attr_hook({method}, cpmethod.attributes);
   }
   DexClass* dc = cc.create();
   if (classes != nullptr) {
@@ -510,6 +606,23 @@ bool parse_class(uint8_t* buffer,
   return true;
 }
 
+} // namespace
+
+bool parse_class(uint8_t* buffer,
+                 Scope* classes,
+                 attribute_hook_t attr_hook,
+                 const std::string& jar_location) {
+  ParsedClass parsed;
+  if (!parse_class_header(buffer, parsed)) {
+    return false;
+  }
+  // Duplicate classes get rejected by define_class without their members.
+  if (type_class(parsed.self) == nullptr && !parse_class_body(parsed)) {
+    return false;
+  }
+  return define_class(parsed, classes, attr_hook, jar_location);
+}
+
 bool load_class_file(const std::string& filename, Scope* classes) {
   // It's not exactly efficient to call init_basic_types repeatedly for each
   // class file that we load, but load_class_file should typically only be used
@@ -750,18 +863,289 @@ static bool decompress_class(jar_entry& file,
   return true;
 }
 
-static const int kStartBufferSize = 128 * 1024;
+// Number of class files to inflate and parse in parallel at a time, which
+// bounds the memory needed for inflated class files.
+static const size_t kClassBatchSize = 1024;
+
+namespace {
+
+/*
+ * The jar cache stores all classes parsed from a jar in a compact binary
+ * form: a table of NUL-terminated strings, which get interned directly out
+ * of the mapped file, followed by the classes as sequences of 32-bit words
+ * that refer to strings by index.
+ *
+ * A cache file is named after the SHA-1 of the jar, and is only used if the
+ * SHA-1 and the size of the jar recorded in its header match.
+ */
+const char kJarCacheMagic[8] = {'R', 'D', 'X', 'J', 'A', 'R', 'C', '2'};
+const uint32_t kNoString = std::numeric_limits<uint32_t>::max();
+const size_t kSha1Size = 20;
+
+struct JarCacheHeader {
+  char magic[8];
+  uint8_t jar_sha1[kSha1Size];
+  uint32_t num_strings;
+  uint64_t jar_size;
+  uint64_t strings_size;
+  uint64_t data_size;
+  uint32_t num_classes;
+};
+
+void hash_jar(const uint8_t* mapping, size_t size, uint8_t* sha1) {
+  Sha1Context context;
+  sha1_init(&context);
+  // sha1_update takes 32-bit lengths.
+  const size_t kChunkSize = 1 << 30;
+  for (size_t i = 0; i < size; i += kChunkSize) {
+    sha1_update(&context, mapping + i, std::min(kChunkSize, size - i));
+  }
+  sha1_final(sha1, &context);
+}
+
+class JarCacheWriter {
+ public:
+  // Marks the jar as not cacheable, e.g. when one of its classes couldn't be
+  // parsed completely.
+  void invalidate() { m_valid = false; }
+
+  bool valid() const { return m_valid; }
+
+  void add(const ParsedClass& parsed) {
+    ++m_num_classes;
+    m_data.push_back(string_id(parsed.self->get_name()));
+    m_data.push_back(parsed.super == nullptr
+                         ? kNoString
+                         : string_id(parsed.super->get_name()));
+    m_data.push_back(parsed.aflags);
+    m_data.push_back(parsed.interfaces.size());
+    for (auto intf : parsed.interfaces) {
+      m_data.push_back(string_id(intf->get_name()));
+    }
+    m_data.push_back(parsed.fields.size());
+    for (const auto& field : parsed.fields) {
+      m_data.push_back(string_id(field.name));
+      m_data.push_back(string_id(field.type->get_name()));
+      m_data.push_back(field.aflags);
+    }
+    m_data.push_back(parsed.methods.size());
+    for (const auto& method : parsed.methods) {
+      m_data.push_back(string_id(method.name));
+      m_data.push_back(string_id(method.proto->get_rtype()->get_name()));
+      const auto& args = method.proto->get_args()->get_type_list();
+      m_data.push_back(args.size());
+      for (auto arg : args) {
+        m_data.push_back(string_id(arg->get_name()));
+      }
+      m_data.push_back(method.aflags);
+    }
+  }
+
+  // Writes the cache file atomically, so that concurrent builds sharing a
+  // cache directory never see partial files.
+  bool write(const std::string& path,
+             const uint8_t* jar_sha1,
+             uint64_t jar_size) const {
+    JarCacheHeader header;
+    // Don't write uninitialized padding.
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kJarCacheMagic, sizeof(header.magic));
+    memcpy(header.jar_sha1, jar_sha1, sizeof(header.jar_sha1));
+    header.jar_size = jar_size;
+    header.num_strings = m_strings.size();
+    header.num_classes = m_num_classes;
+    header.data_size = m_data.size();
+    header.strings_size = 0;
+    for (auto str : m_strings) {
+      header.strings_size += sizeof(uint32_t) + str->size() + 1;
+    }
+    // Keep the class data aligned.
+    header.strings_size = (header.strings_size + 3) & ~3ULL;
+
+    auto tmp_path =
+        path + boost::filesystem::unique_path(".tmp.%%%%-%%%%-%%%%").string();
+    {
+      std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      uint64_t written = 0;
+      for (auto str : m_strings) {
+        uint32_t len = str->size();
+        out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        out.write(str->c_str(), len + 1);
+        written += sizeof(len) + len + 1;
+      }
+      static const char padding[4] = {0, 0, 0, 0};
+      out.write(padding, header.strings_size - written);
+      out.write(reinterpret_cast<const char*>(m_data.data()),
+                m_data.size() * sizeof(uint32_t));
+      if (!out) {
+        std::remove(tmp_path.c_str());
+        return false;
+      }
+    }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+  }
+
+ private:
+  uint32_t string_id(const DexString* str) {
+    auto it = m_string_ids.find(str);
+    if (it != m_string_ids.end()) {
+      return it->second;
+    }
+    uint32_t id = m_strings.size();
+    m_strings.push_back(str);
+    m_string_ids.emplace(str, id);
+    return id;
+  }
+
+  std::unordered_map<const DexString*, uint32_t> m_string_ids;
+  std::vector<const DexString*> m_strings;
+  std::vector<uint32_t> m_data;
+  uint32_t m_num_classes{0};
+  bool m_valid{true};
+};
+
+/*
+ * Defines all classes from a cache file, and returns whether that succeeded.
+ * Returns none if the file is missing, stale, or malformed, in which case
+ * nothing was defined.
+ */
+boost::optional<bool> load_jar_cache(const std::string& path,
+                                     const uint8_t* jar_sha1,
+                                     uint64_t jar_size,
+                                     const char* location,
+                                     Scope* classes) {
+  boost::iostreams::mapped_file file;
+  try {
+    file.open(path, boost::iostreams::mapped_file::readonly);
+  } catch (const std::exception& e) {
+    return boost::none;
+  }
+  auto begin = reinterpret_cast<const uint8_t*>(file.const_data());
+  auto end = begin + file.size();
+  JarCacheHeader header;
+  if (file.size() < sizeof(header)) {
+    return boost::none;
+  }
+  memcpy(&header, begin, sizeof(header));
+  if (memcmp(header.magic, kJarCacheMagic, sizeof(header.magic)) != 0 ||
+      memcmp(header.jar_sha1, jar_sha1, sizeof(header.jar_sha1)) != 0 ||
+      header.jar_size != jar_size ||
+      header.strings_size > file.size() - sizeof(header) ||
+      header.data_size * sizeof(uint32_t) !=
+          file.size() - sizeof(header) - header.strings_size) {
+    return boost::none;
+  }
+
+  // Find the strings, then intern them in parallel.
+  std::vector<const char*> raw_strings;
+  raw_strings.reserve(header.num_strings);
+  auto ptr = begin + sizeof(header);
+  auto strings_end = ptr + header.strings_size;
+  for (uint32_t i = 0; i < header.num_strings; i++) {
+    uint32_t len;
+    if (ptr + sizeof(len) > strings_end) return boost::none;
+    memcpy(&len, ptr, sizeof(len));
+    ptr += sizeof(len);
+    if (ptr + len + 1 > strings_end || ptr[len] != '\0') return boost::none;
+    raw_strings.push_back(reinterpret_cast<const char*>(ptr));
+    ptr += len + 1;
+  }
+  std::vector<DexString*> strings(raw_strings.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    strings[i] = DexString::make_string(raw_strings[i]);
+  });
+  for (size_t i = 0; i < strings.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  // Decode all classes before defining any, so that a malformed file doesn't
+  // leave us with a partial set of classes.
+  auto data = reinterpret_cast<const uint32_t*>(strings_end);
+  auto data_end = reinterpret_cast<const uint32_t*>(end);
+  bool ok = true;
+  auto next = [&]() -> uint32_t {
+    if (data >= data_end) {
+      ok = false;
+      return 0;
+    }
+    return *data++;
+  };
+  auto next_string = [&]() -> DexString* {
+    auto id = next();
+    if (id >= strings.size()) {
+      ok = false;
+      return nullptr;
+    }
+    return strings[id];
+  };
+  auto next_type = [&]() -> DexType* {
+    auto str = next_string();
+    return str == nullptr ? nullptr : DexType::make_type(str);
+  };
+  std::vector<ParsedClass> parsed_classes(header.num_classes);
+  for (auto& parsed : parsed_classes) {
+    parsed.self = next_type();
+    auto super = next();
+    parsed.super = super == kNoString || super >= strings.size()
+                       ? nullptr
+                       : DexType::make_type(strings[super]);
+    parsed.aflags = next();
+    for (auto n = next(); ok && n > 0; n--) {
+      parsed.interfaces.push_back(next_type());
+    }
+    for (auto n = next(); ok && n > 0; n--) {
+      ParsedMember field;
+      field.name = next_string();
+      field.type = next_type();
+      field.proto = nullptr;
+      field.attributes = nullptr;
+      field.aflags = next();
+      parsed.fields.push_back(field);
+    }
+    for (auto n = next(); ok && n > 0; n--) {
+      ParsedMember method;
+      method.name = next_string();
+      auto rtype = next_type();
+      std::deque<DexType*> args;
+      for (auto nargs = next(); ok && nargs > 0; nargs--) {
+        args.push_back(next_type());
+      }
+      method.aflags = next();
+      method.type = nullptr;
+      method.attributes = nullptr;
+      if (!ok) break;
+      method.proto = DexProto::make_proto(
+          rtype, DexTypeList::make_type_list(std::move(args)));
+      parsed.methods.push_back(method);
+    }
+    if (!ok) return boost::none;
+  }
+  if (data != data_end) {
+    return boost::none;
+  }
+
+  for (auto& parsed : parsed_classes) {
+    if (!define_class(parsed, classes, /* attr_hook */ nullptr, location)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
 
 static bool process_jar_entries(const char* location,
                                 std::vector<jar_entry>& files,
                                 const uint8_t* mapping,
                                 Scope* classes,
-                                const attribute_hook_t& attr_hook) {
-  ssize_t bufsize = kStartBufferSize;
-  uint8_t* outbuffer = (uint8_t*)malloc(bufsize);
+                                const attribute_hook_t& attr_hook,
+                                JarCacheWriter* cache_writer) {
   static char classEndString[] = ".class";
   static size_t classEndStringLen = strlen(classEndString);
   init_basic_types();
+  std::vector<jar_entry*> class_files;
   for (auto& file : files) {
     if (file.cd_entry.ucomp_size == 0) continue;
     if (file.cd_entry.fname_len < (classEndStringLen + 1)) continue;
@@ -770,48 +1154,117 @@ static bool process_jar_entries(const char* location,
     uint8_t* endcomp =
         file.filename + (file.cd_entry.fname_len - classEndStringLen);
     if (memcmp(endcomp, classEndString, classEndStringLen) != 0) continue;
+    class_files.push_back(&file);
+  }
 
-    // Resize output if necessary.
-    if (bufsize < file.cd_entry.ucomp_size) {
-      while (bufsize < file.cd_entry.ucomp_size)
-        bufsize *= 2;
-      free(outbuffer);
-      outbuffer = (uint8_t*)malloc(bufsize);
-    }
-
-    if (!decompress_class(file, mapping, outbuffer, bufsize)) {
-      free(outbuffer);
-      return false;
+  struct ClassFile {
+    std::unique_ptr<uint8_t[]> buffer;
+    ParsedClass parsed;
+    bool ok{false};
+    bool duplicate{false};
+  };
+  for (size_t begin = 0; begin < class_files.size(); begin += kClassBatchSize) {
+    std::vector<ClassFile> batch(
+        std::min(kClassBatchSize, class_files.size() - begin));
+    auto for_each_parallel = [&](const std::vector<size_t>& indices,
+                                 const std::function<void(size_t)>& f) {
+      auto wq = workqueue_foreach<size_t>(
+          f, std::min(indices.size(), redex_parallel::default_num_threads()));
+      for (auto i : indices) {
+        wq.add_item(i);
+      }
+      wq.run_all();
+    };
+    std::vector<size_t> all_indices(batch.size());
+    std::iota(all_indices.begin(), all_indices.end(), 0);
+
+    // Inflating and parsing are independent for each class file...
+    for_each_parallel(all_indices, [&](size_t i) {
+      auto& file = *class_files[begin + i];
+      auto& class_file = batch[i];
+      size_t size = file.cd_entry.ucomp_size;
+      class_file.buffer = std::make_unique<uint8_t[]>(size);
+      class_file.ok =
+          decompress_class(file, mapping, class_file.buffer.get(), size) &&
+          parse_class_header(class_file.buffer.get(), class_file.parsed);
+    });
+
+    // ... except that duplicates are found in order, as the first definition
+    // wins. Their members don't need to be parsed, unless they go into the
+    // cache, which must not depend on what was loaded before.
+    std::vector<size_t> body_indices;
+    std::unordered_set<DexType*> batch_types;
+    for (size_t i = 0; i < batch.size(); i++) {
+      auto& class_file = batch[i];
+      if (!class_file.ok) {
+        return false;
+      }
+      auto self = class_file.parsed.self;
+      class_file.duplicate =
+          type_class(self) != nullptr || !batch_types.insert(self).second;
+      if (!class_file.duplicate || cache_writer != nullptr) {
+        body_indices.push_back(i);
+      }
     }
-
-    if (!parse_class(outbuffer, classes, attr_hook, location)) {
-      free(outbuffer);
-      return false;
+    for_each_parallel(body_indices, [&](size_t i) {
+      batch[i].ok = parse_class_body(batch[i].parsed);
+    });
+
+    // Classes get defined in order, too.
+    for (auto& class_file : batch) {
+      if (class_file.duplicate) {
+        if (cache_writer != nullptr) {
+          // A malformed duplicate doesn't fail the load, but can't be cached.
+          if (class_file.ok) {
+            cache_writer->add(class_file.parsed);
+          } else {
+            cache_writer->invalidate();
+          }
+        }
+      } else if (!class_file.ok) {
+        return false;
+      } else if (cache_writer != nullptr) {
+        cache_writer->add(class_file.parsed);
+      }
+      if (!define_class(class_file.parsed, classes, attr_hook, location)) {
+        return false;
+      }
     }
   }
-  free(outbuffer);
   return true;
 }
 
-bool process_jar(const char* location,
-                 const uint8_t* mapping,
-                 ssize_t size,
-                 Scope* classes,
-                 const attribute_hook_t& attr_hook) {
+static bool process_jar(const char* location,
+                        const uint8_t* mapping,
+                        ssize_t size,
+                        Scope* classes,
+                        const attribute_hook_t& attr_hook,
+                        JarCacheWriter* cache_writer) {
   pk_cdir_end pce;
   std::vector<jar_entry> files;
   if (!find_central_directory(mapping, size, pce)) return false;
   if (!validate_pce(pce, size)) return false;
   if (!get_jar_entries(mapping, pce, files)) return false;
-  if (!process_jar_entries(location, files, mapping, classes, attr_hook)) {
+  if (!process_jar_entries(location, files, mapping, classes, attr_hook,
+                           cache_writer)) {
     return false;
   }
   return true;
 }
 
+bool process_jar(const char* location,
+                 const uint8_t* mapping,
+                 ssize_t size,
+                 Scope* classes,
+                 const attribute_hook_t& attr_hook) {
+  return process_jar(location, mapping, size, classes, attr_hook,
+                     /* cache_writer */ nullptr);
+}
+
 bool load_jar_file(const char* location,
                    Scope* classes,
-                   const attribute_hook_t& attr_hook) {
+                   const attribute_hook_t& attr_hook,
+                   const std::string& cache_dir) {
   boost::iostreams::mapped_file file;
   try {
     file.open(location, boost::iostreams::mapped_file::readonly);
@@ -821,10 +1274,52 @@ bool load_jar_file(const char* location,
   }
 
   auto mapping = reinterpret_cast<const uint8_t*>(file.const_data());
-  if (!process_jar(location, mapping, file.size(), classes, attr_hook)) {
+  // The cache doesn't keep attributes, so it can't serve attribute hooks.
+  if (cache_dir.empty() || attr_hook != nullptr) {
+    if (!process_jar(location, mapping, file.size(), classes, attr_hook)) {
+      fprintf(stderr, "error: cannot process jar: %s\n", location);
+      return false;
+    }
+    return true;
+  }
+
+  uint8_t jar_sha1[kSha1Size];
+  hash_jar(mapping, file.size(), jar_sha1);
+  std::string cache_name;
+  for (auto byte : jar_sha1) {
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02x", byte);
+    cache_name += hex;
+  }
+  cache_name += ".jarcache";
+  auto cache_path = (boost::filesystem::path(cache_dir) / cache_name).string();
+  auto cached =
+      load_jar_cache(cache_path, jar_sha1, file.size(), location, classes);
+  if (cached) {
+    if (!*cached) {
+      fprintf(stderr, "error: cannot process jar: %s\n", location);
+      return false;
+    }
+    TRACE(MAIN, 2, "Loaded %s from %s", location, cache_path.c_str());
+    return true;
+  }
+
+  JarCacheWriter cache_writer;
+  if (!process_jar(location, mapping, file.size(), classes, attr_hook,
+                   &cache_writer)) {
     fprintf(stderr, "error: cannot process jar: %s\n", location);
     return false;
   }
+  if (!cache_writer.valid()) {
+    TRACE(MAIN, 1, "Warning: not caching jar %s", location);
+    return true;
+  }
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(cache_dir, ec);
+  if (ec || !cache_writer.write(cache_path, jar_sha1, file.size())) {
+    TRACE(MAIN, 1, "Warning: could not write jar cache %s",
+          cache_path.c_str());
+  }
   return true;
 }
 
@@ -26,9 +26,16 @@ using attribute_hook_t =
                        const char* attribute_name,
                        uint8_t* attribute_pointer)>;
 
+/*
+ * If a cache directory is given, the parsed classes of the jar are stored
+ * there, keyed on the contents of the jar, and loading the same jar again
+ * reads them from the cache instead. The cache is bypassed when an attribute
+ * hook is given.
+ */
 bool load_jar_file(const char* location,
                    Scope* classes = nullptr,
-                   const attribute_hook_t& = nullptr);
+                   const attribute_hook_t& = nullptr,
+                   const std::string& cache_dir = "");
 
 bool load_class_file(const std::string& filename, Scope* classes = nullptr);
 
@@ -8,12 +8,16 @@
 #include "MethodProfiles.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "Trace.h"
+#include "WorkQueue.h"
 
 using namespace method_profiles;
 
@@ -21,23 +25,48 @@ extern int errno;
 
 namespace {
 
+// The main section of a stats file can have millions of lines; it gets parsed
+// in chunks of about this size in parallel.
+constexpr size_t kChunkSize = 1 << 20;
+
 template <class Func>
 bool parse_cells(std::string& line, const Func& parse_cell) {
-  char* save_ptr = nullptr;
-  char* tok = const_cast<char*>(line.c_str());
+  char* tok = &line[0];
+  char* end = tok + line.size();
   uint32_t i = 0;
-  // Assuming there are no quoted strings containing commas!
-  while ((tok = strtok_r(tok, ",", &save_ptr)) != nullptr) {
-    bool success = parse_cell(tok, i);
-    if (!success) {
-      return false;
+  // Assuming there are no quoted strings containing commas! Just like
+  // strtok, this skips empty cells.
+  while (tok < end) {
+    auto comma = static_cast<char*>(memchr(tok, ',', end - tok));
+    if (comma == nullptr) {
+      comma = end;
+    } else {
+      *comma = '\0';
     }
-    tok = nullptr;
-    ++i;
+    if (comma != tok) {
+      bool success = parse_cell(tok, i);
+      if (!success) {
+        return false;
+      }
+      ++i;
+    }
+    tok = comma + 1;
   }
   return true;
 }
 
+// Copy the line starting at p, without the line terminator, into line, and
+// return the start of the next line.
+const char* read_line(const char* p, const char* end, std::string& line) {
+  auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+  if (nl == nullptr) {
+    line.assign(p, end);
+    return end;
+  }
+  line.assign(p, nl);
+  return nl + 1;
+}
+
 } // namespace
 
 const StatsMap& MethodProfiles::method_stats(
@@ -67,29 +96,38 @@ bool MethodProfiles::parse_stats_file(const std::string& csv_filename) {
     return false;
   }
 
-  // Using C-style file reading and parsing because it's faster than the
-  // iostreams equivalent and we expect to read very large csv files.
-  std::ifstream ifs(csv_filename);
+  std::ifstream ifs(csv_filename, std::ios::binary | std::ios::ate);
   if (!ifs.good()) {
     std::cerr << "FAILED to open " << csv_filename << std::endl;
     return false;
   }
+  auto file_size = ifs.tellg();
+  ifs.close();
+  // Empty files can't be mapped.
+  boost::iostreams::mapped_file_source file;
+  const char* p = nullptr;
+  const char* end = nullptr;
+  if (file_size > 0) {
+    file.open(csv_filename);
+    p = file.data();
+    end = p + file.size();
+  }
 
-  // getline will allocate a buffer and put a pointer to it here
+  // The headers and the metadata come first, followed by the main section.
   std::string line;
-  while (std::getline(ifs, line)) {
+  while (p < end && m_mode != MAIN) {
+    p = read_line(p, end, line);
     bool success = false;
     if (m_mode == NONE) {
       success = parse_header(line);
     } else {
-      success = parse_line(line);
+      success = parse_metadata(line);
     }
     if (!success) {
       return false;
     }
   }
-  if (ifs.bad()) {
-    std::cerr << "FAILED to read a line!" << std::endl;
+  if (p < end && !parse_main_lines(p, end)) {
     return false;
   }
 
@@ -99,6 +137,118 @@ bool MethodProfiles::parse_stats_file(const std::string& csv_filename) {
   return true;
 }
 
+bool MethodProfiles::parse_main_lines(const char* begin, const char* end) {
+  struct Chunk {
+    const char* begin;
+    const char* end;
+    std::vector<MainRow> rows;
+    // Parsing stops at the first bad line.
+    bool success{true};
+    // An exception must not escape a worker thread. It is rethrown once the
+    // rows preceding the line that caused it have been added.
+    std::exception_ptr error;
+  };
+  std::vector<Chunk> chunks;
+  while (begin < end) {
+    const char* chunk_end = end;
+    if (static_cast<size_t>(end - begin) > kChunkSize) {
+      auto nl = static_cast<const char*>(
+          memchr(begin + kChunkSize, '\n', end - begin - kChunkSize));
+      if (nl != nullptr) {
+        chunk_end = nl + 1;
+      }
+    }
+    chunks.push_back(Chunk{begin, chunk_end});
+    begin = chunk_end;
+  }
+
+  {
+    Timer t("Parsing method profile lines");
+    auto wq = workqueue_foreach<Chunk*>([this](Chunk* chunk) {
+      std::string line;
+      const char* p = chunk->begin;
+      while (p < chunk->end) {
+        MainRow row;
+        row.line_begin = p;
+        p = read_line(p, chunk->end, line);
+        row.line_end = row.line_begin + line.size();
+        try {
+          if (!parse_main(line, &row)) {
+            chunk->success = false;
+            return;
+          }
+        } catch (...) {
+          chunk->error = std::current_exception();
+          return;
+        }
+        chunk->rows.push_back(std::move(row));
+      }
+    });
+    for (auto& chunk : chunks) {
+      wq.add_item(&chunk);
+    }
+    wq.run_all();
+  }
+
+  {
+    Timer t("Resolving method profile names");
+    auto wq = workqueue_foreach<Chunk*>([](Chunk* chunk) {
+      for (size_t i = 0; i < chunk->rows.size(); ++i) {
+        auto& row = chunk->rows[i];
+        if (row.name.empty()) {
+          continue;
+        }
+        try {
+          row.ref = DexMethod::get_method</*kCheckFormat=*/true>(row.name);
+        } catch (...) {
+          // This line comes before any line that failed to parse.
+          chunk->error = std::current_exception();
+          chunk->rows.resize(i);
+          return;
+        }
+        if (row.ref == nullptr) {
+          TRACE(METH_PROF, 6, "failed to resolve %s", row.name.c_str());
+        }
+      }
+    });
+    for (auto& chunk : chunks) {
+      wq.add_item(&chunk);
+    }
+    wq.run_all();
+  }
+
+  // Lines are added in order, so that the first line wins for every method,
+  // just like it would when reading the lines one by one.
+  for (auto& chunk : chunks) {
+    for (auto& row : chunk.rows) {
+      if (row.interaction_id.empty()) {
+        // Interaction IDs from the current row have priority over the
+        // interaction id from the top of the file. This shouldn't happen in
+        // practice, but this is the conservative approach.
+        row.interaction_id = m_interaction_id;
+      }
+      if (row.ref != nullptr) {
+        TRACE(METH_PROF, 6, "(%s, %s) -> {%f, %f, %f, %d}", SHOW(row.ref),
+              row.interaction_id.c_str(), row.stats.appear_percent,
+              row.stats.call_count, row.stats.order_percent,
+              row.stats.min_api_level);
+        m_method_stats[row.interaction_id].emplace(row.ref, row.stats);
+      } else {
+        auto& lines = m_unresolved_lines[row.interaction_id];
+        lines.emplace_back(row.line_begin, row.line_end);
+        TRACE(METH_PROF, 6, "unresolved: %s", lines.back().c_str());
+      }
+    }
+    if (chunk.error) {
+      std::rethrow_exception(chunk.error);
+    }
+    if (!chunk.success) {
+      return false;
+    }
+  }
+  return true;
+}
+
 int64_t parse_int(const char* tok) {
   char* rest = nullptr;
   const auto result = strtol(tok, &rest, 10);
@@ -155,11 +305,10 @@ bool MethodProfiles::parse_metadata(std::string& line) {
   return true;
 }
 
-bool MethodProfiles::parse_main(std::string& line) {
+bool MethodProfiles::parse_main(std::string& line, MainRow* row) const {
   always_assert(m_mode == MAIN);
-  Stats stats;
-  std::string interaction_id;
-  DexMethodRef* ref = nullptr;
+  auto& stats = row->stats;
+  auto& interaction_id = row->interaction_id;
   auto parse_cell = [&](char* tok, uint32_t col) -> bool {
     switch (col) {
     case INDEX:
@@ -167,10 +316,8 @@ bool MethodProfiles::parse_main(std::string& line) {
       // the file)
       return true;
     case NAME:
-      ref = DexMethod::get_method</*kCheckFormat=*/true>(tok);
-      if (ref == nullptr) {
-        TRACE(METH_PROF, 6, "failed to resolve %s", tok);
-      }
+      // Resolved later, in bulk
+      row->name = tok;
       return true;
     case APPEAR100:
       stats.appear_percent = parse_double(tok);
@@ -212,37 +359,7 @@ bool MethodProfiles::parse_main(std::string& line) {
     }
   };
 
-  std::string copy(line);
-  bool success = parse_cells(line, parse_cell);
-  if (!success) {
-    return false;
-  }
-  if (interaction_id.empty()) {
-    // Interaction IDs from the current row have priority over the interaction
-    // id from the top of the file. This shouldn't happen in practice, but this
-    // is the conservative approach.
-    interaction_id = m_interaction_id;
-  }
-  if (ref != nullptr) {
-    TRACE(METH_PROF, 6, "(%s, %s) -> {%f, %f, %f, %d}", SHOW(ref),
-          interaction_id.c_str(), stats.appear_percent, stats.call_count,
-          stats.order_percent, stats.min_api_level);
-    m_method_stats[interaction_id].emplace(ref, stats);
-  } else {
-    m_unresolved_lines[interaction_id].push_back(copy);
-    TRACE(METH_PROF, 6, "unresolved: %s", copy.c_str());
-  }
-  return true;
-}
-
-bool MethodProfiles::parse_line(std::string& line) {
-  if (m_mode == MAIN) {
-    return parse_main(line);
-  } else if (m_mode == METADATA) {
-    return parse_metadata(line);
-  } else {
-    always_assert_log(false, "invalid parsing mode");
-  }
+  return parse_cells(line, parse_cell);
 }
 
 boost::optional<uint32_t> MethodProfiles::get_interaction_count(
@@ -260,10 +377,9 @@ void MethodProfiles::process_unresolved_lines() {
   m_unresolved_lines.clear();
   for (auto& pair : unresolved_lines) {
     m_interaction_id = pair.first;
-    for (auto& line : pair.second) {
-      bool success = parse_main(line);
-      always_assert(success);
-    }
+    auto lines = boost::algorithm::join(pair.second, "\n");
+    bool success = parse_main_lines(lines.data(), lines.data() + lines.size());
+    always_assert(success);
   }
 
   size_t total_rows = 0;
@@ -147,15 +147,29 @@ class MethodProfiles {
   std::string m_interaction_id;
   bool m_initialized{false};
 
+  // A line from the main section of the aggregated stats file, parsed but not
+  // resolved yet.
+  struct MainRow {
+    // The line itself, kept in case the method can't be resolved
+    const char* line_begin{nullptr};
+    const char* line_end{nullptr};
+    std::string name;
+    // Empty if the line doesn't have an interaction column
+    std::string interaction_id;
+    Stats stats;
+    DexMethodRef* ref{nullptr};
+  };
+
   // Read a "simple" csv file (no quoted commas or extra spaces) and populate
   // m_method_stats
   bool parse_stats_file(const std::string& csv_filename);
 
-  // Read a line of data (not a header)
-  bool parse_line(std::string& line);
-  // Read a line from the main section of the aggregated stats file and put an
-  // entry into m_method_stats
-  bool parse_main(std::string& line);
+  // Parse and resolve the lines of the main section in [begin, end), in
+  // parallel, and put entries into m_method_stats (or m_unresolved_lines)
+  bool parse_main_lines(const char* begin, const char* end);
+  // Read a line from the main section of the aggregated stats file. This
+  // doesn't change any state, so lines can be parsed in parallel
+  bool parse_main(std::string& line, MainRow* row) const;
   // Read a line of data from the metadata section (at the top of the file)
   bool parse_metadata(std::string& line);
 
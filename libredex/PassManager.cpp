@@ -8,6 +8,7 @@
 #include "PassManager.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
 #include <cinttypes>
 #include <cstdio>
 #include <typeinfo>
@@ -16,6 +17,7 @@
 #include "ApiLevelChecker.h"
 #include "ApkManager.h"
 #include "CommandProfiling.h"
+#include "ConcurrentContainers.h"
 #include "ConfigFiles.h"
 #include "Debug.h"
 #include "DexClass.h"
@@ -23,6 +25,7 @@
 #include "DexOutput.h"
 #include "DexUtil.h"
 #include "GraphVisualizer.h"
+#include "HierarchyService.h"
 #include "IRCode.h"
 #include "IRTypeChecker.h"
 #include "InstructionLowering.h"
@@ -35,6 +38,7 @@
 #include "Sanitizers.h"
 #include "Timer.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -48,6 +52,94 @@ std::string get_apk_dir(const Json::Value& config) {
   return apkdir;
 }
 
+/*
+ * Remembers the code versions of methods which passed the type checker, so
+ * that running it after each pass only re-checks the methods that changed.
+ * The results depend on the class hierarchy via assignability checks, so
+ * they are dropped whenever the hierarchy changes.
+ */
+struct TypeCheckerCache {
+  // A fingerprint of the code of a method, including the positions that
+  // branches and try regions refer to. Field and method refs can be changed
+  // in place, so their current signatures are included, not just the refs.
+  static size_t get_code_version(const DexMethod* method) {
+    auto code = method->get_code();
+    std::unordered_map<const MethodItemEntry*, uint32_t> positions;
+    for (const auto& mie : *code) {
+      positions.emplace(&mie, positions.size());
+    }
+    size_t seed = 0;
+    boost::hash_combine(seed, method->get_class());
+    boost::hash_combine(seed, method->get_proto());
+    boost::hash_combine(seed, method->get_access());
+    boost::hash_combine(seed, code->get_registers_size());
+    for (const auto& mie : *code) {
+      boost::hash_combine(seed, mie.type);
+      switch (mie.type) {
+      case MFLOW_OPCODE: {
+        auto insn = mie.insn;
+        boost::hash_combine(seed, insn->opcode());
+        for (auto src : insn->srcs()) {
+          boost::hash_combine(seed, src);
+        }
+        if (insn->has_dest()) {
+          boost::hash_combine(seed, insn->dest());
+        }
+        boost::hash_combine(seed, insn->hash());
+        if (insn->has_field()) {
+          auto field = insn->get_field();
+          boost::hash_combine(seed, field->get_class());
+          boost::hash_combine(seed, field->get_name());
+          boost::hash_combine(seed, field->get_type());
+        } else if (insn->has_method()) {
+          auto callee = insn->get_method();
+          boost::hash_combine(seed, callee->get_class());
+          boost::hash_combine(seed, callee->get_name());
+          boost::hash_combine(seed, callee->get_proto());
+        }
+        break;
+      }
+      case MFLOW_TRY:
+        boost::hash_combine(seed, mie.tentry->type);
+        boost::hash_combine(seed, positions.at(mie.tentry->catch_start));
+        break;
+      case MFLOW_CATCH:
+        boost::hash_combine(seed, mie.centry->catch_type);
+        if (mie.centry->next != nullptr) {
+          boost::hash_combine(seed, positions.at(mie.centry->next));
+        }
+        break;
+      case MFLOW_TARGET:
+        boost::hash_combine(seed, mie.target->type);
+        boost::hash_combine(seed, positions.at(mie.target->src));
+        if (mie.target->type == BRANCH_MULTI) {
+          boost::hash_combine(seed, mie.target->case_key);
+        }
+        break;
+      default:
+        // Debug info, positions and fallthroughs don't affect type checking.
+        break;
+      }
+    }
+    return seed;
+  }
+
+  static size_t get_hierarchy_version(const Scope& scope) {
+    size_t seed = 0;
+    for (auto cls : scope) {
+      boost::hash_combine(seed, cls->get_type());
+      boost::hash_combine(seed, cls->get_super_class());
+      boost::hash_combine(seed, cls->get_interfaces());
+      boost::hash_combine(seed, cls->get_access());
+    }
+    return seed;
+  }
+
+  ConcurrentMap<const DexMethod*, size_t> code_versions;
+  size_t hierarchy_version{0};
+  size_t hits{0};
+};
+
 struct TypeCheckerConfig {
   explicit TypeCheckerConfig(const ConfigFiles& conf) {
     const Json::Value& type_checker_args =
@@ -61,6 +153,8 @@ struct TypeCheckerConfig {
     verify_moves = type_checker_args.get("verify_moves", true).asBool();
     check_no_overwrite_this =
         type_checker_args.get("check_no_overwrite_this", false).asBool();
+    skip_unchanged_methods =
+        type_checker_args.get("skip_unchanged_methods", true).asBool();
 
     for (auto& trigger_pass : type_checker_args["run_after_passes"]) {
       type_checker_trigger_passes.insert(trigger_pass.asString());
@@ -112,37 +206,111 @@ struct TypeCheckerConfig {
   }
 
   // TODO(fengliu): Kill the `validate_access` flag.
-  static boost::optional<std::string> run_verifier(const Scope& scope,
-                                                   bool verify_moves,
-                                                   bool check_no_overwrite_this,
-                                                   bool validate_access,
-                                                   bool exit_on_fail = true) {
+  static boost::optional<std::string> run_verifier(
+      const Scope& scope,
+      bool verify_moves,
+      bool check_no_overwrite_this,
+      bool validate_access,
+      bool exit_on_fail = true,
+      TypeCheckerCache* cache = nullptr) {
     TRACE(PM, 1, "Running IRTypeChecker...");
     Timer t("IRTypeChecker");
-    std::atomic<size_t> errors{0};
-    boost::optional<std::string> first_error_msg;
-    walk::parallel::methods(scope, [&](DexMethod* dex_method) {
-      IRTypeChecker checker(dex_method, validate_access);
-      if (verify_moves) {
-        checker.verify_moves();
-      }
-      if (check_no_overwrite_this) {
-        checker.check_no_overwrite_this();
-      }
-      checker.run();
-      if (checker.fail()) {
-        bool first = errors.fetch_add(1) == 0;
-        if (first) {
-          std::ostringstream oss;
-          oss << "Inconsistency found in Dex code for " << show(dex_method)
-              << std::endl
-              << " " << checker.what() << std::endl
-              << "Code:" << std::endl
-              << show(dex_method->get_code());
-          first_error_msg = oss.str();
-        }
+
+    // Methods to check, with their code versions and sizes.
+    struct MethodToCheck {
+      DexMethod* method;
+      size_t code_version;
+      size_t size;
+    };
+    if (cache != nullptr) {
+      auto hierarchy_version = TypeCheckerCache::get_hierarchy_version(scope);
+      if (hierarchy_version != cache->hierarchy_version) {
+        cache->code_versions.clear();
+        cache->hierarchy_version = hierarchy_version;
       }
+    }
+    std::vector<MethodToCheck> methods;
+    walk::code(scope, [&](DexMethod* dex_method, IRCode&) {
+      methods.push_back({dex_method, 0, 0});
     });
+    auto versions_wq = workqueue_foreach<MethodToCheck*>(
+        [cache](MethodToCheck* to_check) {
+          auto dex_method = to_check->method;
+          to_check->size = dex_method->get_code()->count_opcodes();
+          if (cache == nullptr) {
+            return;
+          }
+          to_check->code_version =
+              TypeCheckerCache::get_code_version(dex_method);
+          auto it = cache->code_versions.find(dex_method);
+          if (it != cache->code_versions.end() &&
+              it->second == to_check->code_version) {
+            // Passed before, and nothing changed since.
+            to_check->method = nullptr;
+          }
+        });
+    for (auto& to_check : methods) {
+      versions_wq.add_item(&to_check);
+    }
+    versions_wq.run_all();
+    auto num_methods = methods.size();
+    methods.erase(std::remove_if(methods.begin(), methods.end(),
+                                 [](const MethodToCheck& to_check) {
+                                   return to_check.method == nullptr;
+                                 }),
+                  methods.end());
+    auto cache_hits = num_methods - methods.size();
+
+    // Type checking is roughly linear in the size of a method. Start with the
+    // largest methods, so that they don't end up as stragglers.
+    std::sort(methods.begin(), methods.end(),
+              [](const MethodToCheck& a, const MethodToCheck& b) {
+                if (a.size != b.size) {
+                  return a.size > b.size;
+                }
+                return compare_dexmethods(a.method, b.method);
+              });
+    if (cache != nullptr) {
+      cache->hits += cache_hits;
+      TRACE(PM, 2, "IRTypeChecker: %zu methods unchanged, %zu to check",
+            cache_hits, methods.size());
+    }
+
+    std::atomic<size_t> errors{0};
+    boost::optional<std::string> first_error_msg;
+    auto wq = workqueue_foreach<const MethodToCheck*>(
+        [&](const MethodToCheck* to_check) {
+          auto dex_method = to_check->method;
+          IRTypeChecker checker(dex_method, validate_access);
+          if (verify_moves) {
+            checker.verify_moves();
+          }
+          if (check_no_overwrite_this) {
+            checker.check_no_overwrite_this();
+          }
+          checker.run();
+          if (checker.fail()) {
+            bool first = errors.fetch_add(1) == 0;
+            if (first) {
+              std::ostringstream oss;
+              oss << "Inconsistency found in Dex code for " << show(dex_method)
+                  << std::endl
+                  << " " << checker.what() << std::endl
+                  << "Code:" << std::endl
+                  << show(dex_method->get_code());
+              first_error_msg = oss.str();
+            }
+          } else if (cache != nullptr) {
+            cache->code_versions.update(
+                dex_method, [&](const DexMethod*, size_t& code_version, bool) {
+                  code_version = to_check->code_version;
+                });
+          }
+        });
+    for (const auto& to_check : methods) {
+      wq.add_item(&to_check);
+    }
+    wq.run_all();
 
     if (errors.load() > 0 && exit_on_fail) {
       redex_assert(first_error_msg);
@@ -166,6 +334,9 @@ struct TypeCheckerConfig {
   bool run_type_checker_on_input_ignore_access;
   bool verify_moves;
   bool check_no_overwrite_this;
+  // Whether to only re-check methods that changed after each pass.
+  bool skip_unchanged_methods;
+  TypeCheckerCache cache;
 };
 
 struct ScopedVmHWM {
@@ -243,6 +414,7 @@ PassManager::PassManager(
     const RedexOptions& options)
     : m_apk_mgr(get_apk_dir(config)),
       m_registered_passes(passes),
+      m_hierarchy_service(std::make_unique<HierarchyService>()),
       m_current_pass_info(nullptr),
       m_pg_config(std::move(pg_config)),
       m_redex_options(options),
@@ -348,12 +520,18 @@ hashing::DexHash PassManager::run_hasher(const char* pass_name,
   return hash;
 }
 
+PassManager::~PassManager() {}
+
 void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   DexStoreClassesIterator it(stores);
   Scope scope = build_class_scope(it);
 
   // Clear stale data. Make sure we start fresh.
   m_preserved_analysis_passes.clear();
+  const Json::Value& hierarchy_service_args =
+      conf.get_json_config()["hierarchy_service"];
+  m_hierarchy_service = std::make_unique<HierarchyService>(
+      hierarchy_service_args.get("validate", false).asBool());
 
   {
     Timer t("API Level Checker");
@@ -513,9 +691,13 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
       if (run_type_checker) {
         // It's OK to overwrite the `this` register if we are not yet at the
         // output phase -- the register allocator can fix it up later.
-        TypeCheckerConfig::run_verifier(scope, checker_conf.verify_moves,
-                                        /* check_no_overwrite_this */ false,
-                                        /* validate_access */ false);
+        TypeCheckerConfig::run_verifier(
+            scope, checker_conf.verify_moves,
+            /* check_no_overwrite_this */ false,
+            /* validate_access */ false,
+            /* exit_on_fail */ true,
+            checker_conf.skip_unchanged_methods ? &checker_conf.cache
+                                                : nullptr);
       }
       if (run_check_unique_deobfuscated_names_after_each_pass) {
         check_unique_deobfuscated_names(pass->name().c_str(), scope);
@@ -559,6 +741,15 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   class_cfgs.add_pass("After all passes");
   class_cfgs.write();
 
+  TRACE(PM, 1, "IRTypeChecker: skipped %zu unchanged methods after passes",
+        checker_conf.cache.hits);
+  const auto& hierarchy_stats = m_hierarchy_service->get_stats();
+  TRACE(PM, 1,
+        "Hierarchy service: %zu reused, %zu incremental updates, %zu full "
+        "builds",
+        hierarchy_stats.reused, hierarchy_stats.incremental_updates,
+        hierarchy_stats.full_builds);
+
   if (!conf.get_printseeds().empty()) {
     Timer t("Writing outgoing classes to file " + conf.get_printseeds() +
             ".outgoing");
@@ -21,6 +21,8 @@
 #include <utility>
 #include <vector>
 
+class HierarchyService;
+
 class PassManager {
  public:
   explicit PassManager(
@@ -33,6 +35,8 @@ class PassManager {
               const Json::Value& config = Json::Value(Json::objectValue),
               const RedexOptions& options = RedexOptions{});
 
+  ~PassManager();
+
   struct PassInfo {
     const Pass* pass;
     size_t order; // zero-based
@@ -77,6 +81,9 @@ class PassManager {
 
   bool regalloc_has_run() { return m_regalloc_has_run; }
 
+  // Class hierarchy and method override graph, maintained across passes.
+  HierarchyService& hierarchy_service() { return *m_hierarchy_service; }
+
   template <typename PassType>
   PassType* get_preserved_analysis() const {
     auto pass = m_preserved_analysis_passes.find(typeid(PassType).name());
@@ -99,6 +106,7 @@ class PassManager {
   std::vector<Pass*> m_registered_passes;
   std::vector<Pass*> m_activated_passes;
   std::unordered_map<AnalysisID, Pass*> m_preserved_analysis_passes;
+  std::unique_ptr<HierarchyService> m_hierarchy_service;
 
   // Per-pass information and metrics
   std::vector<PassManager::PassInfo> m_pass_info;
@@ -43,6 +43,8 @@ class PriorityThreadPool {
   size_t m_running_work_items{0};
   boost::condition_variable m_condition;
   std::chrono::duration<double> m_waited_time;
+  std::chrono::duration<double> m_busy_time{0};
+  int m_num_threads{0};
 
  public:
   // Creates an instance with a default number of threads
@@ -63,11 +65,20 @@ class PriorityThreadPool {
         .count();
   }
 
+  // Accumulated time spent by all threads executing work items.
+  long get_busy_seconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(m_busy_time)
+        .count();
+  }
+
+  int get_num_threads() const { return m_num_threads; }
+
   // The number of threads may be set at most once to a positive number
   void set_num_threads(int num_threads) {
     always_assert(!m_pool);
     if (num_threads > 0) {
       m_pool = std::make_unique<boost::asio::thread_pool>(num_threads);
+      m_num_threads = num_threads;
     }
   }
 
@@ -94,10 +105,13 @@ class PriorityThreadPool {
         m_running_work_items++;
       }
       // Run!
+      auto start = std::chrono::system_clock::now();
       highest_priority_f();
+      auto end = std::chrono::system_clock::now();
       // Notify when *all* work is done, i.e. nothing is running or pending.
       {
         boost::mutex::scoped_lock lock(m_mutex);
+        m_busy_time += end - start;
         if (--m_running_work_items == 0 && m_pending_work_items.empty()) {
           m_condition.notify_one();
         }
@@ -7,6 +7,11 @@
 
 #include "ProguardMap.h"
 
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <exception>
+#include <iterator>
+
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "Timer.h"
@@ -37,21 +42,25 @@ std::string convert_scalar_type(const std::string& type) {
 std::string convert_field(const std::string& cls,
                           const std::string& type,
                           const std::string& name) {
-  std::ostringstream ss;
-  ss << cls << "." << name;
+  std::string res;
+  res.reserve(cls.size() + name.size() + type.size() + 2);
+  res.append(cls).append(1, '.').append(name);
   if (!type.empty()) {
-    ss << ":" << type;
+    res.append(1, ':').append(type);
   }
-  return ss.str();
+  return res;
 }
 
 std::string convert_method(const std::string& cls,
                            const std::string& rtype,
                            const std::string& methodname,
                            const std::string& args) {
-  std::ostringstream ss;
-  ss << cls << "." << methodname << ":(" << args << ")" << rtype;
-  return ss.str();
+  std::string res;
+  res.reserve(cls.size() + methodname.size() + args.size() + rtype.size() +
+              4);
+  res.append(cls).append(1, '.').append(methodname).append(":(");
+  res.append(args).append(1, ')').append(rtype);
+  return res;
 }
 
 std::string translate_type(const std::string& type, const ProguardMap& pm) {
@@ -142,14 +151,75 @@ bool is_maybe_proguard_generated_member(const std::string& s) {
   }
   return false;
 }
+
+// Mapping files can be hundreds of megabytes large; they get parsed in chunks
+// of about this size in parallel.
+constexpr size_t kChunkSize = 1 << 20;
+
+struct Chunk {
+  const char* begin;
+  const char* end;
+};
+
+// Split the buffer into chunks of whole lines.
+std::vector<Chunk> split_into_chunks(const char* data, size_t size) {
+  std::vector<Chunk> chunks;
+  const char* end = data + size;
+  const char* p = data;
+  while (p < end) {
+    const char* chunk_end = end;
+    if (static_cast<size_t>(end - p) > kChunkSize) {
+      auto nl = static_cast<const char*>(
+          memchr(p + kChunkSize, '\n', end - p - kChunkSize));
+      if (nl != nullptr) {
+        chunk_end = nl + 1;
+      }
+    }
+    chunks.push_back({p, chunk_end});
+    p = chunk_end;
+  }
+  return chunks;
+}
+
+// Calls fn on every line of the chunk, without the line terminator, just like
+// std::getline would produce them. The parsing functions rely on the lines
+// being null-terminated, so every line gets copied into a reused buffer.
+template <typename Fn>
+void for_each_line(const Chunk& chunk, const Fn& fn) {
+  std::string line;
+  const char* p = chunk.begin;
+  while (p < chunk.end) {
+    auto nl = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+    auto line_end = nl != nullptr ? nl : chunk.end;
+    line.assign(p, line_end);
+    fn(line);
+    p = line_end + 1;
+  }
+}
+
+template <typename Map>
+void merge_into(Map& from, Map& to) {
+  for (auto& pair : from) {
+    to[pair.first] = std::move(pair.second);
+  }
+}
+
 } // namespace
 
 ProguardMap::ProguardMap(const std::string& filename) {
   if (!filename.empty()) {
     Timer t("Parsing proguard map");
-    std::ifstream fp(filename);
+    std::ifstream fp(filename, std::ios::binary | std::ios::ate);
     always_assert_log(fp, "Can't open proguard map: %s\n", filename.c_str());
-    parse_proguard_map(fp);
+    auto size = fp.tellg();
+    fp.close();
+    if (size <= 0) {
+      return;
+    }
+    boost::iostreams::mapped_file_source file(filename);
+    always_assert_log(file.is_open(), "Can't map proguard map: %s\n",
+                      filename.c_str());
+    parse_proguard_map(file.data(), file.size());
   }
 }
 
@@ -211,46 +281,120 @@ ProguardLineRangeVector& ProguardMap::method_lines(
 }
 
 void ProguardMap::parse_proguard_map(std::istream& fp) {
-  std::string line;
-  while (std::getline(fp, line)) {
-    parse_class(line);
-  }
-  fp.clear();
-  fp.seekg(0);
-  assert_log(!fp.fail(), "Can't use ProguardMap with non-seekable stream");
-  while (std::getline(fp, line)) {
-    if (parse_class(line)) {
-      continue;
+  std::string buffer((std::istreambuf_iterator<char>(fp)),
+                     std::istreambuf_iterator<char>());
+  parse_proguard_map(buffer.data(), buffer.size());
+}
+
+void ProguardMap::parse_proguard_map(const char* data, size_t size) {
+  auto chunks = split_into_chunks(data, size);
+  std::vector<ProguardMap> chunk_maps(chunks.size());
+  // An exception must not escape a worker thread. The first error of each
+  // chunk is rethrown once all chunks are done, in file order, so that the
+  // first bad line gets reported just like when parsing sequentially.
+  auto run_on_chunks = [&](const std::function<void(size_t)>& fn) {
+    std::vector<std::exception_ptr> errors(chunks.size());
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      try {
+        fn(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      wq.add_item(i);
     }
-    if (parse_field(line)) {
-      continue;
+    wq.run_all();
+    for (const auto& error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
     }
-    if (parse_method(line)) {
-      continue;
+  };
+
+  // First pass: all classes, as members refer to types that need to be
+  // translated.
+  run_on_chunks([&](size_t i) {
+    for_each_line(chunks[i], [&](const std::string& line) {
+      parse_class(line, chunk_maps[i]);
+    });
+  });
+  // Chunks are merged in file order, so that later entries win, just like
+  // they would when parsing sequentially.
+  std::vector<std::pair<std::string, std::string>> initial_classes;
+  initial_classes.reserve(chunks.size());
+  for (auto& chunk_map : chunk_maps) {
+    initial_classes.emplace_back(m_currClass, m_currNewClass);
+    merge_into(chunk_map.m_classMap, m_classMap);
+    merge_into(chunk_map.m_obfClassMap, m_obfClassMap);
+    if (!chunk_map.m_currClass.empty()) {
+      m_currClass = std::move(chunk_map.m_currClass);
+      m_currNewClass = std::move(chunk_map.m_currNewClass);
     }
-    if (comment(line)) {
-      continue;
+    chunk_map = ProguardMap();
+  }
+
+  // Second pass: members, which belong to the last class preceding them,
+  // possibly in an earlier chunk.
+  run_on_chunks([&](size_t i) {
+    auto& chunk_map = chunk_maps[i];
+    chunk_map.m_currClass = initial_classes[i].first;
+    chunk_map.m_currNewClass = initial_classes[i].second;
+    for_each_line(chunks[i], [&](const std::string& line) {
+      if (parse_class(line, chunk_map)) {
+        return;
+      }
+      if (parse_field(line, chunk_map)) {
+        return;
+      }
+      if (parse_method(line, chunk_map)) {
+        return;
+      }
+      if (comment(line)) {
+        return;
+      }
+      not_reached_log("Bogus line encountered in proguard map: %s\n",
+                      line.c_str());
+    });
+  });
+  for (auto& chunk_map : chunk_maps) {
+    merge_into(chunk_map.m_fieldMap, m_fieldMap);
+    merge_into(chunk_map.m_methodMap, m_methodMap);
+    merge_into(chunk_map.m_obfFieldMap, m_obfFieldMap);
+    merge_into(chunk_map.m_obfMethodMap, m_obfMethodMap);
+    merge_into(chunk_map.m_obfUntypedFieldMap, m_obfUntypedFieldMap);
+    merge_into(chunk_map.m_obfUntypedMethodMap, m_obfUntypedMethodMap);
+    for (auto& pair : chunk_map.m_obfMethodLinesMap) {
+      auto& lines = m_obfMethodLinesMap[pair.first];
+      for (auto& range : pair.second) {
+        lines.push_back(std::move(range));
+      }
     }
-    not_reached_log("Bogus line encountered in proguard map: %s\n",
-                    line.c_str());
+    m_pg_coalesced_interfaces.insert(
+        chunk_map.m_pg_coalesced_interfaces.begin(),
+        chunk_map.m_pg_coalesced_interfaces.end());
+  }
+  if (!chunk_maps.empty()) {
+    m_currClass = std::move(chunk_maps.back().m_currClass);
+    m_currNewClass = std::move(chunk_maps.back().m_currNewClass);
   }
 }
 
-bool ProguardMap::parse_class(const std::string& line) {
+bool ProguardMap::parse_class(const std::string& line, ProguardMap& out) {
   std::string classname;
   std::string newname;
   auto p = line.c_str();
   if (!id(p, classname)) return false;
   if (!literal(p, " -> ")) return false;
   if (!id(p, newname)) return false;
-  m_currClass = convert_type(classname);
-  m_currNewClass = convert_type(newname);
-  m_classMap[m_currClass] = m_currNewClass;
-  m_obfClassMap[m_currNewClass] = m_currClass;
+  out.m_currClass = convert_type(classname);
+  out.m_currNewClass = convert_type(newname);
+  out.m_classMap[out.m_currClass] = out.m_currNewClass;
+  out.m_obfClassMap[out.m_currNewClass] = out.m_currClass;
   return true;
 }
 
-bool ProguardMap::parse_field(const std::string& line) {
+bool ProguardMap::parse_field(const std::string& line, ProguardMap& out) const {
   std::string type;
   std::string fieldname;
   std::string newname;
@@ -265,27 +409,28 @@ bool ProguardMap::parse_field(const std::string& line) {
 
   auto ctype = convert_type(type);
   auto xtype = translate_type(ctype, *this);
-  auto pgnew = convert_field(m_currNewClass, xtype, newname);
-  auto pgnew_notype = convert_field(m_currNewClass, "", newname);
-  auto pgold = convert_field(m_currClass, ctype, fieldname);
+  auto pgnew = convert_field(out.m_currNewClass, xtype, newname);
+  auto pgnew_notype = convert_field(out.m_currNewClass, "", newname);
+  auto pgold = convert_field(out.m_currClass, ctype, fieldname);
   // Record interfaces that are coalesced by Proguard.
   if (ctype[0] == 'L' && is_maybe_proguard_generated_member(fieldname)) {
     fprintf(stderr,
             "Type '%s' is touched by Proguard in '%s'\n",
             ctype.c_str(),
             pgold.c_str());
-    m_pg_coalesced_interfaces.insert(ctype);
+    out.m_pg_coalesced_interfaces.insert(ctype);
   }
-  m_fieldMap[pgold] = pgnew;
-  m_obfFieldMap[pgnew] = pgold;
-  m_obfUntypedFieldMap[pgnew_notype] = pgold;
+  out.m_fieldMap[pgold] = pgnew;
+  out.m_obfFieldMap[pgnew] = pgold;
+  out.m_obfUntypedFieldMap[pgnew_notype] = std::move(pgold);
   return true;
 }
 
-bool ProguardMap::parse_method(const std::string& line) {
+bool ProguardMap::parse_method(const std::string& line,
+                               ProguardMap& out) const {
   std::string type;
   std::string methodname;
-  std::string classname = m_currClass;
+  std::string classname = out.m_currClass;
   std::string old_args;
   std::string new_args;
   std::string newname;
@@ -326,13 +471,15 @@ bool ProguardMap::parse_method(const std::string& line) {
   auto old_rtype = convert_type(type);
   auto new_rtype = translate_type(old_rtype, *this);
   auto pgold = convert_method(classname, old_rtype, methodname, old_args);
-  auto pgnew = convert_method(m_currNewClass, new_rtype, newname, new_args);
-  auto pgnew_no_rtype = convert_method(m_currNewClass, "", newname, new_args);
-  m_methodMap[pgold] = pgnew;
-  m_obfMethodMap[pgnew] = pgold;
-  m_obfUntypedMethodMap[pgnew_no_rtype] = pgold;
-  lines->original_name = pgold;
-  m_obfMethodLinesMap[pg_impl::lines_key(pgnew)].push_back(std::move(lines));
+  auto pgnew = convert_method(out.m_currNewClass, new_rtype, newname, new_args);
+  auto pgnew_no_rtype =
+      convert_method(out.m_currNewClass, "", newname, new_args);
+  out.m_methodMap[pgold] = pgnew;
+  out.m_obfMethodMap[pgnew] = pgold;
+  out.m_obfUntypedMethodMap[pgnew_no_rtype] = pgold;
+  lines->original_name = std::move(pgold);
+  out.m_obfMethodLinesMap[pg_impl::lines_key(pgnew)].push_back(
+      std::move(lines));
   return true;
 }
 
@@ -112,10 +112,13 @@ struct ProguardMap {
 
  private:
   void parse_proguard_map(std::istream& fp);
+  void parse_proguard_map(const char* data, size_t size);
 
-  bool parse_class(const std::string& line);
-  bool parse_field(const std::string& line);
-  bool parse_method(const std::string& line);
+  // Lines are parsed into `out`, which starts out as the state of the parse
+  // before the line; types are translated with the classes of this map.
+  static bool parse_class(const std::string& line, ProguardMap& out);
+  bool parse_field(const std::string& line, ProguardMap& out) const;
+  bool parse_method(const std::string& line, ProguardMap& out) const;
 
  private:
   // Unobfuscated to obfuscated maps
@@ -30,12 +30,13 @@ namespace {
 
 using RegexMap = std::unordered_map<std::string, boost::regex>;
 
-std::unique_ptr<boost::regex> make_rx(const std::string& s,
-                                      bool convert = true) {
+using ClassNamePatternMatcher = proguard_parser::ClassNamePatternMatcher;
+
+std::unique_ptr<ClassNamePatternMatcher> make_rx(const std::string& s,
+                                                 bool convert = true) {
   if (s.empty()) return nullptr;
   auto wc = convert ? proguard_parser::convert_wildcard_type(s) : s;
-  auto rx = proguard_parser::form_type_regex(wc);
-  return std::make_unique<boost::regex>(rx);
+  return std::make_unique<ClassNamePatternMatcher>(wc);
 }
 
 std::string get_deobfuscated_name(const DexType* type) {
@@ -46,11 +47,12 @@ std::string get_deobfuscated_name(const DexType* type) {
   return cls->get_deobfuscated_name();
 }
 
-bool match_annotation_rx(const DexClass* cls, const boost::regex& annorx) {
+bool match_annotation_rx(const DexClass* cls,
+                         const ClassNamePatternMatcher& annorx) {
   const auto* annos = cls->get_anno_set();
   if (!annos) return false;
   for (const auto& anno : annos->get_annotations()) {
-    if (boost::regex_match(get_deobfuscated_name(anno->type()), annorx)) {
+    if (annorx.match(get_deobfuscated_name(anno->type()))) {
       return true;
     }
   }
@@ -90,10 +92,15 @@ struct ClassMatcher {
     return match_extends(cls);
   }
 
+  // Every class whose name matches starts with this prefix.
+  std::string class_name_prefix() const {
+    return m_cls ? m_cls->literal_prefix() : "";
+  }
+
  private:
   bool match_name(const DexClass* cls) const {
     const auto& deob_name = cls->get_deobfuscated_name();
-    return boost::regex_match(deob_name, *m_cls);
+    return m_cls->match(deob_name);
   }
 
   bool match_access(const DexClass* cls) const {
@@ -120,7 +127,7 @@ struct ClassMatcher {
       }
     }
     const auto& deob_name = cls->get_deobfuscated_name();
-    return boost::regex_match(deob_name, *m_extends);
+    return m_extends->match(deob_name);
   }
 
   bool search_interfaces(const DexClass* cls) {
@@ -168,10 +175,10 @@ struct ClassMatcher {
   DexAccessFlags setFlags_;
   DexAccessFlags unsetFlags_;
   std::string m_class_name;
-  std::unique_ptr<boost::regex> m_cls;
-  std::unique_ptr<boost::regex> m_anno;
-  std::unique_ptr<boost::regex> m_extends;
-  std::unique_ptr<boost::regex> m_extends_anno;
+  std::unique_ptr<ClassNamePatternMatcher> m_cls;
+  std::unique_ptr<ClassNamePatternMatcher> m_anno;
+  std::unique_ptr<ClassNamePatternMatcher> m_extends;
+  std::unique_ptr<ClassNamePatternMatcher> m_extends_anno;
 
   std::unordered_map<const DexClass*, bool> m_extends_result_cache;
 };
@@ -319,6 +326,7 @@ class ProguardMatcher {
     // may, for instance, forbid renaming of all classes that inherit from a
     // given external class.
     build_extends_or_implements_hierarchy(m_external_classes, &m_hierarchy);
+    build_class_name_index();
   }
 
   void process_proguard_rules(const ProguardConfiguration& pg_config);
@@ -330,6 +338,13 @@ class ProguardMatcher {
 
   DexClass* find_single_class(const std::string& descriptor) const;
 
+  // Calls `f` on all classes whose deobfuscated name starts with `prefix`,
+  // in scope order, followed by external classes if requested.
+  template <typename Fn>
+  void for_each_class_with_prefix(const std::string& prefix,
+                                  bool include_external,
+                                  const Fn& f) const;
+
   const ConcurrentSet<const KeepSpec*>& get_unused_rules() const {
     return m_unused_rules;
   }
@@ -340,6 +355,17 @@ class ProguardMatcher {
   const Scope& m_external_classes;
   ClassHierarchy m_hierarchy;
   ConcurrentSet<const KeepSpec*> m_unused_rules;
+
+  void build_class_name_index();
+
+  // All classes followed by all external classes, sorted by deobfuscated
+  // name, so that the classes sharing a literal prefix form a contiguous
+  // range. Positions refer to the concatenation of both scopes.
+  struct IndexedClass {
+    const std::string* name;
+    size_t position;
+  };
+  std::vector<IndexedClass> m_class_name_index;
 };
 
 // Updates a class, field or method to add keep modifiers.
@@ -717,6 +743,56 @@ DexClass* ProguardMatcher::find_single_class(
   return type_class(typ);
 }
 
+void ProguardMatcher::build_class_name_index() {
+  m_class_name_index.reserve(m_classes.size() + m_external_classes.size());
+  size_t position = 0;
+  for (const auto* scope : {&m_classes, &m_external_classes}) {
+    for (const auto* cls : *scope) {
+      m_class_name_index.push_back(
+          IndexedClass{&cls->get_deobfuscated_name(), position++});
+    }
+  }
+  std::sort(m_class_name_index.begin(), m_class_name_index.end(),
+            [](const IndexedClass& a, const IndexedClass& b) {
+              return *a.name < *b.name;
+            });
+}
+
+template <typename Fn>
+void ProguardMatcher::for_each_class_with_prefix(const std::string& prefix,
+                                                 bool include_external,
+                                                 const Fn& f) const {
+  if (prefix.empty()) {
+    for (const auto& cls : m_classes) {
+      f(cls);
+    }
+    if (include_external) {
+      for (const auto& cls : m_external_classes) {
+        f(cls);
+      }
+    }
+    return;
+  }
+  auto it = std::lower_bound(
+      m_class_name_index.begin(), m_class_name_index.end(), prefix,
+      [](const IndexedClass& a, const std::string& p) { return *a.name < p; });
+  std::vector<size_t> positions;
+  for (; it != m_class_name_index.end() &&
+         it->name->compare(0, prefix.size(), prefix) == 0;
+       ++it) {
+    positions.push_back(it->position);
+  }
+  // Preserve the order in which a full scan would visit the classes.
+  std::sort(positions.begin(), positions.end());
+  for (auto position : positions) {
+    if (position < m_classes.size()) {
+      f(m_classes[position]);
+    } else if (include_external) {
+      f(m_external_classes[position - m_classes.size()]);
+    }
+  }
+}
+
 void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
                                    RuleType rule_type,
                                    bool process_external) {
@@ -750,14 +826,13 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
     ClassMatcher class_match(*keep_rule);
     KeepRuleMatcher rule_matcher(rule_type, *keep_rule, regex_map);
 
-    for (const auto& cls : m_classes) {
-      process_single_keep(class_match, rule_matcher, cls);
-    }
-    if (process_external) {
-      for (const auto& cls : m_external_classes) {
-        process_single_keep(class_match, rule_matcher, cls);
-      }
-    }
+    // Only classes sharing the literal prefix of the class name pattern can
+    // possibly match.
+    for_each_class_with_prefix(
+        class_match.class_name_prefix(), process_external,
+        [&](DexClass* cls) {
+          process_single_keep(class_match, rule_matcher, cls);
+        });
 
     if (rule_matcher.is_unused()) {
       m_unused_rules.insert(keep_rule);
@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cctype>
 #include <cstring>
 
 #include "ProguardMap.h"
@@ -200,5 +201,137 @@ std::string convert_wildcard_type(const std::string& typ) {
   return wildcard_descriptor;
 }
 
+namespace {
+
+// Characters that form_type_regex passes through (or escapes) as literals.
+bool is_literal_name_char(char ch) {
+  if (static_cast<unsigned char>(ch) >= 0x80 || std::isalnum(ch)) {
+    return true;
+  }
+  switch (ch) {
+  case '_':
+  case '$':
+  case '/':
+  case ';':
+  case '[':
+  case '<':
+  case '>':
+  case '-':
+    return true;
+  default:
+    return false;
+  }
+}
+
+constexpr size_t MAX_TOKENS = 63;
+
+} // namespace
+
+ClassNamePatternMatcher::ClassNamePatternMatcher(
+    const std::string& type_pattern) {
+  if (!compile(type_pattern)) {
+    m_literal_prefix.clear();
+    m_tokens.clear();
+    m_regex = std::make_unique<boost::regex>(form_type_regex(type_pattern));
+  }
+}
+
+bool ClassNamePatternMatcher::compile(const std::string& type_pattern) {
+  if (type_pattern.empty()) {
+    return false;
+  }
+  const std::string& pattern =
+      type_pattern == "L*;" ? L_STAR_REGEX : type_pattern;
+  size_t i = 0;
+  for (; i < pattern.size() && is_literal_name_char(pattern[i]); i++) {
+  }
+  m_literal_prefix = pattern.substr(0, i);
+  for (; i < pattern.size(); i++) {
+    const char ch = pattern[i];
+    if (is_literal_name_char(ch)) {
+      m_tokens.push_back({TokenKind::CHAR, ch});
+    } else if (ch == '?') {
+      m_tokens.push_back({TokenKind::ANY_CHAR, 0});
+    } else if (ch == '*') {
+      if (i + 1 < pattern.size() && pattern[i + 1] == '*') {
+        if (i + 2 < pattern.size() && pattern[i + 2] == '*') {
+          // ***: Any type, including primitives and arrays.
+          return false;
+        }
+        m_tokens.push_back({TokenKind::DOUBLE_STAR, 0});
+        i++;
+      } else {
+        m_tokens.push_back({TokenKind::STAR, 0});
+      }
+    } else {
+      return false;
+    }
+    if (m_tokens.size() > MAX_TOKENS) {
+      return false;
+    }
+  }
+  m_char_masks.resize(256);
+  for (size_t t = 0; t < m_tokens.size(); t++) {
+    const auto& token = m_tokens[t];
+    auto bit = uint64_t(1) << t;
+    switch (token.kind) {
+    case TokenKind::CHAR:
+      m_char_masks[static_cast<unsigned char>(token.ch)] |= bit;
+      break;
+    case TokenKind::ANY_CHAR:
+      m_any_char_mask |= bit;
+      break;
+    case TokenKind::STAR:
+      m_star_mask |= bit;
+      break;
+    case TokenKind::DOUBLE_STAR:
+      m_double_star_mask |= bit;
+      break;
+    }
+  }
+  return true;
+}
+
+bool ClassNamePatternMatcher::match(const std::string& name) const {
+  if (m_regex) {
+    return boost::regex_match(name, *m_regex);
+  }
+  if (name.compare(0, m_literal_prefix.size(), m_literal_prefix) != 0) {
+    return false;
+  }
+  // Wildcard tokens may match the empty string, so their states also enable
+  // the following state.
+  const uint64_t wildcards = m_star_mask | m_double_star_mask;
+  auto close = [wildcards](uint64_t states) {
+    uint64_t closed;
+    do {
+      closed = states;
+      states |= (states & wildcards) << 1;
+    } while (states != closed);
+    return states;
+  };
+  uint64_t states = close(1);
+  for (size_t i = m_literal_prefix.size(); i < name.size(); i++) {
+    const char ch = name[i];
+    // Tokens that consume the character and advance to the next state...
+    uint64_t advancing = m_char_masks[static_cast<unsigned char>(ch)];
+    // ... and wildcard tokens that consume it and stay in their state.
+    uint64_t staying = 0;
+    if (ch != '[') {
+      staying |= m_double_star_mask;
+      if (ch != '/') {
+        advancing |= m_any_char_mask;
+        staying |= m_star_mask;
+      }
+    }
+    uint64_t next = ((states & advancing) << 1) | (states & staying);
+    if (next == 0) {
+      return false;
+    }
+    states = close(next);
+  }
+  return (states >> m_tokens.size()) & 1;
+}
+
 } // namespace proguard_parser
 } // namespace keep_rules
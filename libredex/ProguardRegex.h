@@ -7,7 +7,12 @@
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <boost/regex.hpp>
 
 namespace keep_rules {
 namespace proguard_parser {
@@ -17,5 +22,60 @@ std::string form_type_regex(const std::string& proguard_regex);
 bool has_special_char(const std::string& proguard_regex);
 std::string convert_wildcard_type(const std::string& typ);
 
+/*
+ * A compiled matcher for a ProGuard type pattern in descriptor form, i.e. as
+ * returned by convert_wildcard_type. It accepts exactly the same names as a
+ * boost::regex built from form_type_regex(type_pattern).
+ *
+ * Patterns that only consist of literal name characters, `?`, `*` and `**`
+ * (which covers almost all class name patterns found in keep rules) get
+ * compiled into a small automaton that is simulated with a bitset of states,
+ * after checking the pattern's literal prefix. All other patterns fall back
+ * to boost::regex.
+ */
+class ClassNamePatternMatcher {
+ public:
+  explicit ClassNamePatternMatcher(const std::string& type_pattern);
+
+  bool match(const std::string& name) const;
+
+  // Every matching name starts with this prefix. It is empty for patterns
+  // that fall back to boost::regex.
+  const std::string& literal_prefix() const { return m_literal_prefix; }
+
+  bool is_compiled() const { return m_regex == nullptr; }
+
+ private:
+  enum class TokenKind : uint8_t {
+    CHAR,
+    // ?: Any character except the package separator or array prefix.
+    ANY_CHAR,
+    // *: Any part of a class name not containing the package separator.
+    STAR,
+    // **: Any part of a class name, including package separators.
+    DOUBLE_STAR,
+  };
+
+  struct Token {
+    TokenKind kind;
+    char ch;
+  };
+
+  bool compile(const std::string& pattern);
+
+  std::string m_literal_prefix;
+  // The tokens following the literal prefix. State i means that the first i
+  // tokens have been matched; we support up to 63 tokens.
+  std::vector<Token> m_tokens;
+  // Bitsets over states used to simulate the automaton in a bit-parallel
+  // fashion: for each character, the CHAR tokens that accept it, and the
+  // states of the different kinds of wildcard tokens.
+  std::vector<uint64_t> m_char_masks;
+  uint64_t m_any_char_mask{0};
+  uint64_t m_star_mask{0};
+  uint64_t m_double_star_mask{0};
+  std::unique_ptr<boost::regex> m_regex;
+};
+
 } // namespace proguard_parser
 } // namespace keep_rules
@@ -245,10 +245,9 @@ void TransitiveClosureMarker::push(const Parent* parent, const DexClass* cls) {
     return;
   }
   record_reachability(parent, cls);
-  if (m_reachable_objects->marked(cls)) {
+  if (!m_reachable_objects->mark(cls)) {
     return;
   }
-  m_reachable_objects->mark(cls);
   m_worker_state->push_task(ReachableObject(cls));
 }
 
@@ -259,14 +258,13 @@ void TransitiveClosureMarker::push(const Parent* parent,
     return;
   }
   record_reachability(parent, field);
-  if (m_reachable_objects->marked(field)) {
+  if (!m_reachable_objects->mark(field)) {
     return;
   }
   auto f = field->as_def();
   if (f) {
     gather_and_push(f);
   }
-  m_reachable_objects->mark(field);
   m_worker_state->push_task(ReachableObject(field));
 }
 
@@ -277,10 +275,9 @@ void TransitiveClosureMarker::push(const Parent* parent,
     return;
   }
   record_reachability(parent, method);
-  if (m_reachable_objects->marked(method)) {
+  if (!m_reachable_objects->mark(method)) {
     return;
   }
-  m_reachable_objects->mark(method);
   m_worker_state->push_task(ReachableObject(method));
 }
 
@@ -485,7 +482,10 @@ void TransitiveClosureMarker::record_reachability(Parent* parent,
                                                   Object* object) {
   if (m_record_reachability) {
     redex_assert(parent != nullptr && object != nullptr);
-    m_reachable_objects->record_reachability(parent, object);
+    if (!ReachableObjects::is_trivial_retainer(parent, object)) {
+      m_retainer_edges->edges.emplace_back(ReachableObject(object),
+                                           ReachableObject(parent));
+    }
   }
 }
 
@@ -498,7 +498,7 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
     std::unique_ptr<const mog::Graph>* out_method_override_graph) {
   Timer t("Marking");
   auto scope = build_class_scope(stores);
-  auto reachable_objects = std::make_unique<ReachableObjects>();
+  auto reachable_objects = std::make_unique<ReachableObjects>(scope);
   ConditionallyMarked cond_marked;
   auto method_override_graph = mog::build_graph(scope);
 
@@ -516,12 +516,14 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
 
   size_t num_threads = redex_parallel::default_num_threads();
   auto stats_arr = std::make_unique<Stats[]>(num_threads);
+  auto retainer_edges_arr = std::make_unique<RetainerEdges[]>(num_threads);
   auto work_queue = workqueue_foreach<ReachableObject>(
       [&](MarkWorkerState* worker_state, const ReachableObject& obj) {
         TransitiveClosureMarker transitive_closure_marker(
             ignore_sets, *method_override_graph, record_reachability,
             &cond_marked, reachable_objects.get(), worker_state,
-            &stats_arr[worker_state->worker_id()]);
+            &stats_arr[worker_state->worker_id()],
+            &retainer_edges_arr[worker_state->worker_id()]);
         transitive_closure_marker.visit(obj);
         return nullptr;
       },
@@ -532,6 +534,19 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
   }
   work_queue.run_all();
 
+  if (record_reachability) {
+    auto merge_queue = workqueue_foreach<size_t>(
+        [&](size_t worker_id) {
+          reachable_objects->merge_retainer_edges(
+              retainer_edges_arr[worker_id]);
+        },
+        num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+      merge_queue.add_item(i);
+    }
+    merge_queue.run_all();
+  }
+
   if (num_ignore_check_strings != nullptr) {
     for (size_t i = 0; i < num_threads; ++i) {
       *num_ignore_check_strings += stats_arr[i].num_ignore_check_strings;
@@ -545,43 +560,52 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
   return reachable_objects;
 }
 
-void ReachableObjects::record_reachability(const DexMethodRef* member,
+ReachableObjects::ReachableObjects() {
+  m_marked_classes.finalize_index();
+  m_marked_fields.finalize_index();
+  m_marked_methods.finalize_index();
+}
+
+ReachableObjects::ReachableObjects(const Scope& scope) {
+  for (const auto* cls : scope) {
+    m_marked_classes.add_to_index(cls);
+    for (const auto* f : cls->get_ifields()) {
+      m_marked_fields.add_to_index(f);
+    }
+    for (const auto* f : cls->get_sfields()) {
+      m_marked_fields.add_to_index(f);
+    }
+    for (const auto* m : cls->get_dmethods()) {
+      m_marked_methods.add_to_index(m);
+    }
+    for (const auto* m : cls->get_vmethods()) {
+      m_marked_methods.add_to_index(m);
+    }
+  }
+  m_marked_classes.finalize_index();
+  m_marked_fields.finalize_index();
+  m_marked_methods.finalize_index();
+}
+
+bool ReachableObjects::is_trivial_retainer(const DexMethodRef* member,
                                            const DexClass* cls) {
   // Each class member trivially retains its containing class; let's filter out
   // this uninteresting information from our diagnostics.
-  if (member->get_class() == cls->get_type()) {
-    return;
-  }
-  m_retainers_of.update(ReachableObject(cls),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(member); });
+  return member->get_class() == cls->get_type();
 }
 
-void ReachableObjects::record_reachability(const DexFieldRef* member,
+bool ReachableObjects::is_trivial_retainer(const DexFieldRef* member,
                                            const DexClass* cls) {
-  if (member->get_class() == cls->get_type()) {
-    return;
-  }
-  m_retainers_of.update(ReachableObject(cls),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(member); });
+  return member->get_class() == cls->get_type();
 }
 
-template <class Object>
-void ReachableObjects::record_reachability(Object* parent, Object* object) {
-  if (parent == object) {
-    return;
+void ReachableObjects::merge_retainer_edges(
+    const RetainerEdges& retainer_edges) {
+  for (const auto& edge : retainer_edges.edges) {
+    m_retainers_of.update(edge.first,
+                          [&](const ReachableObject&, ReachableObjectSet& set,
+                              bool /* exists */) { set.emplace(edge.second); });
   }
-  m_retainers_of.update(ReachableObject(object),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(parent); });
-}
-
-template <class Parent, class Object>
-void ReachableObjects::record_reachability(Parent* parent, Object* object) {
-  m_retainers_of.update(ReachableObject(object),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(parent); });
 }
 
 template <class Seed>
@@ -7,8 +7,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "ConcurrentContainers.h"
 #include "DexClass.h"
@@ -89,36 +93,120 @@ using ReachableObjectSet =
 using ReachableObjectGraph =
     ConcurrentMap<ReachableObject, ReachableObjectSet, ReachableObjectHash>;
 
+/*
+ * Retainer edges recorded by a single worker while computing the transitive
+ * closure, as (object, retainer) pairs. They only get merged into the
+ * ReachableObjectGraph once marking is done, so that workers don't contend on
+ * it. Each worker has its own instance, so align it to avoid false sharing.
+ */
+struct alignas(CACHE_LINE_SIZE) RetainerEdges {
+  std::vector<std::pair<ReachableObject, ReachableObject>> edges;
+};
+
+/*
+ * The set of marked objects of one kind. Objects of the scope the marking
+ * runs on get dense ids up front, and are marked in a lock-free bitset; any
+ * other object (e.g. a member reference that doesn't resolve to a
+ * definition) is kept in a ConcurrentSet instead.
+ */
+template <class Object>
+class MarkedObjects {
+ public:
+  void add_to_index(const Object* obj) {
+    m_ids.emplace(obj, static_cast<uint32_t>(m_ids.size()));
+  }
+
+  void finalize_index() {
+    m_bits = std::make_unique<std::atomic<uint64_t>[]>((m_ids.size() + 63) /
+                                                       64);
+  }
+
+  // Returns true iff the object was not marked before.
+  bool mark(const Object* obj) {
+    auto it = m_ids.find(obj);
+    if (it == m_ids.end()) {
+      if (!m_others.insert(obj)) {
+        return false;
+      }
+    } else {
+      auto bit = uint64_t(1) << (it->second % 64);
+      if (m_bits[it->second / 64].fetch_or(bit) & bit) {
+        return false;
+      }
+    }
+    m_size.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool marked(const Object* obj) const {
+    auto it = m_ids.find(obj);
+    if (it == m_ids.end()) {
+      return m_others.count(obj);
+    }
+    return (m_bits[it->second / 64].load() >> (it->second % 64)) & 1;
+  }
+
+  // Not thread-safe for objects outside of the index.
+  bool marked_unsafe(const Object* obj) const {
+    auto it = m_ids.find(obj);
+    if (it == m_ids.end()) {
+      return m_others.count_unsafe(obj);
+    }
+    return (m_bits[it->second / 64].load(std::memory_order_relaxed) >>
+            (it->second % 64)) &
+           1;
+  }
+
+  size_t size() const { return m_size.load(); }
+
+ private:
+  std::unordered_map<const Object*, uint32_t> m_ids;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_bits;
+  ConcurrentSet<const Object*> m_others;
+  std::atomic<size_t> m_size{0};
+};
+
 class ReachableObjects {
  public:
+  // All objects are tracked in concurrent sets.
+  ReachableObjects();
+
+  // Classes and members of the scope are tracked in bitsets.
+  explicit ReachableObjects(const Scope& scope);
+
   const ReachableObjectGraph& retainers_of() const { return m_retainers_of; }
 
-  void mark(const DexClass* cls) { m_marked_classes.insert(cls); }
+  // The mark functions return true iff the object was not marked before.
+  bool mark(const DexClass* cls) { return m_marked_classes.mark(cls); }
 
-  void mark(const DexMethodRef* method) { m_marked_methods.insert(method); }
+  bool mark(const DexMethodRef* method) {
+    return m_marked_methods.mark(method);
+  }
 
-  void mark(const DexFieldRef* field) { m_marked_fields.insert(field); }
+  bool mark(const DexFieldRef* field) { return m_marked_fields.mark(field); }
 
-  bool marked(const DexClass* cls) const { return m_marked_classes.count(cls); }
+  bool marked(const DexClass* cls) const {
+    return m_marked_classes.marked(cls);
+  }
 
   bool marked(const DexMethodRef* method) const {
-    return m_marked_methods.count(method);
+    return m_marked_methods.marked(method);
   }
 
   bool marked(const DexFieldRef* field) const {
-    return m_marked_fields.count(field);
+    return m_marked_fields.marked(field);
   }
 
   bool marked_unsafe(const DexClass* cls) const {
-    return m_marked_classes.count_unsafe(cls);
+    return m_marked_classes.marked_unsafe(cls);
   }
 
   bool marked_unsafe(const DexMethodRef* method) const {
-    return m_marked_methods.count_unsafe(method);
+    return m_marked_methods.marked_unsafe(method);
   }
 
   bool marked_unsafe(const DexFieldRef* field) const {
-    return m_marked_fields.count_unsafe(field);
+    return m_marked_fields.marked_unsafe(field);
   }
 
   size_t num_marked_classes() const { return m_marked_classes.size(); }
@@ -127,23 +215,32 @@ class ReachableObjects {
 
   size_t num_marked_methods() const { return m_marked_methods.size(); }
 
+  void merge_retainer_edges(const RetainerEdges& retainer_edges);
+
  private:
   template <class Seed>
   void record_is_seed(Seed* seed);
 
+  // Whether recording the retainer would not add interesting information.
   template <class Parent, class Object>
-  void record_reachability(Parent*, Object*);
+  static bool is_trivial_retainer(Parent*, Object*) {
+    return false;
+  }
 
   template <class Object>
-  void record_reachability(Object* parent, Object* object);
+  static bool is_trivial_retainer(Object* parent, Object* object) {
+    return parent == object;
+  }
 
-  void record_reachability(const DexFieldRef* member, const DexClass* cls);
+  static bool is_trivial_retainer(const DexFieldRef* member,
+                                  const DexClass* cls);
 
-  void record_reachability(const DexMethodRef* member, const DexClass* cls);
+  static bool is_trivial_retainer(const DexMethodRef* member,
+                                  const DexClass* cls);
 
-  ConcurrentSet<const DexClass*> m_marked_classes;
-  ConcurrentSet<const DexFieldRef*> m_marked_fields;
-  ConcurrentSet<const DexMethodRef*> m_marked_methods;
+  MarkedObjects<DexClass> m_marked_classes;
+  MarkedObjects<DexFieldRef> m_marked_fields;
+  MarkedObjects<DexMethodRef> m_marked_methods;
   ReachableObjectGraph m_retainers_of;
 
   friend class RootSetMarker;
@@ -245,14 +342,16 @@ class TransitiveClosureMarker {
       ConditionallyMarked* cond_marked,
       ReachableObjects* reachable_objects,
       MarkWorkerState* worker_state,
-      Stats* stats)
+      Stats* stats,
+      RetainerEdges* retainer_edges)
       : m_ignore_sets(ignore_sets),
         m_method_override_graph(method_override_graph),
         m_record_reachability(record_reachability),
         m_cond_marked(cond_marked),
         m_reachable_objects(reachable_objects),
         m_worker_state(worker_state),
-        m_stats(stats) {
+        m_stats(stats),
+        m_retainer_edges(retainer_edges) {
     if (s_class_forname == nullptr) {
       s_class_forname = DexMethod::get_method(
           "Ljava/lang/Class;.forName:(Ljava/lang/String;)Ljava/lang/Class;");
@@ -318,6 +417,7 @@ class TransitiveClosureMarker {
   ReachableObjects* m_reachable_objects;
   MarkWorkerState* m_worker_state;
   Stats* m_stats;
+  RetainerEdges* m_retainer_edges;
 
   static DexMethodRef* s_class_forname;
 };
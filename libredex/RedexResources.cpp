@@ -13,6 +13,8 @@
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/optional.hpp>
 #include <boost/regex.hpp>
+#include <array>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <fcntl.h>
@@ -50,6 +52,7 @@
 #include "Debug.h"
 #include "Macros.h"
 #include "StringUtil.h"
+#include "Timer.h"
 #include "Trace.h"
 #include "WorkQueue.h"
 
@@ -96,10 +99,12 @@ constexpr size_t MAX_CLASSNAME_LENGTH = 500;
 
 const uint32_t PACKAGE_RESID_START = 0x7f000000;
 
-constexpr decltype(sparta::parallel::default_num_threads()) kReadXMLThreads =
-    4u;
-constexpr decltype(sparta::parallel::default_num_threads()) kReadNativeThreads =
-    2u;
+// Files up to this size are read, larger ones get mapped.
+constexpr size_t kMmapThreshold = 64 * 1024;
+
+// Native libraries can be large, so they get scanned in chunks of about this
+// size, in parallel.
+constexpr size_t kNativeLibChunkSize = 1024 * 1024;
 
 using path_t = boost::filesystem::path;
 using dir_iterator = boost::filesystem::directory_iterator;
@@ -231,12 +236,9 @@ struct MmapFileContents final : public BaseFileContents {
   MmapFileContents& operator=(const MmapFileContents&) = delete;
 };
 
-// XML files are usually small (less than a page). Mmaps don't amortize.
-using XMLFileContents = PageSizeReadFileContents;
-
 // Mmaps may not amortize for small files. Split between `read` and `mmap`.
-template <size_t kThreshold, typename Fn>
-void read_file_with_contents(const std::string& file, Fn fn) {
+template <size_t kThreshold>
+std::unique_ptr<BaseFileContents> read_or_map_file(const std::string& file) {
   int fd = open(file.c_str(), O_RDONLY | O_BINARY);
   if (fd < 0) {
     throw std::runtime_error(std::string("Failed to open ") + file + ": " +
@@ -252,19 +254,22 @@ void read_file_with_contents(const std::string& file, Fn fn) {
   size_t size = static_cast<size_t>(st.st_size);
 
   if (size <= kThreshold) {
-    auto content = PageSizeReadFileContents(file, fd, size);
-    fn(content);
-  } else {
-    close(fd);
-    constexpr int kAdvFlags =
+    return std::make_unique<PageSizeReadFileContents>(file, fd, size);
+  }
+  close(fd);
+  constexpr int kAdvFlags =
 #ifdef __linux__
-        MADV_SEQUENTIAL | MADV_WILLNEED;
+      MADV_SEQUENTIAL | MADV_WILLNEED;
 #else
-        0;
+      0;
 #endif
-    auto content = MmapFileContents<kAdvFlags>(file);
-    fn(content);
-  }
+  return std::make_unique<MmapFileContents<kAdvFlags>>(file);
+}
+
+template <size_t kThreshold, typename Fn>
+void read_file_with_contents(const std::string& file, Fn fn) {
+  auto content = read_or_map_file<kThreshold>(file);
+  fn(*content);
 }
 
 std::string convert_from_string16(const android::String16& string16) {
@@ -704,7 +709,7 @@ std::string read_attribute_name_at_idx(const android::ResXMLTree& parser,
 }
 
 void extract_classes_from_layout(
-    const XMLFileContents& layout_contents,
+    const BaseFileContents& layout_contents,
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
@@ -781,52 +786,92 @@ void extract_classes_from_layout(
            type != android::ResXMLParser::END_DOCUMENT);
 }
 
+// Whether the character may be part of a class name in a native library.
+const std::array<bool, 256>& get_class_name_chars() {
+  static const std::array<bool, 256> table = [] {
+    std::array<bool, 256> t{};
+    for (int c = 'a'; c <= 'z'; c++) {
+      t[c] = true;
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+      t[c] = true;
+    }
+    for (int c = '0'; c <= '9'; c++) {
+      t[c] = true;
+    }
+    t['/'] = t['_'] = t['$'] = true;
+    return t;
+  }();
+  return table;
+}
+
+// Whether the character may start a class name in a native library.
+const std::array<bool, 256>& get_class_name_start_chars() {
+  static const std::array<bool, 256> table = [] {
+    std::array<bool, 256> t{};
+    for (int c = 'a'; c <= 'z'; c++) {
+      t[c] = true;
+    }
+    t['L'] = true;
+    return t;
+  }();
+  return table;
+}
+
 /*
- * Returns all strings that look like java class names from a native library.
+ * Adds all strings that look like java class names in [inptr, end) of a native
+ * library to classes.
  *
  * Return values will be formatted the way that the dex spec formats class
  * names:
  *
  *   "Ljava/lang/String;"
  *
+ * Any character that can't be part of a class name resets the scanner, so
+ * that a library can be scanned in chunks which end right after such a
+ * character, with the same results.
  */
-std::unordered_set<std::string> extract_classes_from_native_lib(
-    const BaseFileContents& lib_contents) {
-  std::unordered_set<std::string> classes;
-  char buffer[MAX_CLASSNAME_LENGTH + 2]; // +2 for the trailing ";\0"
-  const char* inptr = lib_contents.get_content();
-  const char* end = inptr + lib_contents.get_content_size();
-
+void extract_classes_from_native_lib(const char* inptr,
+                                     const char* end,
+                                     std::unordered_set<std::string>& classes) {
+  const auto& is_class_name_char = get_class_name_chars();
+  const auto& is_class_name_start_char = get_class_name_start_chars();
+  std::string buffer;
   while (inptr < end) {
-    char* outptr = buffer;
-    size_t length = 0;
     // All classnames start with a package, which starts with a lowercase
     // letter. Some of them are preceded by an 'L' and followed by a ';' in
     // native libraries while others are not.
-    if ((*inptr >= 'a' && *inptr <= 'z') || *inptr == 'L') {
-
-      if (*inptr != 'L') {
-        *outptr++ = 'L';
-        length++;
-      }
-
-      while (inptr < end &&
-             ((*inptr >= 'a' && *inptr <= 'z') ||
-              (*inptr >= 'A' && *inptr <= 'Z') ||
-              (*inptr >= '0' && *inptr <= '9') || *inptr == '/' ||
-              *inptr == '_' || *inptr == '$') &&
-             length < MAX_CLASSNAME_LENGTH) {
-        *outptr++ = *inptr++;
-        length++;
-      }
-      if (length >= MIN_CLASSNAME_LENGTH) {
-        *outptr++ = ';';
-        *outptr = '\0';
-        classes.insert(std::string(buffer));
-      }
+    if (!is_class_name_start_char[(uint8_t)*inptr]) {
+      inptr++;
+      continue;
+    }
+    const char* start = inptr;
+    size_t length = 0;
+    buffer.clear();
+    if (*inptr != 'L') {
+      buffer.push_back('L');
+      length++;
+    }
+    while (inptr < end && is_class_name_char[(uint8_t)*inptr] &&
+           length < MAX_CLASSNAME_LENGTH) {
+      inptr++;
+      length++;
+    }
+    if (length >= MIN_CLASSNAME_LENGTH) {
+      buffer.append(start, inptr);
+      buffer.push_back(';');
+      classes.insert(buffer);
     }
     inptr++;
   }
+}
+
+std::unordered_set<std::string> extract_classes_from_native_lib(
+    const BaseFileContents& lib_contents) {
+  std::unordered_set<std::string> classes;
+  const char* data = lib_contents.get_content();
+  extract_classes_from_native_lib(
+      data, data + lib_contents.get_content_size(), classes);
   return classes;
 }
 
@@ -845,11 +890,29 @@ std::unordered_set<std::string> extract_classes_from_native_lib(
  * anything went wrong (e.g. file not found).
  */
 std::string read_entire_file(const std::string& filename) {
-  std::ifstream in(filename, std::ios::in | std::ios::binary);
-  std::ostringstream sstr;
-  sstr << in.rdbuf();
-  redex_assert(!in.bad());
-  return sstr.str();
+  std::string contents;
+  int fd = open(filename.c_str(), O_RDONLY | O_BINARY);
+  if (fd < 0) {
+    return contents;
+  }
+  struct stat st = {};
+  if (fstat(fd, &st) == 0) {
+    contents.resize(static_cast<size_t>(st.st_size));
+    size_t read_size = 0;
+    while (read_size < contents.size()) {
+      ssize_t n = TEMP_FAILURE_RETRY(
+          read(fd, &contents[read_size], contents.size() - read_size));
+      redex_assert(n >= 0);
+      if (n == 0) {
+        // The file got shorter.
+        break;
+      }
+      read_size += n;
+    }
+    contents.resize(read_size);
+  }
+  close(fd);
+  return contents;
 }
 
 void write_entire_file(const std::string& filename,
@@ -982,7 +1045,7 @@ std::unordered_set<std::string> get_candidate_js_resources_from_assets_list(
 
 std::unordered_set<uint32_t> get_apk_resources_from_candidates(
     const std::unordered_set<std::string>& candidate_resources,
-    std::map<std::string, std::vector<uint32_t>> name_to_ids) {
+    const std::map<std::string, std::vector<uint32_t>>& name_to_ids) {
   // The actual resources are the intersection of the real resources and the
   // candidate resources (since our current javascript processing produces
   // a few potential resource names that are not actually valid).
@@ -997,9 +1060,9 @@ std::unordered_set<uint32_t> get_apk_resources_from_candidates(
     }
   } else {
     for (auto& name : candidate_resources) {
-      if (name_to_ids.find(name) != name_to_ids.end()) {
-        apk_resources.insert(name_to_ids[name].begin(),
-                             name_to_ids[name].end());
+      auto it = name_to_ids.find(name);
+      if (it != name_to_ids.end()) {
+        apk_resources.insert(it->second.begin(), it->second.end());
       }
     }
   }
@@ -1055,11 +1118,13 @@ std::unordered_set<uint32_t> get_resources_by_name_prefix(
     const std::map<std::string, std::vector<uint32_t>>& name_to_ids) {
   std::unordered_set<uint32_t> found_resources;
 
-  for (const auto& pair : name_to_ids) {
-    for (const auto& prefix : prefixes) {
-      if (boost::algorithm::starts_with(pair.first, prefix)) {
-        found_resources.insert(pair.second.begin(), pair.second.end());
-      }
+  // Names with a given prefix form a contiguous range of the ordered map.
+  for (const auto& prefix : prefixes) {
+    for (auto it = name_to_ids.lower_bound(prefix);
+         it != name_to_ids.end() &&
+         boost::algorithm::starts_with(it->first, prefix);
+         ++it) {
+      found_resources.insert(it->second.begin(), it->second.end());
     }
   }
 
@@ -1281,9 +1346,11 @@ void collect_layout_classes_and_attributes_for_file(
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
-  XMLFileContents file_contents(file_path);
-  extract_classes_from_layout(file_contents, attributes_to_read, out_classes,
-                              out_attributes);
+  read_file_with_contents<kMmapThreshold>(
+      file_path, [&](const BaseFileContents& file_contents) {
+        extract_classes_from_layout(file_contents, attributes_to_read,
+                                    out_classes, out_attributes);
+      });
 }
 
 void collect_layout_classes_and_attributes(
@@ -1291,8 +1358,10 @@ void collect_layout_classes_and_attributes(
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
+  Timer t("Collect layout classes and attributes");
   auto collect_fn = [&](const std::vector<std::string>& prefixes) {
     std::mutex out_mutex;
+    std::atomic<size_t> num_files{0};
     auto wq = workqueue_foreach<std::string>(
         [&](sparta::SpartaWorkerState<std::string>* worker_state,
             const std::string& input) {
@@ -1305,6 +1374,7 @@ void collect_layout_classes_and_attributes(
             return;
           }
 
+          num_files++;
           std::unordered_set<std::string> local_out_classes;
           std::unordered_multimap<std::string, std::string>
               local_out_attributes;
@@ -1320,10 +1390,12 @@ void collect_layout_classes_and_attributes(
                                   local_out_attributes.end());
           }
         },
-        std::min(sparta::parallel::default_num_threads(), kReadXMLThreads),
+        sparta::parallel::default_num_threads(),
         /*push_tasks_while_running=*/true);
     wq.add_item("");
     wq.run_all();
+    TRACE(RES, 1, "Collected layout classes and attributes from %zu files",
+          (size_t)num_files);
   };
 
   collect_fn({
@@ -1411,34 +1483,60 @@ void find_native_library_files(const std::string& apk_directory, Fn handler) {
  */
 std::unordered_set<std::string> get_native_classes(
     const std::string& apk_directory) {
+  Timer t("Collect native classes");
+  std::vector<std::string> files;
+  find_native_library_files(apk_directory, [&](const std::string& file) {
+    files.push_back(file);
+  });
+
+  // Read or map all libraries, and split them into chunks that end right
+  // after a character which can't be part of a class name.
+  std::vector<std::unique_ptr<BaseFileContents>> contents(files.size());
+  auto read_wq = workqueue_foreach<size_t>([&](size_t i) {
+    contents[i] = read_or_map_file<kMmapThreshold>(files[i]);
+  });
+  for (size_t i = 0; i < files.size(); i++) {
+    read_wq.add_item(i);
+  }
+  read_wq.run_all();
+
+  const auto& is_class_name_char = get_class_name_chars();
+  std::vector<std::pair<const char*, const char*>> chunks;
+  size_t total_size = 0;
+  for (const auto& content : contents) {
+    const char* data = content->get_content();
+    const char* end = data + content->get_content_size();
+    total_size += content->get_content_size();
+    while (data < end) {
+      const char* chunk_end = data + std::min<size_t>(end - data,
+                                                      kNativeLibChunkSize);
+      while (chunk_end < end && is_class_name_char[(uint8_t)chunk_end[-1]]) {
+        chunk_end++;
+      }
+      chunks.emplace_back(data, chunk_end);
+      data = chunk_end;
+    }
+  }
+  TRACE(RES, 1, "Scanning %zu native libraries, %zu bytes in %zu chunks",
+        files.size(), total_size, chunks.size());
+
   std::mutex out_mutex;
   std::unordered_set<std::string> all_classes;
-  auto wq = workqueue_foreach<std::string>(
-      [&](sparta::SpartaWorkerState<std::string>* worker_state,
-          const std::string& input) {
-        if (input.empty()) {
-          // Dispatcher, find files and create tasks.
-          find_native_library_files(
-              apk_directory,
-              [&](const std::string& file) { worker_state->push_task(file); });
-          return;
+  auto wq = workqueue_foreach<std::pair<const char*, const char*>>(
+      [&](const std::pair<const char*, const char*>& chunk) {
+        std::unordered_set<std::string> classes_from_native;
+        extract_classes_from_native_lib(chunk.first, chunk.second,
+                                        classes_from_native);
+        if (!classes_from_native.empty()) {
+          std::unique_lock<std::mutex> lock(out_mutex);
+          // C++17: use merge to avoid copies.
+          all_classes.insert(classes_from_native.begin(),
+                             classes_from_native.end());
         }
-
-        read_file_with_contents<64 * 1024>(
-            input, [&](const BaseFileContents& contents) {
-              std::unordered_set<std::string> classes_from_native =
-                  extract_classes_from_native_lib(contents);
-              if (!classes_from_native.empty()) {
-                std::unique_lock<std::mutex> lock(out_mutex);
-                // C++17: use merge to avoid copies.
-                all_classes.insert(classes_from_native.begin(),
-                                   classes_from_native.end());
-              }
-            });
-      },
-      std::min(sparta::parallel::default_num_threads(), kReadNativeThreads),
-      /*push_tasks_while_running=*/true);
-  wq.add_item("");
+      });
+  for (const auto& chunk : chunks) {
+    wq.add_item(chunk);
+  }
   wq.run_all();
   return all_classes;
 }
@@ -1664,6 +1762,7 @@ std::vector<std::string> ResourcesArscFile::get_resource_strings_by_name(
   std::vector<std::string> ret;
   auto it = name_to_ids.find(res_name);
   if (it != name_to_ids.end()) {
+    const auto& global_strings = get_global_strings();
     ret.reserve(it->second.size());
     for (uint32_t id : it->second) {
       android::Res_value res_value;
@@ -1671,17 +1770,33 @@ std::vector<std::string> ResourcesArscFile::get_resource_strings_by_name(
 
       // just in case there's a reference
       res_table.resolveReference(&res_value, 0);
-      size_t len = 0;
 
-      // aapt is using 0, so why not?
-      const char16_t* str =
-          res_table.getTableStringBlock(0)->stringAt(res_value.data, &len);
-      if (str) {
-        ret.push_back(android::String8(str, len).string());
+      if (res_value.data < global_strings.size() &&
+          global_strings[res_value.data]) {
+        ret.push_back(*global_strings[res_value.data]);
       }
     }
   }
   return ret;
 }
 
+const std::vector<boost::optional<std::string>>&
+ResourcesArscFile::get_global_strings() {
+  std::call_once(m_global_strings_once, [this]() {
+    // aapt is using 0, so why not?
+    const android::ResStringPool* pool = res_table.getTableStringBlock(0);
+    m_global_strings.reserve(pool->size());
+    for (size_t i = 0; i < pool->size(); i++) {
+      size_t len = 0;
+      const char16_t* str = pool->stringAt(i, &len);
+      if (str) {
+        m_global_strings.emplace_back(android::String8(str, len).string());
+      } else {
+        m_global_strings.emplace_back(boost::none);
+      }
+    }
+  });
+  return m_global_strings;
+}
+
 ResourcesArscFile::~ResourcesArscFile() {}
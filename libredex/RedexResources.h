@@ -11,6 +11,7 @@
 #include <boost/optional.hpp>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -237,8 +238,17 @@ class ResourcesArscFile {
 
   size_t get_length() const;
 
+  /*
+   * The strings of the global string pool of the table, decoded to UTF-8 on
+   * first use, so that looking up many string values doesn't decode the pool
+   * over and over again. Entries that can't be read are none. Thread-safe.
+   */
+  const std::vector<boost::optional<std::string>>& get_global_strings();
+
  private:
   RedexMappedFile m_f;
   size_t m_arsc_len;
   bool m_file_closed = false;
+  std::once_flag m_global_strings_once;
+  std::vector<boost::optional<std::string>> m_global_strings;
 };
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SubtypingIndex.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "DexUtil.h"
+#include "RedexContext.h"
+
+namespace {
+
+using TypeVector = std::vector<const DexType*>;
+
+/*
+ * Computes, for interfaces, all types an interface can be cast to, following
+ * the same paths as type::check_cast.
+ */
+class InterfaceClosures {
+ public:
+  const TypeVector& get(const DexType* intf) {
+    auto it = m_closures.find(intf);
+    if (it != m_closures.end()) {
+      return it->second;
+    }
+    TypeVector closure{intf};
+    auto cls = type_class(intf);
+    if (cls != nullptr) {
+      add_interfaces(cls, closure);
+      // Interfaces extend java.lang.Object, but let's not assume so.
+      for (auto super = cls->get_super_class(); super != nullptr;) {
+        closure.push_back(super);
+        auto super_cls = type_class(super);
+        if (super_cls == nullptr) {
+          break;
+        }
+        add_interfaces(super_cls, closure);
+        super = super_cls->get_super_class();
+      }
+      sort_unique(closure);
+    }
+    return m_closures.emplace(intf, std::move(closure)).first->second;
+  }
+
+  // Adds the closures of all interfaces directly implemented by cls.
+  void add_interfaces(const DexClass* cls, TypeVector& types) {
+    for (auto intf : cls->get_interfaces()->get_type_list()) {
+      const auto& closure = get(intf);
+      types.insert(types.end(), closure.begin(), closure.end());
+    }
+  }
+
+  static void sort_unique(TypeVector& types) {
+    std::sort(types.begin(), types.end());
+    types.erase(std::unique(types.begin(), types.end()), types.end());
+  }
+
+ private:
+  // References to mapped values remain valid while the map grows.
+  std::unordered_map<const DexType*, TypeVector> m_closures;
+};
+
+} // namespace
+
+SubtypingIndex::SubtypingIndex(const Scope& scope)
+    : SubtypingIndex(scope, build_type_hierarchy(scope)) {}
+
+SubtypingIndex::SubtypingIndex(const Scope& scope,
+                               const ClassHierarchy& hierarchy) {
+  InterfaceClosures closures;
+
+  // Number the class trees in DFS order. Only roots without a superclass
+  // are considered, so that the chain of every indexed class is complete.
+  uint32_t next_number = NO_INTERVAL + 1;
+  TypeVector supertypes;
+  std::function<void(const DexType*, const Node*)> visit =
+      [&](const DexType* type, const Node* parent) {
+        auto& node = m_nodes[type];
+        node.pre = next_number++;
+        if (parent != nullptr) {
+          node.supertypes_begin = parent->supertypes_begin;
+          node.supertypes_end = parent->supertypes_end;
+        }
+        auto cls = type_class(type);
+        if (cls != nullptr && !cls->get_interfaces()->get_type_list().empty()) {
+          supertypes.assign(m_supertypes.begin() + node.supertypes_begin,
+                            m_supertypes.begin() + node.supertypes_end);
+          closures.add_interfaces(cls, supertypes);
+          InterfaceClosures::sort_unique(supertypes);
+          node.supertypes_begin = m_supertypes.size();
+          m_supertypes.insert(m_supertypes.end(), supertypes.begin(),
+                              supertypes.end());
+          node.supertypes_end = m_supertypes.size();
+        }
+        auto children = hierarchy.find(type);
+        if (children != hierarchy.end()) {
+          for (auto child : children->second) {
+            visit(child, &node);
+          }
+        }
+        node.post = next_number;
+      };
+  for (const auto& pair : hierarchy) {
+    auto cls = type_class(pair.first);
+    if (cls == nullptr || cls->get_super_class() == nullptr) {
+      visit(pair.first, nullptr);
+    }
+  }
+
+  auto add_interface = [&](const DexClass* cls) {
+    if (!is_interface(cls)) {
+      return;
+    }
+    const auto& closure = closures.get(cls->get_type());
+    auto& node = m_nodes[cls->get_type()];
+    node.supertypes_begin = m_supertypes.size();
+    m_supertypes.insert(m_supertypes.end(), closure.begin(), closure.end());
+    node.supertypes_end = m_supertypes.size();
+  };
+  for (auto cls : scope) {
+    add_interface(cls);
+  }
+  g_redex->walk_type_class([&](const DexType*, const DexClass* cls) {
+    if (cls->is_external()) {
+      add_interface(cls);
+    }
+  });
+  m_supertypes.shrink_to_fit();
+}
+
+bool SubtypingIndex::has_supertype(const Node& node,
+                                   const DexType* type) const {
+  return std::binary_search(m_supertypes.begin() + node.supertypes_begin,
+                            m_supertypes.begin() + node.supertypes_end,
+                            type);
+}
+
+boost::optional<bool> SubtypingIndex::check_cast(
+    const DexType* type, const DexType* base_type) const {
+  if (type == base_type) {
+    return true;
+  }
+  if (base_type == nullptr) {
+    return boost::none;
+  }
+  auto it = m_nodes.find(type);
+  if (it == m_nodes.end()) {
+    return boost::none;
+  }
+  const auto& node = it->second;
+  auto base_it = m_nodes.find(base_type);
+  if (base_it != m_nodes.end() && is_ancestor(base_it->second, node)) {
+    return true;
+  }
+  return has_supertype(node, base_type);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "ClassHierarchy.h"
+#include "DexClass.h"
+
+/**
+ * SubtypingIndex
+ * An immutable index of the subtyping relationships between the classes and
+ * interfaces of a Scope and all external classes, which answers
+ * type::check_cast-style queries without walking the hierarchy.
+ *
+ * - The class trees are numbered in DFS order, so that every class covers the
+ *   interval of the numbers of its subclasses, and an is-subclass check is an
+ *   interval containment check.
+ * - Every type also refers to a sorted range of all other types it can be
+ *   cast to: implemented interfaces (transitively), and the supertypes of
+ *   those. Classes which don't implement any additional interfaces share the
+ *   range of their superclass.
+ *
+ * Types that are not covered (array types, primitives, and classes whose
+ * superclass chain leaves the indexed classes) yield boost::none, so that
+ * callers can fall back to the slow path.
+ *
+ * The index reflects the hierarchy at construction time; it must be rebuilt
+ * after any change to superclasses or interfaces. Queries are thread-safe.
+ */
+class SubtypingIndex {
+ public:
+  explicit SubtypingIndex(const Scope& scope);
+
+  // For callers which already have the class hierarchy of the scope.
+  SubtypingIndex(const Scope& scope, const ClassHierarchy& hierarchy);
+
+  /**
+   * Equivalent to type::check_cast(type, base_type) if the type is indexed.
+   */
+  boost::optional<bool> check_cast(const DexType* type,
+                                   const DexType* base_type) const;
+
+  /**
+   * Return true if child is a subclass of or equal to parent. Both types must
+   * be classes (not interfaces); returns false if either isn't indexed.
+   */
+  bool is_subclass(const DexType* parent, const DexType* child) const {
+    auto parent_it = m_nodes.find(parent);
+    auto child_it = m_nodes.find(child);
+    if (parent_it == m_nodes.end() || child_it == m_nodes.end()) {
+      return false;
+    }
+    return is_ancestor(parent_it->second, child_it->second);
+  }
+
+  size_t size() const { return m_nodes.size(); }
+
+ private:
+  static constexpr uint32_t NO_INTERVAL = 0;
+
+  struct Node {
+    // [pre, post) is the range of DFS numbers of the class and all its
+    // subclasses; both are NO_INTERVAL for interfaces.
+    uint32_t pre{NO_INTERVAL};
+    uint32_t post{NO_INTERVAL};
+    // Range of m_supertypes.
+    uint32_t supertypes_begin{0};
+    uint32_t supertypes_end{0};
+  };
+
+  static bool is_ancestor(const Node& parent, const Node& child) {
+    return parent.pre != NO_INTERVAL && parent.pre <= child.pre &&
+           child.pre < parent.post;
+  }
+
+  bool has_supertype(const Node& node, const DexType* type) const;
+
+  std::unordered_map<const DexType*, Node> m_nodes;
+  std::vector<const DexType*> m_supertypes;
+};
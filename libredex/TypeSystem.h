@@ -9,6 +9,7 @@
 
 #include "ClassHierarchy.h"
 #include "DexClass.h"
+#include "SubtypingIndex.h"
 #include "VirtualScope.h"
 
 #include <unordered_map>
@@ -35,6 +36,7 @@ class TypeSystem {
   static const TypeVector empty_vec;
 
   ClassScopes m_class_scopes;
+  SubtypingIndex m_subtyping_index;
   ClassHierarchy m_intf_children;
   InstanceOfTable m_instanceof_table;
   TypeToTypeSet m_interfaces;
@@ -106,16 +108,14 @@ class TypeSystem {
    * The type must be a class (not an interface).
    */
   bool is_subtype(const DexType* parent, const DexType* child) const {
-    const auto& parent_it = m_instanceof_table.find(parent);
-    const auto& child_it = m_instanceof_table.find(child);
-    if (parent_it == m_instanceof_table.end() ||
-        child_it == m_instanceof_table.end()) {
-      return false;
-    }
-    const auto& p_chain = parent_it->second;
-    const auto& c_chain = child_it->second;
-    if (p_chain.size() > c_chain.size()) return false;
-    return c_chain.at(p_chain.size() - 1) == parent;
+    return m_subtyping_index.is_subclass(parent, child);
+  }
+
+  /**
+   * The index backing is_subtype, which also answers check-cast queries.
+   */
+  const SubtypingIndex& get_subtyping_index() const {
+    return m_subtyping_index;
   }
 
   /**
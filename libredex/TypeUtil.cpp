@@ -9,6 +9,7 @@
 
 #include "DexUtil.h"
 #include "RedexContext.h"
+#include "SubtypingIndex.h"
 
 namespace type {
 
@@ -442,8 +443,10 @@ bool is_uninstantiable_class(DexType* type) {
   return !cls->has_ctors();
 }
 
-boost::optional<int32_t> evaluate_type_check(const DexType* src_type,
-                                             const DexType* test_type) {
+boost::optional<int32_t> evaluate_type_check(
+    const DexType* src_type,
+    const DexType* test_type,
+    const SubtypingIndex* subtyping_index) {
   if (test_type == src_type) {
     // Trivial.
     return 1;
@@ -465,12 +468,23 @@ boost::optional<int32_t> evaluate_type_check(const DexType* src_type,
     return boost::none;
   }
 
+  auto check_cast = [subtyping_index](const DexType* type,
+                                      const DexType* base_type) {
+    if (subtyping_index != nullptr) {
+      auto res = subtyping_index->check_cast(type, base_type);
+      if (res) {
+        return *res;
+      }
+    }
+    return type::check_cast(type, base_type);
+  };
+
   // Class vs class, for simplicity.
   if (!is_interface(test_cls) && !is_interface(src_cls)) {
-    if (type::check_cast(src_cls->get_type(), test_cls->get_type())) {
+    if (check_cast(src_cls->get_type(), test_cls->get_type())) {
       // If check-cast succeeds, the result will be `true`.
       return 1;
-    } else if (!type::check_cast(test_cls->get_type(), src_cls->get_type())) {
+    } else if (!check_cast(test_cls->get_type(), src_cls->get_type())) {
       // The check can never succeed, as the test class is not a subtype.
       return 0;
     }
@@ -10,6 +10,8 @@
 #include "DexClass.h"
 #include "WellKnownTypes.h"
 
+class SubtypingIndex;
+
 /**
  * Basic datatypes used by bytecode.
  */
@@ -211,8 +213,13 @@ bool is_uninstantiable_class(DexType* type);
  * equivalent to the semantic of the INSTANCE_OF check. If the check passes, the
  * function returns 1; if it fails, the function returns 0. If it cannot be
  * determined, the function returns none.
+ *
+ * If given, the subtyping index answers the check-cast queries involved; it
+ * must reflect the current class hierarchy.
  */
-boost::optional<int32_t> evaluate_type_check(const DexType* src_type,
-                                             const DexType* test_type);
+boost::optional<int32_t> evaluate_type_check(
+    const DexType* src_type,
+    const DexType* test_type,
+    const SubtypingIndex* subtyping_index = nullptr);
 
 }; // namespace type
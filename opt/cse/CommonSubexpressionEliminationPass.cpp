@@ -27,6 +27,8 @@ constexpr const char* METRIC_ELIMINATED_INSTRUCTIONS =
 constexpr const char* METRIC_MAX_VALUE_IDS = "max_value_ids";
 constexpr const char* METRIC_METHODS_USING_OTHER_TRACKED_LOCATION_BIT =
     "methods_using_other_tracked_location_bit";
+constexpr const char* METRIC_METHODS_EXCEEDING_VALUE_IDS_BUDGET =
+    "methods_exceeding_value_ids_budget";
 constexpr const char* METRIC_INSTR_PREFIX = "instr_";
 constexpr const char* METRIC_METHOD_BARRIERS = "num_method_barriers";
 constexpr const char* METRIC_METHOD_BARRIERS_ITERATIONS =
@@ -42,6 +44,7 @@ constexpr const char* METRIC_MAX_ITERATIONS = "num_max_iterations";
 void CommonSubexpressionEliminationPass::bind_config() {
   bind("debug", false, m_debug);
   bind("runtime_assertions", false, m_runtime_assertions);
+  bind("max_value_ids_per_method", MAX_VALUE_IDS, m_max_value_ids_per_method);
 }
 
 void CommonSubexpressionEliminationPass::run_pass(DexStoresVector& stores,
@@ -90,7 +93,8 @@ void CommonSubexpressionEliminationPass::run_pass(DexStoresVector& stores,
           CommonSubexpressionElimination cse(
               &shared_state, code->cfg(), is_static(method),
               method::is_init(method) || method::is_clinit(method),
-              method->get_class(), method->get_proto()->get_args());
+              method->get_class(), method->get_proto()->get_args(),
+              m_max_value_ids_per_method);
           bool any_changes = cse.patch(m_runtime_assertions);
           stats += cse.get_stats();
 
@@ -122,6 +126,8 @@ void CommonSubexpressionEliminationPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric(METRIC_MAX_VALUE_IDS, stats.max_value_ids);
   mgr.incr_metric(METRIC_METHODS_USING_OTHER_TRACKED_LOCATION_BIT,
                   stats.methods_using_other_tracked_location_bit);
+  mgr.incr_metric(METRIC_METHODS_EXCEEDING_VALUE_IDS_BUDGET,
+                  stats.methods_exceeding_value_ids_budget);
   auto& shared_state_stats = shared_state.get_stats();
   mgr.incr_metric(METRIC_METHOD_BARRIERS, shared_state_stats.method_barriers);
   mgr.incr_metric(METRIC_METHOD_BARRIERS_ITERATIONS,
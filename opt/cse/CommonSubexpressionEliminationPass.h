@@ -21,4 +21,5 @@ class CommonSubexpressionEliminationPass : public Pass {
  private:
   bool m_debug;
   bool m_runtime_assertions;
+  size_t m_max_value_ids_per_method;
 };
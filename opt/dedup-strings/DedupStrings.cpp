@@ -17,12 +17,17 @@
 #include "IRInstruction.h"
 #include "InstructionSequenceOutliner.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 #include "locator.h"
 
 namespace {
 
 constexpr const char* DEDUP_STRINGS_CLASS_NAME_PREFIX = "Lcom/redex/Strings$";
 
+// Code size needed to host a string in a factory method.
+constexpr size_t HOSTING_CODE_SIZE_INCREASE =
+    4 /* switch-target-offset */ + 4 /* const-string */ + 2 /* return */;
+
 constexpr const char* METRIC_PERF_SENSITIVE_STRINGS =
     "num_perf_sensitive_strings";
 constexpr const char* METRIC_NON_PERF_SENSITIVE_STRINGS =
@@ -63,10 +68,14 @@ void DedupStrings::run(DexStoresVector& stores) {
 
   // Compute set of non-load strings in each dex
   std::unordered_set<const DexString*> non_load_strings[dexen.size()];
-  for (size_t i = 0; i < dexen.size(); i++) {
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
     auto& strings = non_load_strings[i];
     gather_non_load_strings(dexen[i], &strings);
+  });
+  for (size_t i = 0; i < dexen.size(); i++) {
+    wq.add_item(i);
   }
+  wq.run_all();
 
   // For each string, figure out how many times it's loaded per dex
   ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> occurrences =
@@ -253,22 +262,30 @@ DedupStrings::get_occurrences(
               &perf_sensitive_methods](DexMethod* method, IRCode& code) {
         const auto dexnr = methods_to_dex.at(method);
         const auto perf_sensitive = perf_sensitive_methods.count(method) != 0;
+        // Count locally first, so that we only touch the shared maps once
+        // per distinct string of the method.
+        std::unordered_map<DexString*, size_t> loads;
         for (auto& mie : InstructionIterable(code)) {
           const auto insn = mie.insn;
           if (insn->opcode() == OPCODE_CONST_STRING) {
-            const auto str = insn->get_string();
-            if (perf_sensitive) {
-              perf_sensitive_strings.update(
-                  str,
-                  [dexnr](const DexString*,
-                          std::unordered_set<size_t>& s,
-                          bool /* exists */) { s.emplace(dexnr); });
-            } else {
-              occurrences.update(str,
-                                 [dexnr](const DexString*,
-                                         std::unordered_map<size_t, size_t>& m,
-                                         bool /* exists */) { ++m[dexnr]; });
-            }
+            ++loads[insn->get_string()];
+          }
+        }
+        for (const auto& p : loads) {
+          const auto str = p.first;
+          const auto count = p.second;
+          if (perf_sensitive) {
+            perf_sensitive_strings.update(
+                str,
+                [dexnr](const DexString*,
+                        std::unordered_set<size_t>& s,
+                        bool /* exists */) { s.emplace(dexnr); });
+          } else {
+            occurrences.update(
+                str,
+                [dexnr, count](const DexString*,
+                               std::unordered_map<size_t, size_t>& m,
+                               bool /* exists */) { m[dexnr] += count; });
           }
         }
       });
@@ -291,6 +308,119 @@ DedupStrings::get_occurrences(
   return occurrences;
 }
 
+DedupStrings::DedupStringDecision DedupStrings::analyze_string(
+    DexString* s,
+    const std::unordered_map<size_t, size_t>& m,
+    size_t num_dexes,
+    const std::unordered_set<const DexString*> non_load_strings[],
+    const std::unordered_set<size_t>* hosting_dexnrs) const {
+  // We are going to look at the situation of a particular string here
+  always_assert(m.size() > 1);
+  DedupStringDecision decision;
+  const auto entry_size = s->get_entry_size();
+  const auto get_size_reduction = [entry_size, non_load_strings](
+                                      DexString* str, size_t dexnr,
+                                      size_t loads) -> size_t {
+    const auto has_non_load_string = non_load_strings[dexnr].count(str) != 0;
+    if (has_non_load_string) {
+      // If there's a non-load string, there's nothing to gain
+      return 0;
+    }
+
+    size_t code_size_increase = loads * (6 /* invoke */ + 2 /* move-result */);
+    if (4 + entry_size < code_size_increase) {
+      // If the string itself is taking up less space than the code size
+      // increase we would incur when referencing the string via a
+      // referenced load method, then there's nothing to gain
+      return 0;
+    }
+
+    return 4 + entry_size - code_size_increase;
+  };
+
+  // First, we identify which dex could and should host the string in
+  // its string factory method
+  struct HostInfo {
+    size_t dexnr;
+    size_t size_reduction;
+  };
+  boost::optional<HostInfo> host_info;
+  for (size_t dexnr = 0; dexnr < num_dexes; ++dexnr) {
+    // There's a configurable limit of how many factory methods / hosts we
+    // can have in total
+    if (hosting_dexnrs != nullptr && hosting_dexnrs->count(dexnr) == 0 &&
+        hosting_dexnrs->size() == m_max_factory_methods) {
+      // We could try a bit harder to determine the optimal set of hosts,
+      // but the best fix in this case is probably to raise the limit
+      TRACE(DS, 4,
+            "[dedup strings] non perf sensitive string: {%s} dex #%u cannot "
+            "be used as dedup strings max factory methods limit reached",
+            SHOW(s), dexnr);
+      ++decision.excluded_out_of_factory_methods_strings;
+      continue;
+    }
+
+    // So this dex could host the current string s
+    const auto mit = m.find(dexnr);
+    const auto loads = mit == m.end() ? 0 : mit->second;
+    // Figure out what the size reduction would be if this dex would *not*
+    // be hosting string s, also considering whether we'd keep around a copy
+    // of the string in this dex anyway
+    const auto size_reduction = get_size_reduction(s, dexnr, loads);
+    if (!host_info || size_reduction < host_info->size_reduction) {
+      TRACE(DS, 4,
+            "[dedup strings] non perf sensitive string: {%s} dex #%u can "
+            "host with size reduction %u",
+            SHOW(s), dexnr, size_reduction);
+      host_info = (HostInfo){dexnr, size_reduction};
+    } else {
+      TRACE(DS, 4,
+            "[dedup strings] non perf sensitive string: {%s} dex #%u won't "
+            "host due insufficient size reduction %u",
+            SHOW(s), dexnr, size_reduction);
+    }
+  }
+
+  // We have a zero max_cost if and only if we didn't find any suitable
+  // hosting_dexnr
+  if (!host_info) {
+    return decision;
+  }
+  decision.has_host = true;
+  decision.hosting_dexnr = host_info->dexnr;
+
+  // Second, we figure out which other dexes should get their const-string
+  // instructions rewritten
+  for (const auto& q : m) {
+    const auto dexnr = q.first;
+    const auto loads = q.second;
+    if (dexnr == decision.hosting_dexnr) {
+      continue;
+    }
+
+    const auto size_reduction = get_size_reduction(s, dexnr, loads);
+
+    if (non_load_strings[dexnr].count(s) != 0) {
+      always_assert(size_reduction == 0);
+      TRACE(DS, 4,
+            "[dedup strings] non perf sensitive string: {%s}*%u is a "
+            "non-load string in non-hosting dex #%u",
+            SHOW(s), loads, dexnr);
+      ++decision.excluded_duplicate_non_load_strings;
+      // No point in rewriting const-string instructions for this string
+      // in this dex as string will be referenced from this dex anyway
+      continue;
+    }
+
+    if (size_reduction > 0) {
+      decision.duplicate_string_loads += loads;
+      decision.total_size_reduction += size_reduction;
+      decision.dexes_to_dedup.emplace(dexnr);
+    }
+  }
+  return decision;
+}
+
 std::unordered_map<DexString*, DedupStrings::DedupStringInfo>
 DedupStrings::get_strings_to_dedup(
     DexClassesVector& dexen,
@@ -319,132 +449,65 @@ DedupStrings::get_strings_to_dedup(
     ordered_strings.push_back(p.first);
   }
   std::sort(ordered_strings.begin(), ordered_strings.end(), compare_dexstrings);
-  for (DexString* s : ordered_strings) {
-    // We are going to look at the situation of a particular string here
-    const auto& m = occurrences.at_unsafe(s);
-    always_assert(m.size() > 1);
-    const auto entry_size = s->get_entry_size();
-    const auto get_size_reduction = [entry_size, non_load_strings](
-                                        DexString* str, size_t dexnr,
-                                        size_t loads) -> size_t {
-      const auto has_non_load_string = non_load_strings[dexnr].count(str) != 0;
-      if (has_non_load_string) {
-        // If there's a non-load string, there's nothing to gain
-        return 0;
-      }
-
-      size_t code_size_increase =
-          loads * (6 /* invoke */ + 2 /* move-result */);
-      if (4 + entry_size < code_size_increase) {
-        // If the string itself is taking up less space than the code size
-        // increase we would incur when referencing the string via a
-        // referenced load method, then there's nothing to gain
-        return 0;
-      }
 
-      return 4 + entry_size - code_size_increase;
-    };
-
-    // First, we identify which dex could and should host the string in
-    // its string factory method
-    struct HostInfo {
-      size_t dexnr;
-      size_t size_reduction;
-    };
-    boost::optional<HostInfo> host_info;
-    for (size_t dexnr = 0; dexnr < dexen.size(); ++dexnr) {
-      // There's a configurable limit of how many factory methods / hosts we
-      // can have in total
-      if (hosting_dexnrs.count(dexnr) == 0 &&
-          hosting_dexnrs.size() == m_max_factory_methods) {
-        // We could try a bit harder to determine the optimal set of hosts,
-        // but the best fix in this case is probably to raise the limit
-        TRACE(DS, 4,
-              "[dedup strings] non perf sensitive string: {%s} dex #%u cannot "
-              "be used as dedup strings max factory methods limit reached",
-              SHOW(s), dexnr);
-        ++m_stats.excluded_out_of_factory_methods_strings;
-        continue;
+  // The analysis of each string only depends on which dexes already host
+  // strings once the limit of factory methods has been reached. So we first
+  // analyze all strings in parallel as if there was no limit, and then walk
+  // over them in order, only redoing the analysis of the strings that come
+  // after the limit was reached.
+  std::vector<DedupStringDecision> decisions(ordered_strings.size());
+  {
+    constexpr size_t kChunkSize = 256;
+    auto wq = workqueue_foreach<size_t>([&](size_t begin) {
+      auto end = std::min(begin + kChunkSize, ordered_strings.size());
+      for (size_t i = begin; i < end; i++) {
+        auto str = ordered_strings[i];
+        decisions[i] =
+            analyze_string(str, occurrences.at_unsafe(str), dexen.size(),
+                           non_load_strings, /* hosting_dexnrs */ nullptr);
       }
+    });
+    for (size_t i = 0; i < ordered_strings.size(); i += kChunkSize) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+  }
 
-      // So this dex could host the current string s
-      const auto mit = m.find(dexnr);
-      const auto loads = mit == m.end() ? 0 : mit->second;
-      // Figure out what the size reduction would be if this dex would *not*
-      // be hosting string s, also considering whether we'd keep around a copy
-      // of the string in this dex anyway
-      const auto size_reduction = get_size_reduction(s, dexnr, loads);
-      if (!host_info || size_reduction < host_info->size_reduction) {
-        TRACE(DS, 4,
-              "[dedup strings] non perf sensitive string: {%s} dex #%u can "
-              "host with size reduction %u",
-              SHOW(s), dexnr, size_reduction);
-        host_info = (HostInfo){dexnr, size_reduction};
-      } else {
-        TRACE(DS, 4,
-              "[dedup strings] non perf sensitive string: {%s} dex #%u won't "
-              "host due insufficient size reduction %u",
-              SHOW(s), dexnr, size_reduction);
-      }
+  for (size_t i = 0; i < ordered_strings.size(); i++) {
+    DexString* s = ordered_strings[i];
+    if (hosting_dexnrs.size() == m_max_factory_methods) {
+      decisions[i] = analyze_string(s, occurrences.at_unsafe(s), dexen.size(),
+                                    non_load_strings, &hosting_dexnrs);
     }
+    const auto& decision = decisions[i];
+    m_stats.excluded_out_of_factory_methods_strings +=
+        decision.excluded_out_of_factory_methods_strings;
+    m_stats.excluded_duplicate_non_load_strings +=
+        decision.excluded_duplicate_non_load_strings;
 
-    // We have a zero max_cost if and only if we didn't find any suitable
-    // hosting_dexnr
-    if (!host_info) {
+    if (!decision.has_host) {
       TRACE(DS, 3, "[dedup strings] non perf sensitive string: {%s} - no host",
             SHOW(s));
       continue;
     }
-    size_t hosting_dexnr = host_info->dexnr;
-
-    // Second, we figure out which other dexes should get their const-string
-    // instructions rewritten
-    size_t total_size_reduction = 0;
-    size_t duplicate_string_loads = 0;
-    std::unordered_set<size_t> dexes_to_dedup;
-    for (const auto& q : m) {
-      const auto dexnr = q.first;
-      const auto loads = q.second;
-      if (dexnr == hosting_dexnr) {
-        continue;
-      }
-
-      const auto size_reduction = get_size_reduction(s, dexnr, loads);
-
-      if (non_load_strings[dexnr].count(s) != 0) {
-        always_assert(size_reduction == 0);
-        TRACE(DS, 4,
-              "[dedup strings] non perf sensitive string: {%s}*%u is a "
-              "non-load string in non-hosting dex #%u",
-              SHOW(s), loads, dexnr);
-        ++m_stats.excluded_duplicate_non_load_strings;
-        // No point in rewriting const-string instructions for this string
-        // in this dex as string will be referenced from this dex anyway
-        continue;
-      }
-
-      if (size_reduction > 0) {
-        duplicate_string_loads += loads;
-        total_size_reduction += size_reduction;
-        dexes_to_dedup.emplace(dexnr);
-      }
-    }
-
-    const auto hosting_code_size_increase =
-        (4 /* switch-target-offset */ + 4 /* const-string */ + 2 /* return */);
 
     // Third, we see if there's any overall gain from doing anything about
     // this particular string
-    if (total_size_reduction < hosting_code_size_increase) {
+    const auto total_size_reduction = decision.total_size_reduction;
+    if (total_size_reduction < HOSTING_CODE_SIZE_INCREASE) {
       TRACE(DS, 3,
             "[dedup strings] non perf sensitive string: {%s} ignored as %u < "
             "%u",
-            SHOW(s), total_size_reduction, hosting_code_size_increase);
+            SHOW(s), total_size_reduction, HOSTING_CODE_SIZE_INCREASE);
       continue;
     }
 
     // Yes! We found a string that's worthwhile to dedup.
 
+    const auto hosting_dexnr = decision.hosting_dexnr;
+    const auto duplicate_string_loads = decision.duplicate_string_loads;
+    const auto& dexes_to_dedup = decision.dexes_to_dedup;
+    const auto entry_size = s->get_entry_size();
     if (hosting_dexnrs.count(hosting_dexnr) == 0) {
       hosting_dexnrs.emplace(hosting_dexnr);
 
@@ -460,7 +523,7 @@ DedupStrings::get_strings_to_dedup(
     m_stats.duplicate_strings_size += (4 + entry_size) * dexes_to_dedup.size();
     m_stats.duplicate_string_loads += duplicate_string_loads;
     m_stats.expected_size_reduction +=
-        total_size_reduction - hosting_code_size_increase;
+        total_size_reduction - HOSTING_CODE_SIZE_INCREASE;
     DedupStringInfo dedup_string_info;
     dedup_string_info.duplicate_string_loads = duplicate_string_loads;
     dedup_string_info.dexes_to_dedup = dexes_to_dedup;
@@ -474,7 +537,7 @@ DedupStrings::get_strings_to_dedup(
         "expected size reduction",
         SHOW(s), dexes_to_dedup.size(),
         (4 + entry_size) * dexes_to_dedup.size(), duplicate_string_loads,
-        total_size_reduction - hosting_code_size_increase);
+        total_size_reduction - HOSTING_CODE_SIZE_INCREASE);
   }
 
   // Order strings to give more often used strings smaller indices;
@@ -538,7 +601,7 @@ void DedupStrings::rewrite_const_string_instructions(
         // First, we collect all const-string instructions that we want to
         // rewrite
         const auto ii = InstructionIterable(code);
-        std::vector<std::pair<IRInstruction*, reg_t>> const_strings;
+        std::vector<std::pair<IRList::iterator, reg_t>> const_strings;
         for (auto it = ii.begin(); it != ii.end(); it++) {
           // do we have a sequence of const-string + move-pseudo-result
           // instruction?
@@ -548,7 +611,7 @@ void DedupStrings::rewrite_const_string_instructions(
           }
           auto move_result_pseudo = ir_list::move_result_pseudo_of(it.unwrap());
 
-          const_strings.push_back({insn, move_result_pseudo->dest()});
+          const_strings.push_back({it.unwrap(), move_result_pseudo->dest()});
         }
 
         // Second, we actually rewrite them.
@@ -567,10 +630,11 @@ void DedupStrings::rewrite_const_string_instructions(
 
         boost::optional<uint32_t> temp_reg;
         for (const auto& p : const_strings) {
-          const auto const_string = p.first;
+          const auto const_string_it = p.first;
           const auto reg = p.second;
 
-          const auto it = strings_to_dedup.find(const_string->get_string());
+          const auto it =
+              strings_to_dedup.find(const_string_it->insn->get_string());
           if (it == strings_to_dedup.end()) {
             continue;
           }
@@ -582,26 +646,24 @@ void DedupStrings::rewrite_const_string_instructions(
           if (!temp_reg) {
             temp_reg = boost::optional<uint32_t>(code.allocate_temp());
           }
-          std::vector<IRInstruction*> replacements;
-
           IRInstruction* const_inst = new IRInstruction(OPCODE_CONST);
           const_inst->set_dest(*temp_reg)->set_literal(info.index);
-          replacements.push_back(const_inst);
+          code.insert_before(const_string_it, const_inst);
 
           IRInstruction* invoke_inst = new IRInstruction(OPCODE_INVOKE_STATIC);
           always_assert(info.const_string_method != nullptr);
           invoke_inst->set_method(info.const_string_method)
               ->set_srcs_size(1)
               ->set_src(0, *temp_reg);
-          replacements.push_back(invoke_inst);
+          code.insert_before(const_string_it, invoke_inst);
 
           IRInstruction* move_result_inst =
               new IRInstruction(OPCODE_MOVE_RESULT_OBJECT);
           move_result_inst->set_dest(reg);
-          replacements.push_back(move_result_inst);
+          code.insert_before(const_string_it, move_result_inst);
 
-          // TODO: replace_opcode takes linear time!
-          code.replace_opcode(const_string, replacements);
+          // Also removes the move-result-pseudo.
+          code.remove_opcode(const_string_it);
         }
       });
 }
@@ -49,6 +49,17 @@ class DedupStrings {
     DexMethod* const_string_method{nullptr};
   };
 
+  // The outcome of the cost/benefit analysis of a single string.
+  struct DedupStringDecision {
+    bool has_host{false};
+    size_t hosting_dexnr{0};
+    size_t total_size_reduction{0};
+    size_t duplicate_string_loads{0};
+    std::unordered_set<size_t> dexes_to_dedup;
+    size_t excluded_duplicate_non_load_strings{0};
+    size_t excluded_out_of_factory_methods_strings{0};
+  };
+
   std::unordered_map<const DexMethod*, size_t> get_methods_to_dex(
       const DexClassesVector& dexen);
   std::unordered_set<const DexMethod*> get_perf_sensitive_methods(
@@ -62,6 +73,14 @@ class DedupStrings {
       const std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
       const std::unordered_set<const DexMethod*>& perf_sensitive_methods,
       std::unordered_set<const DexString*> non_load_strings[]);
+  // Only the dexes in hosting_dexnrs may host the string once the limit of
+  // factory methods has been reached; a nullptr ignores the limit.
+  DedupStringDecision analyze_string(
+      DexString* s,
+      const std::unordered_map<size_t, size_t>& m,
+      size_t num_dexes,
+      const std::unordered_set<const DexString*> non_load_strings[],
+      const std::unordered_set<size_t>* hosting_dexnrs) const;
   std::unordered_map<DexString*, DedupStringInfo> get_strings_to_dedup(
       DexClassesVector& dexen,
       const ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>>&
@@ -27,6 +27,7 @@
 #include "PassManager.h"
 #include "ReachingDefinitions.h"
 #include "ScopedCFG.h"
+#include "SubtypingIndex.h"
 #include "Trace.h"
 #include "TypeInference.h"
 #include "TypeUtil.h"
@@ -223,7 +224,8 @@ void analyze_true_instance_ofs(
   }
 }
 
-RemoveResult analyze_and_evaluate_instance_of(DexMethod* method) {
+RemoveResult analyze_and_evaluate_instance_of(
+    DexMethod* method, const SubtypingIndex* subtyping_index) {
   ScopedCFG cfg(method->get_code());
   CFGMutation mutation(*cfg);
 
@@ -263,7 +265,8 @@ RemoveResult analyze_and_evaluate_instance_of(DexMethod* method) {
         continue;
       }
 
-      auto eval = type::evaluate_type_check(*src_type_state, test_type);
+      auto eval = type::evaluate_type_check(*src_type_state, test_type,
+                                            subtyping_index);
       if (!eval) {
         continue;
       }
@@ -352,7 +355,8 @@ void handle_false_case(IRInstruction* insn,
   ++res.class_always_fail;
 }
 
-RemoveResult analyze_and_evaluate(DexMethod* method) {
+RemoveResult analyze_and_evaluate(DexMethod* method,
+                                  const SubtypingIndex* subtyping_index) {
   ScopedCFG cfg(method->get_code());
   CFGMutation mutation(*cfg);
 
@@ -391,7 +395,8 @@ RemoveResult analyze_and_evaluate(DexMethod* method) {
         continue;
       }
 
-      auto eval = type::evaluate_type_check(*src_type_state, test_type);
+      auto eval = type::evaluate_type_check(*src_type_state, test_type,
+                                            subtyping_index);
       if (!eval) {
         continue;
       }
@@ -500,11 +505,13 @@ size_t post_process(DexMethod* method,
 
 RemoveResult optimize_impl(DexMethod* method,
                            XStoreRefs& xstores,
+                           const SubtypingIndex* subtyping_index,
                            bool has_instance_of,
                            bool has_check_cast) {
   RemoveResult instance_of_res;
   if (has_instance_of) {
-    instance_of_res = instance_of::analyze_and_evaluate_instance_of(method);
+    instance_of_res = instance_of::analyze_and_evaluate_instance_of(
+        method, subtyping_index);
 
     if (instance_of_res.overrides != 0) {
       instance_of_res.insn_delta =
@@ -514,7 +521,7 @@ RemoveResult optimize_impl(DexMethod* method,
 
   RemoveResult check_cast_res;
   if (has_check_cast) {
-    check_cast_res = check_cast::analyze_and_evaluate(method);
+    check_cast_res = check_cast::analyze_and_evaluate(method, subtyping_index);
 
     if (check_cast_res.overrides != 0) {
       check_cast_res.insn_delta =
@@ -534,7 +541,7 @@ boost::optional<int32_t> EvaluateTypeChecksPass::evaluate(
 }
 
 void EvaluateTypeChecksPass::optimize(DexMethod* method, XStoreRefs& xstores) {
-  optimize_impl(method, xstores, true, true);
+  optimize_impl(method, xstores, /* subtyping_index */ nullptr, true, true);
 }
 
 void EvaluateTypeChecksPass::run_pass(DexStoresVector& stores,
@@ -542,9 +549,11 @@ void EvaluateTypeChecksPass::run_pass(DexStoresVector& stores,
                                       PassManager& mgr) {
   auto scope = build_class_scope(stores);
   XStoreRefs xstores(stores);
+  // The pass doesn't change the class hierarchy.
+  SubtypingIndex subtyping_index(scope);
 
   auto stats = walk::parallel::methods<RemoveResult>(
-      scope, [&xstores](DexMethod* method) {
+      scope, [&xstores, &subtyping_index](DexMethod* method) {
         auto code = method->get_code();
         if (code == nullptr || method->rstate.no_optimizations()) {
           return RemoveResult{};
@@ -571,8 +580,8 @@ void EvaluateTypeChecksPass::run_pass(DexStoresVector& stores,
           return RemoveResult();
         }
 
-        auto res =
-            optimize_impl(method, xstores, has_insns.first, has_insns.second);
+        auto res = optimize_impl(method, xstores, &subtyping_index,
+                                 has_insns.first, has_insns.second);
         res.methods_w_instanceof = 1;
         return res;
       });
@@ -7,6 +7,7 @@
 
 #include "Instrument.h"
 
+#include "DexAccess.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "InterDexPass.h"
@@ -341,6 +342,91 @@ void insert_invoke_static_call_bb(IRCode* code,
   }
 }
 
+// Instead of passing the bit vectors to onMethodExitBB, OR them directly into
+// the slots of the method in the stats array:
+//
+//  SGET_OBJECT <stats array>
+//  IOPCODE_MOVE_RESULT_PSEUDO_OBJECT <v_array>
+//  For each bit vector <v_i>:
+//   CONST <v_index>, [method_id + i]
+//   AGET <v_array>, <v_index>
+//   IOPCODE_MOVE_RESULT_PSEUDO <v_value>
+//   OR_INT <v_value>, <v_value>, <v_i>
+//   APUT <v_value>, <v_array>, <v_index>
+//
+// This avoids a call at every exit point of the method.
+void insert_inline_bb_vector_updates(IRCode* code,
+                                     size_t method_id,
+                                     DexFieldRef* stats_field,
+                                     const std::vector<reg_t>& reg_bb_vector) {
+  std::vector<IRList::iterator> exits;
+  for (auto mie = code->begin(); mie != code->end(); ++mie) {
+    if (mie->type == MFLOW_OPCODE && is_return(mie->insn->opcode())) {
+      exits.push_back(mie);
+    }
+  }
+  // The temps are only live within each update sequence, so all exit points
+  // share them, rather than widening the frame for every return.
+  const auto reg_array = code->allocate_temp();
+  const auto reg_index = code->allocate_temp();
+  const auto reg_value = code->allocate_temp();
+  for (const auto& insert_point : exits) {
+    std::vector<IRInstruction*> insts;
+    insts.push_back(
+        (new IRInstruction(OPCODE_SGET_OBJECT))->set_field(stats_field));
+    insts.push_back((new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+                        ->set_dest(reg_array));
+    for (size_t i = 0; i < reg_bb_vector.size(); ++i) {
+      insts.push_back((new IRInstruction(OPCODE_CONST))
+                          ->set_literal(method_id + i)
+                          ->set_dest(reg_index));
+      insts.push_back((new IRInstruction(OPCODE_AGET))
+                          ->set_srcs_size(2)
+                          ->set_src(0, reg_array)
+                          ->set_src(1, reg_index));
+      insts.push_back(
+          (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO))->set_dest(reg_value));
+      insts.push_back((new IRInstruction(OPCODE_OR_INT))
+                          ->set_srcs_size(2)
+                          ->set_src(0, reg_value)
+                          ->set_src(1, reg_bb_vector[i])
+                          ->set_dest(reg_value));
+      insts.push_back((new IRInstruction(OPCODE_APUT))
+                          ->set_srcs_size(3)
+                          ->set_src(0, reg_value)
+                          ->set_src(1, reg_array)
+                          ->set_src(2, reg_index));
+    }
+
+    // Just like the invokes, the array accesses must not add throw edges.
+    auto catch_block = find_try_block(code, insert_point);
+    insert_try_end_instr(code, insert_point, catch_block);
+    for (auto insn : insts) {
+      code->insert_before(insert_point, insn);
+    }
+    insert_try_start_instr(code, insert_point, catch_block);
+  }
+}
+
+// A block doesn't need its own bit if it executes exactly when its only
+// predecessor does: the predecessor has no other successor, and none of its
+// instructions can throw. Returns the predecessor in that case.
+cfg::Block* find_equivalent_pred(cfg::Block* block) {
+  if (block->preds().size() != 1) {
+    return nullptr;
+  }
+  auto pred = block->preds().front()->src();
+  if (pred == block || pred->succs().size() != 1) {
+    return nullptr;
+  }
+  for (const auto& mie : InstructionIterable(pred)) {
+    if (opcode::can_throw(mie.insn->opcode())) {
+      return nullptr;
+    }
+  }
+  return pred;
+}
+
 IRList::iterator find_or_insn_insert_point(cfg::Block* block) {
   // After every invoke instruction, the value returned from the function is
   // moved to a register. The instruction used to move depends on the type of
@@ -372,15 +458,27 @@ IRList::iterator find_or_insn_insert_point(cfg::Block* block) {
 // used to distinguish multiple bit vectors. The set MSB indicates continuation:
 // read the following vector(s) again until we see the unset MSB. We actually
 // use 15 bits per vector.
+//
+// If stats_field is given, the bit vectors are written to the stats array
+// inline at the exit points instead of being passed to onMethodExitBB.
+//
+// If skip_equivalent_blocks is set, blocks whose execution is implied by their
+// only predecessor are not instrumented. They are recorded in
+// skipped_blocks_map, so that their bits can be inferred from the bits of the
+// predecessors.
 int instrument_onBasicBlockBegin(
     IRCode* code,
     DexMethod* method,
     const std::unordered_map<int, DexMethod*>& method_onMethodExit_map,
+    DexFieldRef* stats_field,
+    bool skip_equivalent_blocks,
     size_t method_id,
     int& all_bbs,
     int& num_blocks_instrumented,
+    int& num_blocks_skipped,
     int& all_methods_inst,
     std::map<int, std::pair<std::string, int>>& method_id_name_map,
+    std::map<int, std::vector<std::pair<size_t, size_t>>>& skipped_blocks_map,
     std::map<size_t, int>& bb_vector_stat) {
   assert(code != nullptr);
 
@@ -415,12 +513,53 @@ int instrument_onBasicBlockBegin(
   // before actual instrumentation to get the updated CFG after adding edges to
   // this invoke call. The INVOKE call takes (num_vectors + 1) arguments:
   // Method ID (actually, the short array offset) and bit vectors * n.
-  size_t index_to_method = (num_vectors > 5) ? 1 : num_vectors + 1;
   ++bb_vector_stat[num_vectors];
-  assert(method_onMethodExit_map.count(index_to_method));
-  insert_invoke_static_call_bb(code, method_id,
-                               method_onMethodExit_map.at(index_to_method),
-                               reg_bb_vector);
+  if (stats_field != nullptr) {
+    insert_inline_bb_vector_updates(code, method_id, stats_field,
+                                    reg_bb_vector);
+  } else {
+    size_t index_to_method = (num_vectors > 5) ? 1 : num_vectors + 1;
+    assert(method_onMethodExit_map.count(index_to_method));
+    insert_invoke_static_call_bb(code, method_id,
+                                 method_onMethodExit_map.at(index_to_method),
+                                 reg_bb_vector);
+  }
+
+  // Blocks that are instrumented, and whose execution therefore doesn't need
+  // to be implied by another block.
+  std::unordered_set<cfg::Block*> instrumented_blocks;
+  for (cfg::Block* block : blocks) {
+    auto insert_point = find_or_insn_insert_point(block);
+    // Block::num_opcodes() is only available on editable CFGs.
+    if (insert_point != block->end() && !InstructionIterable(block).empty()) {
+      instrumented_blocks.insert(block);
+    }
+  }
+  if (skip_equivalent_blocks) {
+    std::unordered_map<cfg::Block*, cfg::Block*> candidates;
+    for (cfg::Block* block : blocks) {
+      auto pred = find_equivalent_pred(block);
+      if (pred != nullptr && instrumented_blocks.count(block) &&
+          instrumented_blocks.count(pred)) {
+        candidates.emplace(block, pred);
+      }
+    }
+    // Blocks are only skipped in favor of predecessors that keep their bits.
+    for (const auto& p : candidates) {
+      if (!candidates.count(p.second)) {
+        skipped_blocks_map[method_id].emplace_back(p.first->id(),
+                                                   p.second->id());
+      }
+    }
+    auto& skipped = skipped_blocks_map[method_id];
+    std::sort(skipped.begin(), skipped.end());
+    num_blocks_skipped += skipped.size();
+    for (const auto& p : candidates) {
+      if (!candidates.count(p.second)) {
+        instrumented_blocks.erase(p.first);
+      }
+    }
+  }
 
   for (cfg::Block* block : blocks) {
     const size_t block_vector_index = block->id() / 15;
@@ -438,9 +577,11 @@ int instrument_onBasicBlockBegin(
     // We do not instrument a Basic block if:
     // 1. It only has internal or MOVE instructions.
     // 2. BB has no opcodes.
-    if (insert_point == block->end() || block->num_opcodes() < 1) {
+    // 3. It is skipped in favor of an equivalent predecessor.
+    if (!instrumented_blocks.count(block)) {
       TRACE(INSTRUMENT, 7, "No instrumentation to block: %s",
             SHOW(show(method) + std::to_string(block->id())));
+      delete or_inst;
       continue;
     }
     num_blocks_instrumented++;
@@ -638,13 +779,36 @@ void patch_static_field(DexClass* analysis_cls,
   TRACE(INSTRUMENT, 2, "%s was patched: %d", SHOW(field_name), new_number);
 }
 
+// Every line of the metadata file is "<method id>,<method>,<number of blocks>".
+// If skip_equivalent_blocks is set, every line gets a fourth, quoted column
+// with a space-separated list of "<skipped block>=<equivalent block>" pairs,
+// sorted by skipped block, e.g.:
+//
+//   1,LFoo;.bar:()V,6,"3=2 5=4"
+//   2,LFoo;.baz:()V,2,""
+//
+// The bits of the skipped blocks are never set in the stats; a consumer must
+// set them whenever the bit of their equivalent block is set.
 void write_basic_block_index_file(
     const std::string& file_name,
-    const std::map<int, std::pair<std::string, int>>& id_name_map) {
+    const std::map<int, std::pair<std::string, int>>& id_name_map,
+    const std::map<int, std::vector<std::pair<size_t, size_t>>>*
+        skipped_blocks_map) {
   std::ofstream ofs(file_name, std::ofstream::out | std::ofstream::trunc);
   for (const auto& p : id_name_map) {
-    ofs << p.first << "," << p.second.first << "," << p.second.second
-        << std::endl;
+    ofs << p.first << "," << p.second.first << "," << p.second.second;
+    if (skipped_blocks_map != nullptr) {
+      ofs << ",\"";
+      auto it = skipped_blocks_map->find(p.first);
+      if (it != skipped_blocks_map->end()) {
+        for (size_t i = 0; i < it->second.size(); ++i) {
+          ofs << (i == 0 ? "" : " ") << it->second[i].first << "="
+              << it->second[i].second;
+        }
+      }
+      ofs << "\"";
+    }
+    ofs << std::endl;
   }
   TRACE(INSTRUMENT, 2, "Index file was written to: %s", SHOW(file_name));
 }
@@ -1083,6 +1247,11 @@ void do_simple_method_tracing(DexClass* analysis_cls,
 //                                                     |   Return              |
 //                                                     +-----------------------+
 //
+// With inline_bb_vector_updates, the INVOKE is replaced by instructions that
+// OR the bit vectors into sBasicBlockStats directly, so that instrumented
+// methods don't make any calls. With skip_equivalent_blocks, blocks that
+// execute exactly when their only predecessor does are not instrumented.
+//
 void do_basic_block_tracing(DexClass* analysis_cls,
                             DexStoresVector& stores,
                             ConfigFiles& cfg,
@@ -1091,13 +1260,29 @@ void do_basic_block_tracing(DexClass* analysis_cls,
   const auto& method_onMethodExit_map = find_and_verify_analysis_method(
       *analysis_cls, options.analysis_method_name);
 
+  DexField* stats_field = nullptr;
+  if (options.inline_bb_vector_updates) {
+    stats_field = analysis_cls->find_field_from_simple_deobfuscated_name(
+        "sBasicBlockStats");
+    always_assert_log(
+        stats_field != nullptr &&
+            stats_field->get_type() == DexType::make_type("[I"),
+        "Failed to find int[] sBasicBlockStats in %s", SHOW(analysis_cls));
+    // Every instrumented class reads the field.
+    set_public(analysis_cls);
+    set_public(stats_field);
+  }
+
   size_t method_index = 1;
   int all_bb_nums = 0;
   int all_methods = 0;
   int all_bb_inst = 0;
+  int all_bb_skipped = 0;
   int all_method_inst = 0;
   std::map<int /*id*/, std::pair<std::string, int /*number of BBs*/>>
       method_id_name_map;
+  std::map<int /*id*/, std::vector<std::pair<size_t, size_t>>>
+      skipped_blocks_map;
   auto scope = build_class_scope(stores);
 
   auto interdex_list = cfg.get_coldstart_classes();
@@ -1140,13 +1325,16 @@ void do_basic_block_tracing(DexClass* analysis_cls,
     TRACE(INSTRUMENT, 9, "Whitelist: included: %s", SHOW(method));
     all_methods++;
     method_index = instrument_onBasicBlockBegin(
-        &code, method, method_onMethodExit_map, method_index, all_bb_nums,
-        all_bb_inst, all_method_inst, method_id_name_map, bb_vector_stat);
+        &code, method, method_onMethodExit_map, stats_field,
+        options.skip_equivalent_blocks, method_index, all_bb_nums, all_bb_inst,
+        all_bb_skipped, all_method_inst, method_id_name_map,
+        skipped_blocks_map, bb_vector_stat);
   });
   patch_array_size(analysis_cls, "sBasicBlockStats", method_index);
 
-  write_basic_block_index_file(cfg.metafile(options.metadata_file_name),
-                               method_id_name_map);
+  write_basic_block_index_file(
+      cfg.metafile(options.metadata_file_name), method_id_name_map,
+      options.skip_equivalent_blocks ? &skipped_blocks_map : nullptr);
 
   double cumulative = 0.;
   TRACE(INSTRUMENT, 4, "BB vector stats:");
@@ -1161,6 +1349,7 @@ void do_basic_block_tracing(DexClass* analysis_cls,
         "Instrumented %d methods and %d blocks, out of %d methods and %d "
         "blocks",
         (all_method_inst - 1), all_bb_inst, all_methods, all_bb_nums);
+  pm.set_metric("skipped_equivalent_blocks", all_bb_skipped);
 }
 
 std::unordered_set<std::string> load_blacklist_file(
@@ -1194,6 +1383,14 @@ void InstrumentPass::bind_config() {
   bind("num_stats_per_method", {1}, m_options.num_stats_per_method);
   bind("num_shards", {1}, m_options.num_shards);
   bind("only_cold_start_class", true, m_options.only_cold_start_class);
+  bind("inline_bb_vector_updates", false, m_options.inline_bb_vector_updates,
+       "For basic_block_tracing: write the bit vectors to sBasicBlockStats "
+       "inline instead of calling the analysis method at method exits. The "
+       "field and the analysis class are made public.");
+  bind("skip_equivalent_blocks", false, m_options.skip_equivalent_blocks,
+       "For basic_block_tracing: don't instrument blocks that execute exactly "
+       "when their only predecessor does. The metadata file gets a fourth "
+       "column listing each skipped block as \"<skipped>=<equivalent>\".");
   bind("methods_replacement", {}, m_options.methods_replacement,
        "Replacing instance method call with static method call.",
        Configurable::bindflags::methods::error_if_unresolvable);
@@ -29,6 +29,8 @@ class InstrumentPass : public Pass {
     int64_t num_stats_per_method;
     int64_t num_shards;
     bool only_cold_start_class;
+    bool inline_bb_vector_updates;
+    bool skip_equivalent_blocks;
     std::unordered_map<DexMethod*, DexMethod*> methods_replacement;
   };
 
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ClassReferencesCache.h"
+
+#include "DexUtil.h"
+#include "Timer.h"
+#include "Walkers.h"
+
+namespace interdex {
+
+ClassReferences::ClassReferences(const DexClass* cls) {
+  cls->gather_methods(method_refs);
+  cls->gather_fields(field_refs);
+  cls->gather_types(types);
+  cls->gather_strings(strings);
+
+  // remove duplicates to speed up actual sorting
+  sort_unique(method_refs);
+  sort_unique(field_refs);
+  sort_unique(types);
+  sort_unique(strings);
+
+  // sort deterministically
+  std::sort(method_refs.begin(), method_refs.end(), compare_dexmethods);
+  std::sort(field_refs.begin(), field_refs.end(), compare_dexfields);
+  std::sort(types.begin(), types.end(), compare_dextypes);
+  std::sort(strings.begin(), strings.end(), compare_dexstrings);
+}
+
+void ClassReferencesCache::populate(const Scope& scope) {
+  Timer t("Gathering class references");
+  // Create all entries up front, so that the map doesn't change while the
+  // workers fill in the values.
+  for (auto cls : scope) {
+    m_class_refs[cls] = nullptr;
+  }
+  walk::parallel::classes(scope, [this](DexClass* cls) {
+    m_class_refs.at(cls) = std::make_shared<const ClassReferences>(cls);
+  });
+}
+
+std::shared_ptr<const ClassReferences> ClassReferencesCache::get(
+    const DexClass* cls) const {
+  auto it = m_class_refs.find(cls);
+  if (it != m_class_refs.end()) {
+    return it->second;
+  }
+  return std::make_shared<const ClassReferences>(cls);
+}
+
+} // namespace interdex
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "DexClass.h"
+
+namespace interdex {
+
+/**
+ * The refs of a class that contribute to cross-dex metadata entries, each
+ * without duplicates and sorted deterministically.
+ */
+struct ClassReferences {
+  std::vector<DexMethodRef*> method_refs;
+  std::vector<DexFieldRef*> field_refs;
+  std::vector<DexType*> types;
+  std::vector<DexString*> strings;
+
+  explicit ClassReferences(const DexClass* cls);
+};
+
+/**
+ * Gathering the refs of a class means walking all of its code. InterDex needs
+ * them several times for every class of the root store: to sample and
+ * prioritize classes for the cross-dex ref minimizer, and when emitting the
+ * class (and again if it doesn't fit into the current dex). This cache
+ * gathers them for all classes up front, in parallel.
+ */
+class ClassReferencesCache {
+ public:
+  /**
+   * Gather the refs of all classes in the scope in parallel.
+   */
+  void populate(const Scope& scope);
+
+  /**
+   * The refs of a populated class; for any other class, they are gathered on
+   * the spot, without being cached.
+   */
+  std::shared_ptr<const ClassReferences> get(const DexClass* cls) const;
+
+  /**
+   * Drop all cached refs. Must be called when refs change in place, as that
+   * affects the refs of all classes that use them.
+   */
+  void clear() { m_class_refs.clear(); }
+
+ private:
+  std::unordered_map<const DexClass*, std::shared_ptr<const ClassReferences>>
+      m_class_refs;
+};
+
+} // namespace interdex
@@ -100,29 +100,6 @@ void CrossDexRefMinimizer::reprioritize(
   }
 }
 
-void CrossDexRefMinimizer::gather_refs(DexClass* cls,
-                                       std::vector<DexMethodRef*>& method_refs,
-                                       std::vector<DexFieldRef*>& field_refs,
-                                       std::vector<DexType*>& types,
-                                       std::vector<DexString*>& strings) {
-  cls->gather_methods(method_refs);
-  cls->gather_fields(field_refs);
-  cls->gather_types(types);
-  cls->gather_strings(strings);
-
-  // remove duplicates to speed up actual sorting
-  sort_unique(method_refs);
-  sort_unique(field_refs);
-  sort_unique(types);
-  sort_unique(strings);
-
-  // sort deterministically
-  std::sort(method_refs.begin(), method_refs.end(), compare_dexmethods);
-  std::sort(field_refs.begin(), field_refs.end(), compare_dexfields);
-  std::sort(types.begin(), types.end(), compare_dextypes);
-  std::sort(strings.begin(), strings.end(), compare_dexstrings);
-}
-
 void CrossDexRefMinimizer::ignore(DexClass* cls) {
   // By setting the count to the maximum value here, the class will later appear
   // to have an extremely high frequency and thus get skipped from
@@ -131,11 +108,7 @@ void CrossDexRefMinimizer::ignore(DexClass* cls) {
 }
 
 void CrossDexRefMinimizer::sample(DexClass* cls) {
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
+  auto class_refs = m_class_refs_cache.get(cls);
   auto increment = [& ref_counts = m_ref_counts,
                     &max_ref_count = m_max_ref_count](void* ref) {
     size_t& count = ref_counts[ref];
@@ -143,16 +116,16 @@ void CrossDexRefMinimizer::sample(DexClass* cls) {
       max_ref_count = count;
     }
   };
-  for (auto ref : method_refs) {
+  for (auto ref : class_refs->method_refs) {
     increment(ref);
   }
-  for (auto ref : field_refs) {
+  for (auto ref : class_refs->field_refs) {
     increment(ref);
   }
-  for (auto ref : types) {
+  for (auto ref : class_refs->types) {
     increment(ref);
   }
-  for (auto ref : strings) {
+  for (auto ref : class_refs->strings) {
     increment(ref);
   }
 }
@@ -169,11 +142,11 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
   // entries.
   // We don't bother with protos and type_lists, as they are directly related
   // to method refs (I tried, didn't help).
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
+  auto class_refs = m_class_refs_cache.get(cls);
+  const auto& method_refs = class_refs->method_refs;
+  const auto& field_refs = class_refs->field_refs;
+  const auto& types = class_refs->types;
+  const auto& strings = class_refs->strings;
 
   auto& refs = class_info.refs;
   refs.reserve(method_refs.size() + field_refs.size() + types.size() +
@@ -11,6 +11,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "ClassReferencesCache.h"
 #include "DexClass.h"
 #include "MutablePriorityQueue.h"
 
@@ -114,15 +115,12 @@ class CrossDexRefMinimizer {
   std::unordered_map<void*, size_t> m_ref_counts;
   size_t m_max_ref_count{0};
 
-  void gather_refs(DexClass* cls,
-                   std::vector<DexMethodRef*>& method_refs,
-                   std::vector<DexFieldRef*>& field_refs,
-                   std::vector<DexType*>& types,
-                   std::vector<DexString*>& strings);
+  const ClassReferencesCache& m_class_refs_cache;
 
  public:
-  explicit CrossDexRefMinimizer(const CrossDexRefMinimizerConfig& config)
-      : m_config(config) {}
+  CrossDexRefMinimizer(const CrossDexRefMinimizerConfig& config,
+                       const ClassReferencesCache& class_refs_cache)
+      : m_config(config), m_class_refs_cache(class_refs_cache) {}
   // Gather frequency counts; must be called for relevant classes before
   // inserting them
   void sample(DexClass* cls);
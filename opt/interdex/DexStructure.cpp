@@ -79,20 +79,12 @@ unsigned estimate_linear_alloc(const DexClass* clazz) {
   return lasize;
 }
 
-/**
- * Removes the elements of b from a. Runs in O(size(a)), so it works best if
- * size(a) << size(b).
- */
-template <typename T>
-std::unordered_set<T> set_difference(const std::unordered_set<T>& a,
-                                     const std::unordered_set<T>& b) {
-  std::unordered_set<T> result;
-  for (auto& v : a) {
-    if (!b.count(v)) {
-      result.emplace(v);
-    }
-  }
-  return result;
+template <typename Ref>
+bool contains_ref(const interdex::RefIds<Ref>& ids,
+                  const interdex::RefIdSet& set,
+                  Ref* ref) {
+  uint32_t id;
+  return ids.find_id(ref, &id) && set.contains(id);
 }
 
 } // namespace
@@ -155,7 +147,7 @@ DexClasses DexesStructure::end_dex(DexInfo dex_info) {
 
   DexClasses all_classes = m_current_dex.take_all_classes();
 
-  m_current_dex = DexStructure();
+  m_current_dex = DexStructure(m_current_dex.get_ref_ids());
   return all_classes;
 }
 
@@ -191,35 +183,36 @@ bool DexStructure::add_class_if_fits(const MethodRefs& clazz_mrefs,
     return false;
   }
 
-  auto extra_mrefs = set_difference(clazz_mrefs, m_mrefs);
-  auto extra_frefs = set_difference(clazz_frefs, m_frefs);
-  auto extra_trefs = set_difference(clazz_trefs, m_trefs);
+  get_clazz_ids(clazz_mrefs, clazz_frefs, clazz_trefs);
+  auto num_mrefs = m_mrefs.size() + m_mrefs.count_missing(m_clazz_mref_ids);
+  auto num_frefs = m_frefs.size() + m_frefs.count_missing(m_clazz_fref_ids);
+  auto num_trefs = m_trefs.size() + m_trefs.count_missing(m_clazz_tref_ids);
 
-  if (m_mrefs.size() + extra_mrefs.size() >= method_refs_limit) {
+  if (num_mrefs >= method_refs_limit) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the method refs limit: %d >= %d: %s",
-          m_mrefs.size() + extra_mrefs.size(), method_refs_limit, SHOW(clazz));
+          num_mrefs, method_refs_limit, SHOW(clazz));
     return false;
   }
 
-  if (m_frefs.size() + extra_frefs.size() >= field_refs_limit) {
+  if (num_frefs >= field_refs_limit) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the field refs limit: %d >= %d: %s",
-          m_frefs.size() + extra_frefs.size(), field_refs_limit, SHOW(clazz));
+          num_frefs, field_refs_limit, SHOW(clazz));
     return false;
   }
 
-  if (m_trefs.size() + extra_trefs.size() >= type_refs_limit) {
+  if (num_trefs >= type_refs_limit) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the type refs limit: %d >= %d: %s",
-          m_trefs.size() + extra_trefs.size(), type_refs_limit, SHOW(clazz));
+          num_trefs, type_refs_limit, SHOW(clazz));
     return false;
   }
 
-  add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs, laclazz, clazz);
+  add_clazz_ids(laclazz, clazz);
   return true;
 }
 
@@ -228,10 +221,23 @@ void DexStructure::add_class_no_checks(const MethodRefs& clazz_mrefs,
                                        const TypeRefs& clazz_trefs,
                                        unsigned laclazz,
                                        DexClass* clazz) {
+  get_clazz_ids(clazz_mrefs, clazz_frefs, clazz_trefs);
+  add_clazz_ids(laclazz, clazz);
+}
+
+void DexStructure::get_clazz_ids(const MethodRefs& clazz_mrefs,
+                                 const FieldRefs& clazz_frefs,
+                                 const TypeRefs& clazz_trefs) {
+  m_ref_ids->mrefs.get_or_assign_ids(clazz_mrefs, &m_clazz_mref_ids);
+  m_ref_ids->frefs.get_or_assign_ids(clazz_frefs, &m_clazz_fref_ids);
+  m_ref_ids->trefs.get_or_assign_ids(clazz_trefs, &m_clazz_tref_ids);
+}
+
+void DexStructure::add_clazz_ids(unsigned laclazz, DexClass* clazz) {
   TRACE(IDEX, 7, "Adding class: %s", SHOW(clazz));
-  m_mrefs.insert(clazz_mrefs.begin(), clazz_mrefs.end());
-  m_frefs.insert(clazz_frefs.begin(), clazz_frefs.end());
-  m_trefs.insert(clazz_trefs.begin(), clazz_trefs.end());
+  m_mrefs.insert(m_clazz_mref_ids);
+  m_frefs.insert(m_clazz_fref_ids);
+  m_trefs.insert(m_clazz_tref_ids);
   m_linear_alloc_size += laclazz;
   m_classes.push_back(clazz);
 }
@@ -254,7 +260,7 @@ void DexStructure::check_refs_count() {
     std::vector<DexMethodRef*> mrefs_vec(mrefs_set.begin(), mrefs_set.end());
     std::sort(mrefs_vec.begin(), mrefs_vec.end(), compare_dexmethods);
     for (DexMethodRef* mr : mrefs_vec) {
-      if (!m_mrefs.count(mr)) {
+      if (!contains_ref(m_ref_ids->mrefs, m_mrefs, mr)) {
         TRACE(IDEX, 4, "WARNING: Could not find %s in predicted mrefs set",
               SHOW(mr));
       }
@@ -270,7 +276,7 @@ void DexStructure::check_refs_count() {
     std::vector<DexFieldRef*> frefs_vec(frefs_set.begin(), frefs_set.end());
     std::sort(frefs_vec.begin(), frefs_vec.end(), compare_dexfields);
     for (auto* fr : frefs_vec) {
-      if (!m_frefs.count(fr)) {
+      if (!contains_ref(m_ref_ids->frefs, m_frefs, fr)) {
         TRACE(IDEX, 4, "WARNING: Could not find %s in predicted frefs set",
               SHOW(fr));
       }
@@ -288,7 +294,10 @@ void DexStructure::squash_empty_last_class(DexClass* clazz) {
   always_assert(clazz->get_ifields().empty());
   always_assert(!is_interface(clazz));
   m_classes.pop_back();
-  m_trefs.erase(clazz->get_type());
+  uint32_t id;
+  if (m_ref_ids->trefs.find_id(clazz->get_type(), &id)) {
+    m_trefs.erase(id);
+  }
   m_squashed_classes.push_back(clazz);
 }
 
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -20,6 +22,105 @@ using MethodRefs = std::unordered_set<DexMethodRef*>;
 using FieldRefs = std::unordered_set<DexFieldRef*>;
 using TypeRefs = std::unordered_set<DexType*>;
 
+/**
+ * Assigns dense ids to refs in the order in which they are first seen, so that
+ * the refs of a dex can be kept in a bitset. Ids are never reused.
+ */
+template <typename Ref>
+class RefIds {
+ public:
+  uint32_t get_or_assign_id(Ref* ref) {
+    auto res = m_ids.emplace(ref, m_refs.size());
+    if (res.second) {
+      m_refs.push_back(ref);
+    }
+    return res.first->second;
+  }
+
+  // Returns false if the ref has never been seen.
+  bool find_id(Ref* ref, uint32_t* id) const {
+    auto it = m_ids.find(ref);
+    if (it == m_ids.end()) {
+      return false;
+    }
+    *id = it->second;
+    return true;
+  }
+
+  void get_or_assign_ids(const std::unordered_set<Ref*>& refs,
+                         std::vector<uint32_t>* ids) {
+    ids->clear();
+    ids->reserve(refs.size());
+    for (auto* ref : refs) {
+      ids->push_back(get_or_assign_id(ref));
+    }
+  }
+
+ private:
+  std::unordered_map<Ref*, uint32_t> m_ids;
+  std::vector<Ref*> m_refs;
+};
+
+/**
+ * The ids of all refs seen so far, shared by all the dexes being built.
+ */
+struct DexRefIds {
+  RefIds<DexMethodRef> mrefs;
+  RefIds<DexFieldRef> frefs;
+  RefIds<DexType> trefs;
+};
+
+/**
+ * A set of ref ids, stored as a bitset.
+ */
+class RefIdSet {
+ public:
+  size_t size() const { return m_size; }
+
+  bool contains(uint32_t id) const {
+    size_t word = id / 64;
+    return word < m_words.size() && ((m_words[word] >> (id % 64)) & 1);
+  }
+
+  /**
+   * Number of the given ids that are not in this set. The ids must be unique.
+   */
+  size_t count_missing(const std::vector<uint32_t>& ids) const {
+    size_t missing = 0;
+    for (auto id : ids) {
+      missing += !contains(id);
+    }
+    return missing;
+  }
+
+  void insert(uint32_t id) {
+    size_t word = id / 64;
+    if (word >= m_words.size()) {
+      m_words.resize(word + 1);
+    }
+    uint64_t bit = uint64_t(1) << (id % 64);
+    m_size += !(m_words[word] & bit);
+    m_words[word] |= bit;
+  }
+
+  void insert(const std::vector<uint32_t>& ids) {
+    for (auto id : ids) {
+      insert(id);
+    }
+  }
+
+  void erase(uint32_t id) {
+    if (contains(id)) {
+      m_words[id / 64] &= ~(uint64_t(1) << (id % 64));
+      m_size--;
+    }
+  }
+
+ private:
+  std::vector<uint64_t> m_words;
+  size_t m_size{0};
+};
+
 struct DexInfo {
   bool primary{false};
   bool coldstart{false};
@@ -30,7 +131,11 @@ struct DexInfo {
 
 class DexStructure {
  public:
-  DexStructure() : m_linear_alloc_size(0) {}
+  explicit DexStructure(
+      std::shared_ptr<DexRefIds> ref_ids = std::make_shared<DexRefIds>())
+      : m_linear_alloc_size(0), m_ref_ids(std::move(ref_ids)) {}
+
+  const std::shared_ptr<DexRefIds>& get_ref_ids() const { return m_ref_ids; }
 
   size_t get_linear_alloc_size() const { return m_linear_alloc_size; }
 
@@ -67,10 +172,22 @@ class DexStructure {
   void squash_empty_last_class(DexClass* clazz);
 
  private:
+  // Converts the refs of a class to ids, into the m_clazz_*_ids scratch
+  // vectors.
+  void get_clazz_ids(const MethodRefs& clazz_mrefs,
+                     const FieldRefs& clazz_frefs,
+                     const TypeRefs& clazz_trefs);
+
+  void add_clazz_ids(unsigned laclazz, DexClass* clazz);
+
   size_t m_linear_alloc_size;
-  TypeRefs m_trefs;
-  MethodRefs m_mrefs;
-  FieldRefs m_frefs;
+  std::shared_ptr<DexRefIds> m_ref_ids;
+  RefIdSet m_trefs;
+  RefIdSet m_mrefs;
+  RefIdSet m_frefs;
+  std::vector<uint32_t> m_clazz_mref_ids;
+  std::vector<uint32_t> m_clazz_fref_ids;
+  std::vector<uint32_t> m_clazz_tref_ids;
   std::vector<DexClass*> m_classes;
   std::vector<DexClass*> m_squashed_classes;
 };
@@ -129,6 +129,7 @@ std::unordered_set<DexClass*> find_unrefenced_coldstart_classes(
 
 void gather_refs(
     const std::vector<std::unique_ptr<interdex::InterDexPassPlugin>>& plugins,
+    const interdex::ClassReferencesCache& class_refs_cache,
     const interdex::DexInfo& dex_info,
     const DexClass* cls,
     interdex::MethodRefs* mrefs,
@@ -136,13 +137,15 @@ void gather_refs(
     interdex::TypeRefs* trefs,
     std::vector<DexClass*>* erased_classes,
     bool should_not_relocate_methods_of_class) {
+  auto class_refs = class_refs_cache.get(cls);
+  mrefs->insert(class_refs->method_refs.begin(), class_refs->method_refs.end());
+  frefs->insert(class_refs->field_refs.begin(), class_refs->field_refs.end());
+  trefs->insert(class_refs->types.begin(), class_refs->types.end());
+
+  // Plugins only add the refs of whatever they are going to add to the dex.
   std::vector<DexMethodRef*> method_refs;
   std::vector<DexFieldRef*> field_refs;
   std::vector<DexType*> type_refs;
-  cls->gather_methods(method_refs);
-  cls->gather_fields(field_refs);
-  cls->gather_types(type_refs);
-
   for (const auto& plugin : plugins) {
     plugin->gather_refs(dex_info, cls, method_refs, field_refs, type_refs,
                         erased_classes, should_not_relocate_methods_of_class);
@@ -273,8 +276,8 @@ bool InterDex::emit_class(DexInfo& dex_info,
   MethodRefs clazz_mrefs;
   FieldRefs clazz_frefs;
   TypeRefs clazz_trefs;
-  gather_refs(m_plugins, dex_info, clazz, &clazz_mrefs, &clazz_frefs,
-              &clazz_trefs, erased_classes,
+  gather_refs(m_plugins, m_class_refs_cache, dex_info, clazz, &clazz_mrefs,
+              &clazz_frefs, &clazz_trefs, erased_classes,
               should_not_relocate_methods_of_class(clazz));
 
   bool fits_current_dex = m_dexes_structure.add_class_to_current_dex(
@@ -290,8 +293,8 @@ bool InterDex::emit_class(DexInfo& dex_info,
     clazz_frefs.clear();
     clazz_trefs.clear();
     if (erased_classes) erased_classes->clear();
-    gather_refs(m_plugins, dex_info, clazz, &clazz_mrefs, &clazz_frefs,
-                &clazz_trefs, erased_classes,
+    gather_refs(m_plugins, m_class_refs_cache, dex_info, clazz, &clazz_mrefs,
+                &clazz_frefs, &clazz_trefs, erased_classes,
                 should_not_relocate_methods_of_class(clazz));
 
     m_dexes_structure.add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs,
@@ -625,6 +628,11 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
               ? "yes"
               : "no",
           m_cross_dex_relocator_config.relocate_virtual_methods ? "yes" : "no");
+
+    // Relocating a method changes the class and proto of its ref in place,
+    // and with them the types referenced by all of its callers. Gather refs on
+    // the spot until all methods have been relocated.
+    m_class_refs_cache.clear();
   }
 
   std::vector<DexClass*> classes_to_insert;
@@ -669,6 +677,10 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
     classes_to_insert.emplace_back(cls);
   }
 
+  if (m_cross_dex_relocator != nullptr) {
+    m_class_refs_cache.populate(classes_to_insert);
+  }
+
   // Initialize ref frequency counts
   for (DexClass* cls : classes_to_insert) {
     m_cross_dex_ref_minimizer.sample(cls);
@@ -741,6 +753,7 @@ void InterDex::cleanup(const Scope& final_scope) {
 
 void InterDex::run_in_force_single_dex_mode() {
   auto scope = build_class_scope(m_dexen);
+  m_class_refs_cache.populate(scope);
 
   const std::vector<std::string>& coldstart_class_names =
       m_conf.get_coldstart_classes();
@@ -762,8 +775,8 @@ void InterDex::run_in_force_single_dex_mode() {
     TypeRefs clazz_trefs;
     std::vector<DexClass*> erased_classes;
 
-    gather_refs(m_plugins, dex_info, cls, &clazz_mrefs, &clazz_frefs,
-                &clazz_trefs, &erased_classes,
+    gather_refs(m_plugins, m_class_refs_cache, dex_info, cls, &clazz_mrefs,
+                &clazz_frefs, &clazz_trefs, &erased_classes,
                 should_not_relocate_methods_of_class(cls));
 
     m_dexes_structure.add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs,
@@ -787,6 +800,8 @@ void InterDex::run() {
     return;
   }
 
+  m_class_refs_cache.populate(m_scope);
+
   auto unreferenced_classes = find_unrefenced_coldstart_classes(
       m_scope, m_interdex_types, m_static_prune_classes);
 
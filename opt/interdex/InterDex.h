@@ -10,6 +10,7 @@
 #include <unordered_set>
 
 #include "ApkManager.h"
+#include "ClassReferencesCache.h"
 #include "CrossDexRefMinimizer.h"
 #include "CrossDexRelocator.h"
 #include "DexClass.h"
@@ -56,7 +57,7 @@ class InterDex {
         m_emitting_bg_set(false),
         m_emitted_bg_set(false),
         m_emitting_extended(false),
-        m_cross_dex_ref_minimizer(cross_dex_refs_config),
+        m_cross_dex_ref_minimizer(cross_dex_refs_config, m_class_refs_cache),
         m_cross_dex_relocator_config(cross_dex_relocator_config),
         m_original_scope(original_scope),
         m_scope(build_class_scope(m_dexen)),
@@ -165,6 +166,7 @@ class InterDex {
   std::vector<DexType*> m_end_markers;
   std::vector<DexType*> m_scroll_markers;
 
+  ClassReferencesCache m_class_refs_cache;
   CrossDexRefMinimizer m_cross_dex_ref_minimizer;
   const CrossDexRelocatorConfig m_cross_dex_relocator_config;
   const Scope& m_original_scope;
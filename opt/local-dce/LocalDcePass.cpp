@@ -18,6 +18,7 @@
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "GraphUtil.h"
+#include "HierarchyService.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "MethodOverrideGraph.h"
@@ -54,7 +55,8 @@ void LocalDcePass::run_pass(DexStoresVector& stores,
                       configured_pure_methods.end());
   auto rstate_pure_method = get_rstate_pure_methods(scope);
   pure_methods.insert(rstate_pure_method.begin(), rstate_pure_method.end());
-  auto override_graph = method_override_graph::build_graph(scope);
+  auto override_graph =
+      mgr.hierarchy_service().get_method_override_graph(scope);
   std::unordered_set<const DexMethod*> computed_no_side_effects_methods;
   auto computed_no_side_effects_methods_iterations =
       compute_no_side_effects_methods(scope, override_graph.get(), pure_methods,
@@ -8,6 +8,7 @@
 #include <list>
 
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRCode.h"
@@ -72,57 +73,77 @@ void debug_logging(std::vector<DexClass*>& classes) {
   TRACE(OBFUSCATE, 3, "Finished applying new names to defs");
 }
 
-template <typename DexMember,
-          typename DexMemberRef,
-          typename DexMemberSpec,
-          typename K>
-DexMember* find_renamable_ref(
-    DexMemberRef* ref,
-    std::unordered_map<DexMemberRef*, DexMember*>& ref_def_cache,
-    DexElemManager<DexMember*, DexMemberRef*, DexMemberSpec, K>& name_mapping) {
-  TRACE(OBFUSCATE, 4, "Found a ref opcode");
-  DexMember* def = nullptr;
-  auto member_itr = ref_def_cache.find(ref);
-  if (member_itr != ref_def_cache.end()) {
-    def = member_itr->second;
-  } else {
-    def = name_mapping.def_of_ref(ref);
-  }
-  ref_def_cache[ref] = def;
-  return def;
+bool is_renamable_method_ref_opcode(IROpcode op) {
+  // We only check invoke-direct and invoke-static because the method def
+  // we've renamed is a `dmethod`, not a `vmethod`.
+  //
+  // If we attempted to resolve invoke-virtual refs here, we would
+  // conflate this virtual ref with a direct def that happens to have the
+  // same name but isn't actually inherited.
+  return is_invoke_direct(op) || is_invoke_static(op);
 }
 
+/*
+ * Update any instructions with a member that is a ref to the corresponding
+ * def. This happens in three phases:
+ * 1. gather all distinct refs in parallel,
+ * 2. look up their defs, which only reads the name mappings, and
+ * 3. rewrite all instructions in parallel based on the resulting (now
+ *    read-only) maps.
+ * Each instruction gets rewritten based on its ref alone, so the result is
+ * the same as with a sequential walk.
+ */
 void update_refs(Scope& scope,
                  DexFieldManager& field_name_mapping,
                  DexMethodManager& method_name_mapping) {
-  std::unordered_map<DexFieldRef*, DexField*> f_ref_def_cache;
-  std::unordered_map<DexMethodRef*, DexMethod*> m_ref_def_cache;
-  walk::opcodes(scope, [&](DexMethod*, IRInstruction* instr) {
-    auto op = instr->opcode();
+  ConcurrentSet<DexFieldRef*> field_refs;
+  ConcurrentSet<DexMethodRef*> method_refs;
+  walk::parallel::opcodes(scope, [&](DexMethod*, IRInstruction* instr) {
     if (instr->has_field()) {
       DexFieldRef* field_ref = instr->get_field();
-      if (field_ref->is_def()) return;
-      DexField* field_def =
-          find_renamable_ref(field_ref, f_ref_def_cache, field_name_mapping);
-      if (field_def != nullptr) {
-        TRACE(OBFUSCATE, 4, "Found a ref to fixup %s", SHOW(field_ref));
-        instr->set_field(field_def);
+      if (!field_ref->is_def()) {
+        field_refs.insert(field_ref);
       }
     } else if (instr->has_method() &&
-               (is_invoke_direct(op) || is_invoke_static(op))) {
-      // We only check invoke-direct and invoke-static because the method def
-      // we've renamed is a `dmethod`, not a `vmethod`.
-      //
-      // If we attempted to resolve invoke-virtual refs here, we would
-      // conflate this virtual ref with a direct def that happens to have the
-      // same name but isn't actually inherited.
+               is_renamable_method_ref_opcode(instr->opcode())) {
       DexMethodRef* method_ref = instr->get_method();
-      if (method_ref->is_def()) return;
-      DexMethod* method_def =
-          find_renamable_ref(method_ref, m_ref_def_cache, method_name_mapping);
-      if (method_def != nullptr) {
-        TRACE(OBFUSCATE, 4, "Found a ref to fixup %s", SHOW(method_ref));
-        instr->set_method(method_def);
+      if (!method_ref->is_def()) {
+        method_refs.insert(method_ref);
+      }
+    }
+  });
+
+  std::unordered_map<DexFieldRef*, DexField*> f_ref_def_map;
+  for (auto field_ref : field_refs) {
+    DexField* field_def = field_name_mapping.def_of_ref(field_ref);
+    if (field_def != nullptr) {
+      f_ref_def_map.emplace(field_ref, field_def);
+    }
+  }
+  std::unordered_map<DexMethodRef*, DexMethod*> m_ref_def_map;
+  for (auto method_ref : method_refs) {
+    DexMethod* method_def = method_name_mapping.def_of_ref(method_ref);
+    if (method_def != nullptr) {
+      m_ref_def_map.emplace(method_ref, method_def);
+    }
+  }
+  if (f_ref_def_map.empty() && m_ref_def_map.empty()) {
+    return;
+  }
+
+  walk::parallel::opcodes(scope, [&](DexMethod*, IRInstruction* instr) {
+    if (instr->has_field()) {
+      auto it = f_ref_def_map.find(instr->get_field());
+      if (it != f_ref_def_map.end()) {
+        TRACE(OBFUSCATE, 4, "Found a ref to fixup %s", SHOW(it->first));
+        instr->set_field(it->second);
+      }
+    } else if (instr->has_method() &&
+               is_renamable_method_ref_opcode(instr->opcode())) {
+      auto it = m_ref_def_map.find(instr->get_method());
+      if (it != m_ref_def_map.end()) {
+        TRACE(OBFUSCATE, 4, "Found a ref to fixup %s", SHOW(it->first));
+        instr->set_method(it->second);
       }
     }
   });
@@ -6,6 +6,7 @@
  */
 
 #include "VirtualRenamer.h"
+#include "ConcurrentContainers.h"
 #include "DexAccess.h"
 #include "DexClass.h"
 #include "DexUtil.h"
@@ -14,6 +15,7 @@
 #include "Trace.h"
 #include "VirtualScope.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 #include <map>
 #include <set>
@@ -461,37 +463,58 @@ int VirtualRenamer::rename_virtual_scopes(const DexType* type, int& seed) {
 
 /**
  * Collect all method refs to concrete methods (definitions).
+ * First, the distinct non-concrete refs are gathered in parallel, then each
+ * of them is resolved in parallel. The resulting map doesn't depend on the
+ * order in which refs are visited.
  */
 void collect_refs(Scope& scope, RefsMap& def_refs) {
-  walk::opcodes(
+  ConcurrentSet<DexMethodRef*> refs;
+  walk::parallel::opcodes(
       scope, [](DexMethod*) { return true; },
       [&](DexMethod*, IRInstruction* insn) {
         if (!insn->has_method()) return;
         auto callee = insn->get_method();
         if (callee->is_concrete()) return;
-        auto cls = type_class(callee->get_class());
-        if (cls == nullptr || cls->is_external()) return;
-        DexMethod* top = nullptr;
-        if (is_interface(cls)) {
-          top = resolve_method(callee, MethodSearch::Interface);
-        } else {
-          top = find_top_impl(cls, callee->get_name(), callee->get_proto());
-          if (top == nullptr) {
-            TRACE(OBFUSCATE, 2, "Possible top miranda: %s", SHOW(callee));
-            // see if it's a virtual call to an interface miranda method
-            top = find_top_intf_impl(cls, callee->get_name(),
-                                     callee->get_proto());
-            if (top != nullptr) {
-              TRACE(OBFUSCATE, 2, "Top miranda: %s", SHOW(top));
-            }
-          }
-        }
-        if (top == nullptr || top == callee) return;
-        redex_assert(type_class(top->get_class()) != nullptr);
-        if (type_class(top->get_class())->is_external()) return;
-        // it's a top definition on an internal class, save it
-        def_refs[top].insert(callee);
+        refs.insert(callee);
       });
+
+  ConcurrentMap<DexMethod*, std::set<DexMethodRef*, dexmethods_comparator>>
+      concurrent_def_refs;
+  auto wq = workqueue_foreach<DexMethodRef*>([&](DexMethodRef* callee) {
+    auto cls = type_class(callee->get_class());
+    if (cls == nullptr || cls->is_external()) return;
+    DexMethod* top = nullptr;
+    if (is_interface(cls)) {
+      top = resolve_method(callee, MethodSearch::Interface);
+    } else {
+      top = find_top_impl(cls, callee->get_name(), callee->get_proto());
+      if (top == nullptr) {
+        TRACE(OBFUSCATE, 2, "Possible top miranda: %s", SHOW(callee));
+        // see if it's a virtual call to an interface miranda method
+        top = find_top_intf_impl(cls, callee->get_name(), callee->get_proto());
+        if (top != nullptr) {
+          TRACE(OBFUSCATE, 2, "Top miranda: %s", SHOW(top));
+        }
+      }
+    }
+    if (top == nullptr || top == callee) return;
+    redex_assert(type_class(top->get_class()) != nullptr);
+    if (type_class(top->get_class())->is_external()) return;
+    // it's a top definition on an internal class, save it
+    concurrent_def_refs.update(
+        top,
+        [callee](DexMethod*,
+                 std::set<DexMethodRef*, dexmethods_comparator>& callees,
+                 bool) { callees.insert(callee); });
+  });
+  for (auto callee : refs) {
+    wq.add_item(callee);
+  }
+  wq.run_all();
+
+  for (auto& p : concurrent_def_refs) {
+    def_refs[p.first] = std::move(p.second);
+  }
 }
 
 } // namespace
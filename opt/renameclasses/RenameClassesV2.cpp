@@ -16,6 +16,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
@@ -24,6 +25,7 @@
 #include "TypeStringRewriter.h"
 #include "Walkers.h"
 #include "Warning.h"
+#include "WorkQueue.h"
 
 #include <locator.h>
 using facebook::Locator;
@@ -167,7 +169,8 @@ RenameClassesPassV2::build_dont_rename_for_types_with_reflection(
     }
   }
 
-  walk::opcodes(
+  ConcurrentSet<const DexType*> types_with_reflection_users;
+  walk::parallel::opcodes(
       scope,
       [](DexMethod*) { return true; },
       [&](DexMethod* m, IRInstruction* insn) {
@@ -176,13 +179,15 @@ RenameClassesPassV2::build_dont_rename_for_types_with_reflection(
           if (callee == nullptr || !callee->is_concrete()) return;
           auto callee_method_cls = callee->get_class();
           if (refl_map.count(callee_method_cls) == 0) return;
-          std::string classname = m->get_class()->get_name()->str();
           TRACE(RENAME, 4,
                 "Found %s with known reflection usage. marking reachable",
-                classname.c_str());
-          dont_rename_class_for_types_with_reflection.insert(classname);
+                SHOW(m->get_class()));
+          types_with_reflection_users.insert(m->get_class());
         }
       });
+  for (auto type : types_with_reflection_users) {
+    dont_rename_class_for_types_with_reflection.insert(type->str());
+  }
   return dont_rename_class_for_types_with_reflection;
 }
 
@@ -601,11 +606,18 @@ void RenameClassesPassV2::rename_classes(Scope& scope,
                                          ConfigFiles& conf,
                                          bool rename_annotations,
                                          PassManager& mgr) {
-  rewriter::TypeStringMap name_mapping;
+  // First, decide which classes get renamed, and pick their sequence numbers.
+  // This has to happen in scope order.
+  struct Renaming {
+    DexClass* clazz;
+    uint32_t sequence;
+    DexString* oldname;
+    DexString* newname;
+  };
+  std::vector<Renaming> renamings;
   uint32_t sequence = 0;
   for (auto clazz : scope) {
-    auto dtype = clazz->get_type();
-    auto oldname = dtype->get_name();
+    auto oldname = clazz->get_type()->get_name();
 
     if (m_force_rename_classes.count(clazz)) {
       mgr.incr_metric(METRIC_FORCE_RENAMED_CLASSES, 1);
@@ -630,8 +642,20 @@ void RenameClassesPassV2::rename_classes(Scope& scope,
 
     mgr.incr_metric(METRIC_RENAMED_CLASSES, 1);
 
-    char descriptor[Locator::encoded_global_class_index_max];
     always_assert(sequence != Locator::invalid_global_class_index);
+    renamings.push_back({clazz, sequence, oldname, nullptr});
+    sequence++;
+  }
+
+  // Second, compute and intern the new names, and apply them to the class
+  // types and their array types. Each class is handled independently, so this
+  // can happen in parallel.
+  auto wq = workqueue_foreach<Renaming*>([&](Renaming* renaming) {
+    auto dtype = renaming->clazz->get_type();
+    auto oldname = renaming->oldname;
+    auto sequence = renaming->sequence;
+
+    char descriptor[Locator::encoded_global_class_index_max];
     Locator::encodeGlobalClassIndex(sequence, m_digits, descriptor);
     always_assert_log(facebook::Locator::decodeGlobalClassIndex(descriptor) ==
                           sequence,
@@ -640,12 +664,10 @@ void RenameClassesPassV2::rename_classes(Scope& scope,
                       descriptor, sequence,
                       facebook::Locator::decodeGlobalClassIndex(descriptor));
 
-    sequence++;
-
     std::string prefixed_descriptor = prepend_package_prefix(descriptor);
 
     TRACE(RENAME, 2, "'%s' ->  %s (%u)'", oldname->c_str(),
-          prefixed_descriptor.c_str(), sequence);
+          prefixed_descriptor.c_str(), sequence + 1);
 
     auto dstring = DexString::make_string(prefixed_descriptor);
 
@@ -653,13 +675,8 @@ void RenameClassesPassV2::rename_classes(Scope& scope,
                       "Type name collision detected. %s already exists.",
                       prefixed_descriptor.c_str());
 
-    name_mapping.add_type_name(clazz->get_name(), dstring);
+    renaming->newname = dstring;
     dtype->set_name(dstring);
-    std::string old_str(oldname->c_str());
-    // std::string new_str(descriptor);
-    // proguard_map.update_class_mapping(old_str, new_str);
-    m_base_strings_size += strlen(oldname->c_str());
-    m_ren_strings_size += strlen(dstring->c_str());
 
     while (1) {
       std::string arrayop("[");
@@ -677,6 +694,18 @@ void RenameClassesPassV2::rename_classes(Scope& scope,
       dstring = DexString::make_string(newarraytype);
       arraytype->set_name(dstring);
     }
+  });
+  for (auto& renaming : renamings) {
+    wq.add_item(&renaming);
+  }
+  wq.run_all();
+
+  // Finally, record the mapping in scope order.
+  rewriter::TypeStringMap name_mapping;
+  for (const auto& renaming : renamings) {
+    name_mapping.add_type_name(renaming.oldname, renaming.newname);
+    m_base_strings_size += strlen(renaming.oldname->c_str());
+    m_ren_strings_size += strlen(renaming.newname->c_str());
   }
 
   /* Now rewrite all const-string strings for force renamed classes. */
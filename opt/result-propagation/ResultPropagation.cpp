@@ -12,6 +12,7 @@
 #include "BaseIRAnalyzer.h"
 #include "ConstantAbstractDomain.h"
 #include "ControlFlow.h"
+#include "HierarchyService.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
@@ -490,7 +491,8 @@ void ResultPropagationPass::run_pass(DexStoresVector& stores,
                                      ConfigFiles& /* conf */,
                                      PassManager& mgr) {
   const auto scope = build_class_scope(stores);
-  const auto method_override_graph = method_override_graph::build_graph(scope);
+  const auto method_override_graph =
+      mgr.hierarchy_service().get_method_override_graph(scope);
   ReturnParamResolver resolver(*method_override_graph);
   const auto methods_which_return_parameter =
       find_methods_which_return_parameter(mgr, scope, resolver);
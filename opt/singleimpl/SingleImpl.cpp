@@ -19,6 +19,7 @@
 #include "DexLoader.h"
 #include "DexOutput.h"
 #include "DexUtil.h"
+#include "HierarchyService.h"
 #include "SingleImplDefs.h"
 #include "Trace.h"
 #include "Walkers.h"
@@ -101,7 +102,7 @@ void SingleImplPass::run_pass(DexStoresVector& stores,
                               ConfigFiles& conf,
                               PassManager& mgr) {
   auto scope = build_class_scope(stores);
-  ClassHierarchy ch = build_type_hierarchy(scope);
+  auto ch = mgr.hierarchy_service().get_class_hierarchy(scope);
   int max_steps = 0;
   size_t previous_invoke_intf_count = s_invoke_intf_count;
   OptimizeStats stats;
@@ -121,7 +122,7 @@ void SingleImplPass::run_pass(DexStoresVector& stores,
                                     m_pass_config);
 
     auto optimized_stats =
-        optimize(std::move(single_impls), ch, scope, m_pass_config);
+        optimize(std::move(single_impls), *ch, scope, m_pass_config);
     stats += optimized_stats;
     if (optimized_stats.removed_interfaces == 0 || ++max_steps >= MAX_PASSES) {
       break;
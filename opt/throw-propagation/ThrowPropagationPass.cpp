@@ -38,6 +38,7 @@
 
 #include "ControlFlow.h"
 #include "DexUtil.h"
+#include "HierarchyService.h"
 #include "IRCode.h"
 #include "Purity.h"
 #include "Resolver.h"
@@ -310,7 +311,8 @@ void ThrowPropagationPass::run_pass(DexStoresVector& stores,
       code.build_cfg(/* editable */ true);
     }
   });
-  auto override_graph = method_override_graph::build_graph(scope);
+  auto override_graph =
+      mgr.hierarchy_service().get_method_override_graph(scope);
   size_t last_no_return_methods{0};
   int iterations = 0;
   Stats stats;
@@ -13,6 +13,7 @@
 #include "ConstantAbstractDomain.h"
 #include "ConstantArrayDomain.h"
 #include "ControlFlow.h"
+#include "DenseRegisterEnvironment.h"
 #include "DisjointUnionAbstractDomain.h"
 #include "HashedAbstractPartition.h"
 #include "ObjectDomain.h"
@@ -79,8 +80,7 @@ using ConstantValue =
 using FieldEnvironment =
     sparta::PatriciaTreeMapAbstractEnvironment<const DexField*, ConstantValue>;
 
-using ConstantRegisterEnvironment =
-    sparta::PatriciaTreeMapAbstractEnvironment<reg_t, ConstantValue>;
+using ConstantRegisterEnvironment = DenseRegisterEnvironment<ConstantValue>;
 
 /*****************************************************************************
  * Heap values.
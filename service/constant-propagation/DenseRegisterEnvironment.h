@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "AbstractDomain.h"
+#include "IRInstruction.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+/*
+ * An abstract environment mapping registers to elements of Domain, with the
+ * same semantics as a PatriciaTreeMapAbstractEnvironment<reg_t, Domain>.
+ *
+ * Most methods only use a few dozen registers, so the values of the registers
+ * below kMaxDenseRegisters are kept in a flat array, which makes reads and
+ * writes constant-time operations without any allocation. The array is shared
+ * between copies of the environment and only cloned on the first write to a
+ * shared copy, so that copying environments between blocks stays cheap.
+ * Higher registers, including RESULT_REGISTER, are kept in a Patricia tree.
+ *
+ * As for all abstract domains, side-effecting operations must only be invoked
+ * on thread-local objects.
+ */
+template <typename Domain>
+class DenseRegisterEnvironment final
+    : public sparta::AbstractDomain<DenseRegisterEnvironment<Domain>> {
+ public:
+  static constexpr reg_t kMaxDenseRegisters = 64;
+
+  /*
+   * The default constructor produces the Top value.
+   */
+  DenseRegisterEnvironment() = default;
+
+  DenseRegisterEnvironment(std::initializer_list<std::pair<reg_t, Domain>> l) {
+    for (const auto& p : l) {
+      set(p.first, p.second);
+    }
+  }
+
+  bool is_bottom() const override { return m_sparse.is_bottom(); }
+
+  bool is_top() const override {
+    if (!m_sparse.is_top()) {
+      return false;
+    }
+    return !m_dense ||
+           std::all_of(m_dense->begin(), m_dense->end(),
+                       [](const Domain& value) { return value.is_top(); });
+  }
+
+  bool is_value() const { return !is_bottom() && !is_top(); }
+
+  Domain get(reg_t reg) const {
+    if (is_bottom()) {
+      return Domain::bottom();
+    }
+    if (reg < kMaxDenseRegisters) {
+      return get_dense(reg);
+    }
+    return m_sparse.get(reg);
+  }
+
+  DenseRegisterEnvironment& set(reg_t reg, const Domain& value) {
+    if (is_bottom()) {
+      return *this;
+    }
+    if (value.is_bottom()) {
+      set_to_bottom();
+      return *this;
+    }
+    if (reg >= kMaxDenseRegisters) {
+      m_sparse.set(reg, value);
+      return *this;
+    }
+    if (value.is_top() && (!m_dense || reg >= m_dense->size())) {
+      // Unbound registers are implicitly Top.
+      return *this;
+    }
+    mutable_dense(reg + 1)[reg] = value;
+    return *this;
+  }
+
+  DenseRegisterEnvironment& update(
+      reg_t reg, const std::function<Domain(const Domain&)>& operation) {
+    return set(reg, operation(get(reg)));
+  }
+
+  bool leq(const DenseRegisterEnvironment& other) const override {
+    if (is_bottom()) {
+      return true;
+    }
+    if (other.is_bottom()) {
+      return false;
+    }
+    if (!m_sparse.leq(other.m_sparse)) {
+      return false;
+    }
+    if (m_dense == other.m_dense) {
+      return true;
+    }
+    for (reg_t reg = 0; reg < other.dense_size(); reg++) {
+      if (!get_dense(reg).leq(other.get_dense(reg))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool equals(const DenseRegisterEnvironment& other) const override {
+    if (is_bottom() || other.is_bottom()) {
+      return is_bottom() == other.is_bottom();
+    }
+    if (!m_sparse.equals(other.m_sparse)) {
+      return false;
+    }
+    if (m_dense == other.m_dense) {
+      return true;
+    }
+    auto size = std::max(dense_size(), other.dense_size());
+    for (reg_t reg = 0; reg < size; reg++) {
+      if (!get_dense(reg).equals(other.get_dense(reg))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void set_to_bottom() override {
+    m_dense.reset();
+    m_sparse.set_to_bottom();
+  }
+
+  void set_to_top() override {
+    m_dense.reset();
+    m_sparse.set_to_top();
+  }
+
+  void join_with(const DenseRegisterEnvironment& other) override {
+    join_like_with(other, [](auto* self, const auto& value) {
+      self->join_with(value);
+    });
+  }
+
+  void widen_with(const DenseRegisterEnvironment& other) override {
+    join_like_with(other, [](auto* self, const auto& value) {
+      self->widen_with(value);
+    });
+  }
+
+  void meet_with(const DenseRegisterEnvironment& other) override {
+    meet_like_with(other, [](auto* self, const auto& value) {
+      self->meet_with(value);
+    });
+  }
+
+  void narrow_with(const DenseRegisterEnvironment& other) override {
+    meet_like_with(other, [](auto* self, const auto& value) {
+      self->narrow_with(value);
+    });
+  }
+
+  friend std::ostream& operator<<(std::ostream& o,
+                                  const DenseRegisterEnvironment& env) {
+    if (env.is_bottom()) {
+      return o << "_|_";
+    }
+    if (env.is_top()) {
+      return o << "T";
+    }
+    o << "{";
+    bool first = true;
+    for (reg_t reg = 0; reg < env.dense_size(); reg++) {
+      const auto& value = (*env.m_dense)[reg];
+      if (value.is_top()) {
+        continue;
+      }
+      o << (first ? "" : ", ") << reg << " -> " << value;
+      first = false;
+    }
+    if (env.m_sparse.is_value()) {
+      for (const auto& p : env.m_sparse.bindings()) {
+        o << (first ? "" : ", ") << p.first << " -> " << p.second;
+        first = false;
+      }
+    }
+    return o << "}";
+  }
+
+ private:
+  reg_t dense_size() const { return m_dense ? m_dense->size() : 0; }
+
+  const Domain& get_dense(reg_t reg) const {
+    static const Domain top = Domain::top();
+    return reg < dense_size() ? (*m_dense)[reg] : top;
+  }
+
+  // Returns the array of values with at least min_size elements, first
+  // cloning it if it is shared with another environment.
+  std::vector<Domain>& mutable_dense(reg_t min_size) {
+    if (!m_dense) {
+      m_dense = std::make_shared<std::vector<Domain>>(min_size, Domain::top());
+    } else if (m_dense.use_count() > 1) {
+      m_dense = std::make_shared<std::vector<Domain>>(*m_dense);
+    }
+    if (m_dense->size() < min_size) {
+      m_dense->resize(min_size, Domain::top());
+    }
+    return *m_dense;
+  }
+
+  // Join and widening keep only the registers bound in both environments.
+  template <typename Operation>
+  void join_like_with(const DenseRegisterEnvironment& other,
+                      Operation operation) {
+    if (is_bottom()) {
+      *this = other;
+      return;
+    }
+    if (other.is_bottom()) {
+      return;
+    }
+    operation(&m_sparse, other.m_sparse);
+    if (m_dense == other.m_dense || !m_dense) {
+      return;
+    }
+    if (!other.m_dense) {
+      m_dense.reset();
+      return;
+    }
+    auto size = std::min(dense_size(), other.dense_size());
+    if (dense_size() > size) {
+      auto& dense = mutable_dense(0);
+      dense.erase(dense.begin() + size, dense.end());
+    }
+    for (reg_t reg = 0; reg < size; reg++) {
+      Domain value = (*m_dense)[reg];
+      operation(&value, (*other.m_dense)[reg]);
+      if (!value.equals((*m_dense)[reg])) {
+        mutable_dense(0)[reg] = std::move(value);
+      }
+    }
+  }
+
+  // Meet and narrowing keep the registers bound in either environment.
+  template <typename Operation>
+  void meet_like_with(const DenseRegisterEnvironment& other,
+                      Operation operation) {
+    if (is_bottom()) {
+      return;
+    }
+    if (other.is_bottom()) {
+      set_to_bottom();
+      return;
+    }
+    operation(&m_sparse, other.m_sparse);
+    if (m_sparse.is_bottom()) {
+      set_to_bottom();
+      return;
+    }
+    if (m_dense == other.m_dense || !other.m_dense) {
+      return;
+    }
+    for (reg_t reg = 0; reg < other.dense_size(); reg++) {
+      Domain value = get_dense(reg);
+      operation(&value, (*other.m_dense)[reg]);
+      if (value.is_bottom()) {
+        set_to_bottom();
+        return;
+      }
+      if (!value.equals(get_dense(reg))) {
+        mutable_dense(reg + 1)[reg] = std::move(value);
+      }
+    }
+  }
+
+  std::shared_ptr<std::vector<Domain>> m_dense;
+  sparta::PatriciaTreeMapAbstractEnvironment<reg_t, Domain> m_sparse;
+};
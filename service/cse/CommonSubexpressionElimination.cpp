@@ -51,6 +51,8 @@
 
 #include "CommonSubexpressionElimination.h"
 
+#include <boost/container/small_vector.hpp>
+#include <limits>
 #include <utility>
 
 #include "BaseIRAnalyzer.h"
@@ -103,6 +105,9 @@ enum ValueIdFlags : value_id_t {
   // upper bits for unique running index
   BASE = ((value_id_t)1) << (TRACKED_LOCATION_BITS + 2),
 };
+static_assert(std::numeric_limits<value_id_t>::max() / ValueIdFlags::BASE ==
+                  MAX_VALUE_IDS - 1,
+              "MAX_VALUE_IDS must match the running index bits");
 
 using namespace ir_analyzer;
 
@@ -115,7 +120,8 @@ const IROpcode IOPCODE_POSITIONAL = IROpcode(0xFFFE);
 
 struct IRValue {
   IROpcode opcode;
-  std::vector<value_id_t> srcs;
+  // Most values have few srcs; keep those inline to avoid allocations.
+  boost::container::small_vector<value_id_t, 4> srcs;
   union {
     // Zero-initialize this union with the uint64_t member instead of a
     // pointer-type member so that it works properly even on 32-bit machines
@@ -150,6 +156,94 @@ bool operator==(const IRValue& a, const IRValue& b) {
   return a.opcode == b.opcode && a.srcs == b.srcs && a.literal == b.literal;
 }
 
+/*
+ * Maps values to value ids.
+ *
+ * This is an open-addressing hash table with linear probing. The srcs of all
+ * values are stored back-to-back in a single arena, so that adding a value
+ * doesn't allocate except when the table grows. A table lives as long as the
+ * analysis of a method, across all fixpoint iterations.
+ */
+class ValueIdTable {
+ public:
+  size_t size() const { return m_entries.size(); }
+
+  const value_id_t* find(const IRValue& value, size_t hash) const {
+    if (m_slots.empty()) {
+      return nullptr;
+    }
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = hash & mask; m_slots[i] != 0; i = (i + 1) & mask) {
+      const auto& entry = m_entries[m_slots[i] - 1];
+      if (entry.hash == hash && matches(entry, value)) {
+        return &entry.id;
+      }
+    }
+    return nullptr;
+  }
+
+  // The value must not be in the table yet.
+  void insert(const IRValue& value, size_t hash, value_id_t id) {
+    if ((m_entries.size() + 1) * 2 > m_slots.size()) {
+      grow();
+    }
+    m_entries.push_back({hash, value.opcode, (uint32_t)m_srcs.size(),
+                         (uint32_t)value.srcs.size(), value.literal, id});
+    m_srcs.insert(m_srcs.end(), value.srcs.begin(), value.srcs.end());
+    place(m_entries.size() - 1);
+  }
+
+  // Mixes the bits of an IRValueHasher result, as value ids have all their
+  // low bits clear unless they depend on tracked locations.
+  static size_t hash(const IRValue& value) {
+    uint64_t h = IRValueHasher()(value);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+ private:
+  struct Entry {
+    size_t hash;
+    IROpcode opcode;
+    uint32_t srcs_begin;
+    uint32_t srcs_size;
+    uint64_t literal;
+    value_id_t id;
+  };
+
+  bool matches(const Entry& entry, const IRValue& value) const {
+    return entry.opcode == value.opcode && entry.literal == value.literal &&
+           entry.srcs_size == value.srcs.size() &&
+           std::equal(value.srcs.begin(), value.srcs.end(),
+                      m_srcs.begin() + entry.srcs_begin);
+  }
+
+  void place(size_t entry_index) {
+    size_t mask = m_slots.size() - 1;
+    size_t i = m_entries[entry_index].hash & mask;
+    while (m_slots[i] != 0) {
+      i = (i + 1) & mask;
+    }
+    m_slots[i] = entry_index + 1;
+  }
+
+  void grow() {
+    m_slots.assign(std::max<size_t>(16, m_slots.size() * 2), 0);
+    for (size_t i = 0; i < m_entries.size(); i++) {
+      place(i);
+    }
+  }
+
+  std::vector<Entry> m_entries;
+  std::vector<value_id_t> m_srcs;
+  // Indices into m_entries plus one; zero marks an empty slot.
+  std::vector<uint32_t> m_slots;
+};
+
 using IRInstructionsDomain =
     sparta::PatriciaTreeSetAbstractDomain<const IRInstruction*>;
 using ValueIdDomain = sparta::ConstantAbstractDomain<value_id_t>;
@@ -253,13 +347,16 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
            cfg::ControlFlowGraph& cfg,
            bool is_method_static,
            bool is_method_init_or_clinit,
-           DexType* declaring_type)
+           DexType* declaring_type,
+           size_t max_value_ids)
       : BaseIRAnalyzer(cfg), m_shared_state(shared_state) {
     // Collect all read locations
     std::unordered_map<CseLocation, size_t, CseLocationHasher>
         read_location_counts;
+    size_t num_srcs = 0;
     for (const auto& mie : cfg::InstructionIterable(cfg)) {
       auto insn = mie.insn;
+      num_srcs += insn->srcs_size();
       auto location = get_read_location(insn);
       if (location !=
           CseLocation(CseSpecialLocations::GENERAL_MEMORY_BARRIER)) {
@@ -392,6 +489,12 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
       }
     }
 
+    // There is at most one pre-state-source value per instruction source,
+    // and those always need a value id; everything else is subject to the
+    // budget.
+    m_value_ids_budget = std::min(
+        max_value_ids, MAX_VALUE_IDS - std::min(num_srcs, MAX_VALUE_IDS));
+
     MonotonicFixpointIterator::run(CseEnvironment::top());
   }
 
@@ -503,7 +606,11 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
   void install_forwarding(const IRInstruction* insn,
                           const IRValue& value,
                           CseEnvironment* current_state) const {
-    auto value_id = *get_value_id(value);
+    auto opt_value_id = get_value_id(value);
+    if (!opt_value_id) {
+      return;
+    }
+    auto value_id = *opt_value_id;
     current_state->mutate_def_env([value_id, insn](DefEnvironment* env) {
       env->set(value_id, IRInstructionsDomain(insn));
     });
@@ -515,6 +622,8 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
 
   size_t get_value_ids_size() { return m_value_ids.size(); }
 
+  bool value_ids_budget_exceeded() { return m_value_ids_budget_exceeded; }
+
   bool using_other_tracked_location_bit() {
     return m_using_other_tracked_location_bit;
   }
@@ -551,9 +660,17 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
   }
 
   boost::optional<value_id_t> get_value_id(const IRValue& value) const {
-    auto it = m_value_ids.find(value);
-    if (it != m_value_ids.end()) {
-      return boost::optional<value_id_t>(it->second);
+    auto hash = ValueIdTable::hash(value);
+    auto existing_id = m_value_ids.find(value, hash);
+    if (existing_id != nullptr) {
+      return boost::optional<value_id_t>(*existing_id);
+    }
+    if (value.opcode != IOPCODE_PRE_STATE_SRC &&
+        m_value_ids.size() >= m_value_ids_budget) {
+      // Out of budget: treat the value as unknown. This only loses
+      // optimization opportunities, and bounds the cost of the analysis.
+      m_value_ids_budget_exceeded = true;
+      return boost::none;
     }
     value_id_t id = m_value_ids.size() * ValueIdFlags::BASE;
     always_assert(id / ValueIdFlags::BASE == m_value_ids.size());
@@ -574,7 +691,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
         id |= (src & ValueIdFlags::IS_TRACKED_LOCATION_MASK);
       }
     }
-    m_value_ids.emplace(value, id);
+    m_value_ids.insert(value, hash, id);
     if (value.opcode == IOPCODE_POSITIONAL) {
       m_positional_insns.emplace(id, value.positional_insn);
     } else if (value.opcode == IOPCODE_PRE_STATE_SRC) {
@@ -765,7 +882,9 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
   std::unordered_map<CseLocation, value_id_t, CseLocationHasher>
       m_tracked_locations;
   SharedState* m_shared_state;
-  mutable std::unordered_map<IRValue, value_id_t, IRValueHasher> m_value_ids;
+  size_t m_value_ids_budget;
+  mutable bool m_value_ids_budget_exceeded{false};
+  mutable ValueIdTable m_value_ids;
   mutable std::unordered_set<value_id_t> m_pre_state_value_ids;
   mutable std::unordered_map<value_id_t, const IRInstruction*>
       m_positional_insns;
@@ -1198,15 +1317,19 @@ CommonSubexpressionElimination::CommonSubexpressionElimination(
     bool is_static,
     bool is_init_or_clinit,
     DexType* declaring_type,
-    DexTypeList* args)
+    DexTypeList* args,
+    size_t max_value_ids)
     : m_shared_state(shared_state),
       m_cfg(cfg),
       m_is_static(is_static),
       m_declaring_type(declaring_type),
       m_args(args) {
   Analyzer analyzer(shared_state, cfg, is_static, is_init_or_clinit,
-                    declaring_type);
+                    declaring_type, max_value_ids);
   m_stats.max_value_ids = analyzer.get_value_ids_size();
+  if (analyzer.value_ids_budget_exceeded()) {
+    m_stats.methods_exceeding_value_ids_budget = 1;
+  }
   if (analyzer.using_other_tracked_location_bit()) {
     m_stats.methods_using_other_tracked_location_bit = 1;
   }
@@ -1573,6 +1696,8 @@ Stats& Stats::operator+=(const Stats& that) {
   max_value_ids = std::max(max_value_ids, that.max_value_ids);
   methods_using_other_tracked_location_bit +=
       that.methods_using_other_tracked_location_bit;
+  methods_exceeding_value_ids_budget +=
+      that.methods_exceeding_value_ids_budget;
   for (const auto& p : that.eliminated_opcodes) {
     eliminated_opcodes[p.first] += p.second;
   }
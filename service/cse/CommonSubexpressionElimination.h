@@ -14,6 +14,9 @@
 
 namespace cse_impl {
 
+// Upper limit of value ids per method, imposed by their encoding.
+constexpr size_t MAX_VALUE_IDS = 1 << 20;
+
 struct Stats {
   size_t results_captured{0};
   size_t stores_captured{0};
@@ -21,6 +24,7 @@ struct Stats {
   size_t instructions_eliminated{0};
   size_t max_value_ids{0};
   size_t methods_using_other_tracked_location_bit{0};
+  size_t methods_exceeding_value_ids_budget{0};
   // keys are IROpcode encoded as uint16_t, to make OSS build happy
   std::unordered_map<uint16_t, size_t> eliminated_opcodes;
   size_t max_iterations{0};
@@ -98,12 +102,16 @@ class SharedState {
 
 class CommonSubexpressionElimination {
  public:
+  // Once the analysis has created max_value_ids value ids, any further values
+  // are treated as unknown, which bounds the cost of huge methods at the
+  // expense of some missed opportunities.
   CommonSubexpressionElimination(SharedState* shared_state,
                                  cfg::ControlFlowGraph&,
                                  bool is_static,
                                  bool is_init_or_clinit,
                                  DexType* declaring_type,
-                                 DexTypeList* args);
+                                 DexTypeList* args,
+                                 size_t max_value_ids = MAX_VALUE_IDS);
 
   const Stats& get_stats() const { return m_stats; }
 
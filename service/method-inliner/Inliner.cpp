@@ -99,6 +99,9 @@ MultiMethodInliner::MultiMethodInliner(
       m_same_method_implementations(same_method_implementations),
       m_pure_methods(get_pure_methods()),
       m_analyze_and_prune_inits(analyze_and_prune_inits) {
+  if (config.use_summary_cache) {
+    m_summary_cache = &inliner::SummaryCache::get();
+  }
   for (const auto& callee_callers : true_virtual_callers) {
     for (const auto& caller_insns : callee_callers.second) {
       for (auto insn : caller_insns.second) {
@@ -260,7 +263,7 @@ void MultiMethodInliner::compute_callee_constant_arguments() {
           return;
         }
         for (auto& p : res->invoke_constant_arguments) {
-          auto insn = p.first->insn;
+          auto insn = p.first;
           auto callee = resolver(insn->get_method(), opcode_to_search(insn));
           const auto& constant_arguments = p.second;
           auto key = get_key(constant_arguments);
@@ -297,6 +300,7 @@ void MultiMethodInliner::inline_methods() {
   // in parallel.
   m_async_method_executor.set_num_threads(
       m_config.debug ? 1 : redex_parallel::default_num_threads());
+  auto async_start = std::chrono::system_clock::now();
 
   // The order in which we inline is such that once a callee is considered to
   // be inlined, it's code will no longer change. So we can cache...
@@ -409,8 +413,23 @@ void MultiMethodInliner::inline_methods() {
   }
 
   m_async_method_executor.join();
+  auto async_end = std::chrono::system_clock::now();
   delayed_change_visibilities();
   info.waited_seconds = m_async_method_executor.get_waited_seconds();
+
+  // Time during which worker threads had nothing to do, e.g. because all
+  // remaining callers were waiting for callees on the critical path.
+  long available_seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(async_end - async_start)
+          .count() *
+      m_async_method_executor.get_num_threads();
+  long busy_seconds = m_async_method_executor.get_busy_seconds();
+  info.idle_worker_seconds =
+      available_seconds > busy_seconds ? available_seconds - busy_seconds : 0;
+  info.shrinking_waited_milliseconds =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          m_shrinking_waited_time)
+          .count();
 }
 
 size_t MultiMethodInliner::compute_caller_nonrecursive_callees_by_stack_depth(
@@ -488,16 +507,15 @@ void MultiMethodInliner::caller_inline(
   }
 }
 
-boost::optional<InvokeConstantArgumentsAndDeadBlocks>
-MultiMethodInliner::get_invoke_constant_arguments(
-    DexMethod* caller, const std::vector<DexMethod*>& callees) {
+/*
+ * Compute the constant arguments of all (reachable) invoke instructions. This
+ * only depends on the caller's code, so that it can be cached across inliner
+ * invocations.
+ */
+static std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks>
+get_all_invoke_constant_arguments(DexMethod* caller) {
   IRCode* code = caller->get_code();
-  if (!code->editable_cfg_built()) {
-    return boost::none;
-  }
-
-  InvokeConstantArgumentsAndDeadBlocks res;
-  std::unordered_set<DexMethod*> callees_set(callees.begin(), callees.end());
+  auto res = std::make_shared<InvokeConstantArgumentsAndDeadBlocks>();
   auto& cfg = code->cfg();
   constant_propagation::intraprocedural::FixpointIterator intra_cp(
       cfg, constant_propagation::ConstantPrimitiveAnalyzer());
@@ -507,7 +525,7 @@ MultiMethodInliner::get_invoke_constant_arguments(
   for (const auto& block : cfg.blocks()) {
     auto env = intra_cp.get_entry_state_at(block);
     if (env.is_bottom()) {
-      res.dead_blocks++;
+      res->dead_blocks++;
       // we found an unreachable block; ignore invoke instructions in it
       continue;
     }
@@ -515,18 +533,16 @@ MultiMethodInliner::get_invoke_constant_arguments(
     for (auto& mie : InstructionIterable(block)) {
       auto insn = mie.insn;
       if (is_invoke(insn->opcode())) {
-        auto callee = resolver(insn->get_method(), opcode_to_search(insn));
-        if (callees_set.count(callee)) {
-          ConstantArguments constant_arguments;
-          const auto& srcs = insn->srcs();
-          for (size_t i = is_static(callee) ? 0 : 1; i < srcs.size(); ++i) {
-            auto val = env.get(srcs[i]);
-            always_assert(!val.is_bottom());
-            constant_arguments.set(i, val);
-          }
-          res.invoke_constant_arguments.emplace_back(code->iterator_to(mie),
-                                                     constant_arguments);
+        // Whether the first argument is the receiver depends on the resolved
+        // callee; we record all arguments here, and drop the receiver later.
+        ConstantArguments constant_arguments;
+        const auto& srcs = insn->srcs();
+        for (size_t i = 0; i < srcs.size(); ++i) {
+          auto val = env.get(srcs[i]);
+          always_assert(!val.is_bottom());
+          constant_arguments.set(i, val);
         }
+        res->invoke_constant_arguments.emplace_back(insn, constant_arguments);
       }
       intra_cp.analyze_instruction(insn, &env, insn == last_insn->insn);
       if (env.is_bottom()) {
@@ -535,6 +551,44 @@ MultiMethodInliner::get_invoke_constant_arguments(
       }
     }
   }
+  return res;
+}
+
+boost::optional<InvokeConstantArgumentsAndDeadBlocks>
+MultiMethodInliner::get_invoke_constant_arguments(
+    DexMethod* caller, const std::vector<DexMethod*>& callees) {
+  IRCode* code = caller->get_code();
+  if (!code->editable_cfg_built()) {
+    return boost::none;
+  }
+
+  std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks> all;
+  size_t version{0};
+  if (m_summary_cache) {
+    version = inliner::SummaryCache::get_code_version(caller);
+    all = m_summary_cache->get_caller_summary(caller, version);
+  }
+  if (!all) {
+    all = get_all_invoke_constant_arguments(caller);
+    if (m_summary_cache) {
+      m_summary_cache->set_caller_summary(caller, version, all);
+    }
+  }
+
+  InvokeConstantArgumentsAndDeadBlocks res;
+  res.dead_blocks = all->dead_blocks;
+  std::unordered_set<DexMethod*> callees_set(callees.begin(), callees.end());
+  for (auto& p : all->invoke_constant_arguments) {
+    auto insn = p.first;
+    auto callee = resolver(insn->get_method(), opcode_to_search(insn));
+    if (callees_set.count(callee)) {
+      auto constant_arguments = p.second;
+      if (!is_static(callee)) {
+        constant_arguments.set(0, ConstantValue::top());
+      }
+      res.invoke_constant_arguments.emplace_back(insn, constant_arguments);
+    }
+  }
 
   return res;
 }
@@ -784,7 +838,55 @@ void MultiMethodInliner::async_postprocess_method(DexMethod* method) {
       method, [method, this]() { postprocess_method(method); });
 }
 
+void MultiMethodInliner::acquire_shrinking_slot(DexMethod* method) {
+  std::unique_lock<std::mutex> lock(m_shrinking_slots_mutex);
+  auto max_live = m_config.max_concurrent_shrinking;
+  if (max_live == 0 ||
+      (m_live_shrinking < max_live && m_waiting_shrinking_priorities.empty())) {
+    info.peak_live_shrinking =
+        std::max(info.peak_live_shrinking, ++m_live_shrinking);
+    return;
+  }
+
+  // Callees whose shrinking got delayed are no longer on the critical path.
+  int priority = std::numeric_limits<int>::min();
+  if (!m_async_delayed_shrinking_callee_wait_counts.count(method)) {
+    auto it = m_async_callee_priorities.find(method);
+    if (it != m_async_callee_priorities.end()) {
+      priority = it->second;
+    }
+  }
+
+  auto start = std::chrono::system_clock::now();
+  auto waiting_it = m_waiting_shrinking_priorities.insert(priority);
+  m_shrinking_slots_condition.wait(lock, [&]() {
+    return m_live_shrinking < max_live &&
+           *m_waiting_shrinking_priorities.rbegin() == priority;
+  });
+  m_waiting_shrinking_priorities.erase(waiting_it);
+  info.peak_live_shrinking =
+      std::max(info.peak_live_shrinking, ++m_live_shrinking);
+  m_shrinking_waited_time += std::chrono::system_clock::now() - start;
+  if (m_live_shrinking < max_live && !m_waiting_shrinking_priorities.empty()) {
+    // There may be more room for the next highest priority waiter.
+    m_shrinking_slots_condition.notify_all();
+  }
+}
+
+void MultiMethodInliner::release_shrinking_slot() {
+  {
+    std::lock_guard<std::mutex> lock(m_shrinking_slots_mutex);
+    always_assert(m_live_shrinking > 0);
+    m_live_shrinking--;
+  }
+  if (m_config.max_concurrent_shrinking > 0) {
+    m_shrinking_slots_condition.notify_all();
+  }
+}
+
 void MultiMethodInliner::shrink_method(DexMethod* method) {
+  acquire_shrinking_slot(method);
+
   auto code = method->get_code();
   bool editable_cfg_built = code->editable_cfg_built();
 
@@ -867,6 +969,8 @@ void MultiMethodInliner::shrink_method(DexMethod* method) {
     code->clear_cfg();
   }
 
+  release_shrinking_slot();
+
   std::lock_guard<std::mutex> guard(m_stats_mutex);
   m_const_prop_stats += const_prop_stats;
   m_cse_stats += cse_stats;
@@ -1273,11 +1377,6 @@ static size_t get_inlined_cost(const std::vector<cfg::Block*>& blocks,
   return 0;
 }
 
-struct InlinedCostAndDeadBlocks {
-  size_t cost;
-  size_t dead_blocks;
-};
-
 /*
  * Try to estimate number of code units (2 bytes each) of code. Also take
  * into account costs arising from control-flow overhead and constant
@@ -1360,10 +1459,34 @@ size_t MultiMethodInliner::get_inlined_cost(const DexMethod* callee) {
     return *opt_inlined_cost;
   }
 
+  // The summary cache only applies to code in editable cfg form, in which
+  // the more expensive constant-arguments specific costs get computed.
+  boost::optional<size_t> version;
+  if (m_summary_cache && callee->get_code()->editable_cfg_built()) {
+    version = inliner::SummaryCache::get_code_version(callee);
+  }
+  auto get_cost = [&](const ConstantArguments* constant_arguments) {
+    boost::optional<std::string> key;
+    if (constant_arguments) {
+      key = get_key(*constant_arguments);
+    }
+    if (version) {
+      auto cached = m_summary_cache->get_callee_cost(callee, *version, key);
+      if (cached) {
+        return *cached;
+      }
+    }
+    auto res = ::get_inlined_cost(is_static(callee), callee->get_code(),
+                                  constant_arguments);
+    if (version) {
+      m_summary_cache->set_callee_cost(callee, *version, key, res);
+    }
+    return res;
+  };
+
   std::atomic<size_t> callees_analyzed{0};
   std::atomic<size_t> callees_unreachable_blocks{0};
-  std::atomic<size_t> inlined_cost{
-      ::get_inlined_cost(is_static(callee), callee->get_code()).cost};
+  std::atomic<size_t> inlined_cost{get_cost(nullptr).cost};
   ConcurrentMap<std::string, size_t> inlined_costs_keyed;
   auto callee_constant_arguments_it = m_callee_constant_arguments.find(callee);
   if (callee_constant_arguments_it != m_callee_constant_arguments.end() &&
@@ -1374,8 +1497,7 @@ size_t MultiMethodInliner::get_inlined_cost(const DexMethod* callee) {
       const auto& constant_arguments = cao.first;
       const auto count = cao.second;
       TRACE(INLINE, 5, "[too_many_callers] get_inlined_cost %s", SHOW(callee));
-      auto res = ::get_inlined_cost(is_static(callee), callee->get_code(),
-                                    &constant_arguments);
+      auto res = get_cost(&constant_arguments);
       TRACE(INLINE, 4,
             "[too_many_callers] get_inlined_cost with %zu constant invoke "
             "params %s @ %s: cost %zu (dead blocks: %zu)",
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <map>
 #include <set>
@@ -23,6 +25,7 @@
 #include "IPConstantPropagationAnalysis.h"
 #include "IRCode.h"
 #include "InlineForSpeed.h"
+#include "InlinerSummaryCache.h"
 #include "LocalDce.h"
 #include "MethodProfiles.h"
 #include "PatriciaTreeSet.h"
@@ -94,16 +97,6 @@ using CalleeCallerInsns = std::unordered_map<
     DexMethod*,
     std::unordered_map<DexMethod*, std::unordered_set<IRInstruction*>>>;
 
-using ConstantArguments = constant_propagation::interprocedural::ArgumentDomain;
-
-using InvokeConstantArguments =
-    std::vector<std::pair<IRList::iterator, ConstantArguments>>;
-
-struct InvokeConstantArgumentsAndDeadBlocks {
-  InvokeConstantArguments invoke_constant_arguments;
-  size_t dead_blocks{0};
-};
-
 using ConstantArgumentsOccurrences = std::pair<ConstantArguments, size_t>;
 
 struct Inlinable {
@@ -415,6 +408,18 @@ class MultiMethodInliner {
    */
   void shrink_method(DexMethod* method);
 
+  /**
+   * When the number of concurrently shrunk methods is bounded, wait until a
+   * shrinking slot becomes available. Waiting methods are admitted in order of
+   * their priority, so that methods on the critical path get to go first.
+   */
+  void acquire_shrinking_slot(DexMethod* method);
+
+  /**
+   * Give up a shrinking slot acquired via acquire_shrinking_slot.
+   */
+  void release_shrinking_slot();
+
   /**
    * For callers waiting for callees to become ready, decrement their wait
    * counter, and if zero, initiate inlining and postprocessing.
@@ -532,6 +537,15 @@ class MultiMethodInliner {
   ConcurrentMap<const DexMethod*, size_t>
       m_async_delayed_shrinking_callee_wait_counts;
 
+  // For bounded shrinking, guards the following shrinking slot bookkeeping.
+  std::mutex m_shrinking_slots_mutex;
+  std::condition_variable m_shrinking_slots_condition;
+  // Number of methods currently being shrunk.
+  size_t m_live_shrinking{0};
+  // Priorities of all methods currently waiting for a shrinking slot.
+  std::multiset<int> m_waiting_shrinking_priorities;
+  std::chrono::duration<double> m_shrinking_waited_time{0};
+
   // Whether any of const-prop/cs/copy-prop/local-dce are enabled.
   bool m_shrinking_enabled{0};
 
@@ -564,6 +578,9 @@ class MultiMethodInliner {
   // Optional cache for get_callee_method_refs function
   std::unique_ptr<ConcurrentMap<const DexMethod*, size_t>> m_callee_method_refs;
 
+  // Summaries shared with other inliner invocations, if enabled.
+  inliner::SummaryCache* m_summary_cache{nullptr};
+
   // Cache of whether a constructor can be unconditionally inlined.
   mutable ConcurrentMap<const DexMethod*, boost::optional<bool>>
       m_can_inline_init;
@@ -588,6 +605,9 @@ class MultiMethodInliner {
     size_t max_call_stack_depth{0};
     size_t waited_seconds{0};
     int critical_path_length{0};
+    size_t idle_worker_seconds{0};
+    size_t peak_live_shrinking{0};
+    size_t shrinking_waited_milliseconds{0};
 
     // statistics that may be incremented concurrently
     std::atomic<size_t> calls_inlined{0};
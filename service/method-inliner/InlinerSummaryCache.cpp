@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "InlinerSummaryCache.h"
+
+#include <boost/functional/hash.hpp>
+
+#include "ControlFlow.h"
+#include "IRCode.h"
+#include "RedexContext.h"
+
+namespace inliner {
+
+namespace {
+
+std::unique_ptr<SummaryCache> summary_cache_singleton;
+
+} // namespace
+
+SummaryCache& SummaryCache::get() {
+  if (!summary_cache_singleton) {
+    // Be careful, there could be a data race here if this is called in parallel
+    summary_cache_singleton = std::make_unique<SummaryCache>();
+    // In tests, we create and destroy g_redex repeatedly. So we need to reset
+    // the singleton.
+    g_redex->add_destruction_task([]() { summary_cache_singleton.reset(); });
+  }
+  return *summary_cache_singleton;
+}
+
+size_t SummaryCache::get_code_version(const DexMethod* method) {
+  auto code = method->get_code();
+  always_assert(code->editable_cfg_built());
+  size_t seed = is_static(method);
+  // We include the identities of instructions, as callers summaries refer to
+  // them, and blocks are visited in the same order as the cost estimation
+  // does, which considers fallthrough edges.
+  for (auto block : code->cfg().blocks()) {
+    boost::hash_combine(seed, block->id());
+    for (auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      boost::hash_combine(seed, insn);
+      boost::hash_combine(seed, insn->opcode());
+      for (auto src : insn->srcs()) {
+        boost::hash_combine(seed, src);
+      }
+      if (insn->has_dest()) {
+        boost::hash_combine(seed, insn->dest());
+      }
+      boost::hash_combine(seed, insn->hash());
+    }
+    for (auto edge : block->succs()) {
+      boost::hash_combine(seed, edge->target()->id());
+      boost::hash_combine(seed, edge->type());
+      if (edge->type() == cfg::EDGE_THROW) {
+        boost::hash_combine(seed, edge->throw_info()->catch_type);
+        boost::hash_combine(seed, edge->throw_info()->index);
+      } else if (edge->case_key()) {
+        boost::hash_combine(seed, *edge->case_key());
+      }
+    }
+  }
+  return seed;
+}
+
+std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks>
+SummaryCache::get_caller_summary(const DexMethod* caller, size_t version) {
+  std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks> res;
+  m_callers.update(caller,
+                   [&](const DexMethod*, CallerEntry& entry, bool exists) {
+                     if (exists && entry.version == version) {
+                       res = entry.summary;
+                     }
+                   });
+  if (res) {
+    m_hits++;
+  } else {
+    m_misses++;
+  }
+  return res;
+}
+
+void SummaryCache::set_caller_summary(
+    const DexMethod* caller,
+    size_t version,
+    std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks> summary) {
+  m_callers.update(caller, [&](const DexMethod*, CallerEntry& entry, bool) {
+    entry.version = version;
+    entry.summary = std::move(summary);
+  });
+}
+
+boost::optional<InlinedCostAndDeadBlocks> SummaryCache::get_callee_cost(
+    const DexMethod* callee,
+    size_t version,
+    const boost::optional<std::string>& key) {
+  boost::optional<InlinedCostAndDeadBlocks> res;
+  m_callees.update(callee,
+                   [&](const DexMethod*, CalleeEntry& entry, bool exists) {
+                     if (!exists || entry.version != version) {
+                       return;
+                     }
+                     if (!key) {
+                       res = entry.cost;
+                       return;
+                     }
+                     auto it = entry.keyed_costs.find(*key);
+                     if (it != entry.keyed_costs.end()) {
+                       res = it->second;
+                     }
+                   });
+  if (res) {
+    m_hits++;
+  } else {
+    m_misses++;
+  }
+  return res;
+}
+
+void SummaryCache::set_callee_cost(const DexMethod* callee,
+                                   size_t version,
+                                   const boost::optional<std::string>& key,
+                                   const InlinedCostAndDeadBlocks& cost) {
+  m_callees.update(callee, [&](const DexMethod*, CalleeEntry& entry, bool) {
+    if (entry.version != version) {
+      // Whatever we had before is stale.
+      entry = CalleeEntry();
+      entry.version = version;
+    }
+    if (key) {
+      entry.keyed_costs[*key] = cost;
+    } else {
+      entry.cost = cost;
+    }
+  });
+}
+
+} // namespace inliner
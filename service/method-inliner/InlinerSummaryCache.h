@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+#include "IPConstantPropagationAnalysis.h"
+
+using ConstantArguments = constant_propagation::interprocedural::ArgumentDomain;
+
+using InvokeConstantArguments =
+    std::vector<std::pair<IRInstruction*, ConstantArguments>>;
+
+struct InvokeConstantArgumentsAndDeadBlocks {
+  InvokeConstantArguments invoke_constant_arguments;
+  size_t dead_blocks{0};
+};
+
+struct InlinedCostAndDeadBlocks {
+  size_t cost;
+  size_t dead_blocks;
+};
+
+namespace inliner {
+
+/*
+ * The method inliner runs several times in a typical pipeline, and each
+ * MultiMethodInliner analyzes callers and callees from scratch. This cache
+ * keeps the expensive per-method summaries around across inliner invocations:
+ * - for callers, the constant arguments of all (reachable) invoke
+ *   instructions, and
+ * - for callees, the inlined cost, both without and with particular constant
+ *   arguments.
+ *
+ * Entries are keyed on a code version, a fingerprint of a method's editable
+ * CFG that includes the identities of all instructions, so that a summary is
+ * only reused when the method's code has not changed since it was computed.
+ * Stale entries get replaced as methods are re-analyzed.
+ *
+ * All operations are thread-safe.
+ */
+class SummaryCache {
+ public:
+  // The cache shared across all inliner invocations. It gets reset when the
+  // global RedexContext goes away.
+  static SummaryCache& get();
+
+  // Computes the code version of a method with an editable CFG.
+  static size_t get_code_version(const DexMethod* method);
+
+  std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks>
+  get_caller_summary(const DexMethod* caller, size_t version);
+
+  void set_caller_summary(
+      const DexMethod* caller,
+      size_t version,
+      std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks> summary);
+
+  // The key identifies the constant arguments for which the cost was
+  // computed; boost::none denotes the cost without constant arguments.
+  boost::optional<InlinedCostAndDeadBlocks> get_callee_cost(
+      const DexMethod* callee,
+      size_t version,
+      const boost::optional<std::string>& key);
+
+  void set_callee_cost(const DexMethod* callee,
+                       size_t version,
+                       const boost::optional<std::string>& key,
+                       const InlinedCostAndDeadBlocks& cost);
+
+  size_t get_hits() const { return m_hits; }
+  size_t get_misses() const { return m_misses; }
+
+ private:
+  struct CallerEntry {
+    size_t version{0};
+    std::shared_ptr<const InvokeConstantArgumentsAndDeadBlocks> summary;
+  };
+
+  struct CalleeEntry {
+    size_t version{0};
+    boost::optional<InlinedCostAndDeadBlocks> cost;
+    std::unordered_map<std::string, InlinedCostAndDeadBlocks> keyed_costs;
+  };
+
+  ConcurrentMap<const DexMethod*, CallerEntry> m_callers;
+  ConcurrentMap<const DexMethod*, CalleeEntry> m_callees;
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
+
+} // namespace inliner
@@ -352,6 +352,15 @@ void run_inliner(DexStoresVector& stores,
     });
   }
 
+  // Summaries of unchanged methods may be reused from earlier runs.
+  size_t summary_cache_hits{0};
+  size_t summary_cache_misses{0};
+  if (inliner_config.use_summary_cache) {
+    const auto& summary_cache = inliner::SummaryCache::get();
+    summary_cache_hits = summary_cache.get_hits();
+    summary_cache_misses = summary_cache.get_misses();
+  }
+
   // inline candidates
   MultiMethodInliner inliner(scope, stores, methods, resolver, inliner_config,
                              intra_dex ? IntraDex : InterDex,
@@ -392,6 +401,12 @@ void run_inliner(DexStoresVector& stores,
   TRACE(INLINE, 3, "max_call_stack_depth %ld",
         inliner.get_info().max_call_stack_depth);
   TRACE(INLINE, 3, "waited seconds %ld", inliner.get_info().waited_seconds);
+  TRACE(INLINE, 3, "idle worker seconds %ld",
+        inliner.get_info().idle_worker_seconds);
+  TRACE(INLINE, 3, "peak live shrinking %ld",
+        inliner.get_info().peak_live_shrinking);
+  TRACE(INLINE, 3, "shrinking waited milliseconds %ld",
+        inliner.get_info().shrinking_waited_milliseconds);
   TRACE(INLINE, 3, "blacklisted meths %ld",
         (size_t)inliner.get_info().blacklisted);
   TRACE(INLINE, 3, "virtualizing methods %ld",
@@ -445,7 +460,20 @@ void run_inliner(DexStoresVector& stores,
       inliner.get_info().constant_invoke_callees_unreachable_blocks);
   mgr.incr_metric("critical_path_length",
                   inliner.get_info().critical_path_length);
+  mgr.incr_metric("idle_worker_seconds",
+                  inliner.get_info().idle_worker_seconds);
+  mgr.incr_metric("peak_live_shrinking",
+                  inliner.get_info().peak_live_shrinking);
+  mgr.incr_metric("shrinking_waited_milliseconds",
+                  inliner.get_info().shrinking_waited_milliseconds);
   mgr.incr_metric("methods_shrunk", inliner.get_methods_shrunk());
+  if (inliner_config.use_summary_cache) {
+    const auto& summary_cache = inliner::SummaryCache::get();
+    mgr.incr_metric("summary_cache_hits",
+                    summary_cache.get_hits() - summary_cache_hits);
+    mgr.incr_metric("summary_cache_misses",
+                    summary_cache.get_misses() - summary_cache_misses);
+  }
   mgr.incr_metric("callers", inliner.get_callers());
   mgr.incr_metric("delayed_shrinking_callees",
                   inliner.get_delayed_shrinking_callees());
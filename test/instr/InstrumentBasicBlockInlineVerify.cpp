@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "DexInstruction.h"
+#include "VerifyUtil.h"
+#include "Walkers.h"
+
+TEST_F(PreVerify, InstrumentBBInlineVerify) {
+  auto cls = find_class_named(
+      classes, "Lcom/facebook/redextest/InstrumentBasicBlockTarget;");
+  ASSERT_NE(cls, nullptr);
+
+  walk::code(std::vector<DexClass*>{cls}, [](DexMethod* method, IRCode&) {
+    EXPECT_EQ(nullptr,
+              find_invoke(method, DOPCODE_INVOKE_STATIC, "onMethodExitBB"));
+  });
+}
+
+// With inline_bb_vector_updates, every exit point writes the bit vectors to
+// sBasicBlockStats directly instead of calling onMethodExitBB.
+TEST_F(PostVerify, InstrumentBBInlineVerify) {
+  auto cls = find_class_named(
+      classes, "Lcom/facebook/redextest/InstrumentBasicBlockTarget;");
+  ASSERT_NE(cls, nullptr);
+
+  size_t num_instrumented = 0;
+  walk::methods(std::vector<DexClass*>{cls}, [&](DexMethod* method) {
+    if (method->get_dex_code() == nullptr) {
+      return;
+    }
+    EXPECT_EQ(nullptr,
+              find_invoke(method, DOPCODE_INVOKE_STATIC, "onMethodExitBB"))
+        << show(method);
+
+    size_t num_returns = 0;
+    size_t num_stats_reads = 0;
+    for (auto insn : method->get_dex_code()->get_instructions()) {
+      switch (insn->opcode()) {
+      case DOPCODE_RETURN_VOID:
+      case DOPCODE_RETURN:
+      case DOPCODE_RETURN_WIDE:
+      case DOPCODE_RETURN_OBJECT:
+        num_returns++;
+        break;
+      case DOPCODE_SGET_OBJECT:
+        if (static_cast<DexOpcodeField*>(insn)->get_field()->str() ==
+            "sBasicBlockStats") {
+          num_stats_reads++;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+    EXPECT_EQ(num_returns, num_stats_reads) << show(method);
+    if (num_stats_reads > 0) {
+      num_instrumented++;
+    }
+  });
+  EXPECT_GT(num_instrumented, 0);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+
+#include "CommonSubexpressionElimination.h"
+#include "ControlFlow.h"
+#include "DexLoader.h"
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "Purity.h"
+#include "RedexTest.h"
+#include "Walkers.h"
+
+//==========
+// Measures the throughput of the CSE analysis over all methods of a dex file,
+// without and with a cap on the number of value ids per method. Meant to be
+// run on the (10MB or so) dex file of a large app, given by the dexfile
+// environment variable. Code is only analyzed, not patched, so that both runs
+// see the same methods.
+//==========
+
+class CommonSubexpressionEliminationPerfTest : public RedexTest {};
+
+TEST_F(CommonSubexpressionEliminationPerfTest, analyzeAllMethods) {
+  const char* dexfile = std::getenv("dexfile");
+  ASSERT_NE(nullptr, dexfile);
+  auto classes = load_classes_from_dex(dexfile, /* balloon */ true);
+  ASSERT_FALSE(classes.empty());
+  Scope scope(classes.begin(), classes.end());
+
+  walk::parallel::code(scope, [&](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ true);
+  });
+  std::vector<DexMethod*> methods;
+  walk::code(scope,
+             [&](DexMethod* method, IRCode&) { methods.push_back(method); });
+
+  cse_impl::SharedState shared_state(get_pure_methods());
+  shared_state.init_scope(scope);
+
+  auto analyze_all = [&](size_t max_value_ids) {
+    cse_impl::Stats stats;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto method : methods) {
+      cse_impl::CommonSubexpressionElimination cse(
+          &shared_state, method->get_code()->cfg(), is_static(method),
+          method::is_init(method) || method::is_clinit(method),
+          method->get_class(), method->get_proto()->get_args(), max_value_ids);
+      stats += cse.get_stats();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> time = end - start;
+    std::cout << "Max value ids " << max_value_ids << ": " << time.count()
+              << "s, " << methods.size() / time.count() << " methods/s, "
+              << "max value ids used: " << stats.max_value_ids
+              << ", methods exceeding budget: "
+              << stats.methods_exceeding_value_ids_budget << std::endl;
+  };
+
+  std::cout << "Dex file: " << dexfile << ", " << methods.size()
+            << " methods with code" << std::endl;
+  analyze_all(cse_impl::MAX_VALUE_IDS);
+  analyze_all(10000);
+
+  walk::parallel::code(scope,
+                       [&](DexMethod*, IRCode& code) { code.clear_cfg(); });
+  shared_state.cleanup();
+}
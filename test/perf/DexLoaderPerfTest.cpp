@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <chrono>
+#include <iostream>
+
+#include "DexIdx.h"
+#include "DexLoader.h"
+#include "RedexContext.h"
+#include "RedexTest.h"
+
+//==========
+// Measures how long it takes to decode the string, type and proto sections of
+// a dex file lazily, one entry after the other, and with the parallel bulk
+// decoding done by DexIdx::decode_all, as well as the overall time it takes
+// to load all classes. Meant to be run on a large (10MB or so) dex file,
+// given by the dexfile environment variable.
+//==========
+
+class DexLoaderPerfTest : public RedexTest {
+ protected:
+  // Interning is global, so every measurement needs to start from scratch.
+  void reset_context() {
+    delete g_redex;
+    g_redex = new RedexContext();
+  }
+};
+
+TEST_F(DexLoaderPerfTest, decodeAndLoad) {
+  const char* dexfile = std::getenv("dexfile");
+  ASSERT_NE(nullptr, dexfile);
+  boost::iostreams::mapped_file file;
+  file.open(dexfile, boost::iostreams::mapped_file::readonly);
+  ASSERT_TRUE(file.is_open());
+  auto dh = reinterpret_cast<const dex_header*>(file.const_data());
+  std::cout << "Dex file: " << dexfile << ", " << dh->file_size << " bytes, "
+            << dh->string_ids_size << " strings, " << dh->type_ids_size
+            << " types, " << dh->proto_ids_size << " protos, "
+            << dh->class_defs_size << " classes" << std::endl;
+
+  reset_context();
+  auto lazy_start = std::chrono::high_resolution_clock::now();
+  {
+    DexIdx idx(dh);
+    for (uint32_t i = 0; i < dh->string_ids_size; i++) {
+      idx.get_stringidx(i);
+    }
+    for (uint32_t i = 0; i < dh->type_ids_size; i++) {
+      idx.get_typeidx(i);
+    }
+    for (uint32_t i = 0; i < dh->proto_ids_size; i++) {
+      idx.get_protoidx(i);
+    }
+  }
+  auto lazy_end = std::chrono::high_resolution_clock::now();
+
+  reset_context();
+  auto bulk_start = std::chrono::high_resolution_clock::now();
+  {
+    DexIdx idx(dh);
+    DexIdx::decode_all({&idx});
+  }
+  auto bulk_end = std::chrono::high_resolution_clock::now();
+
+  reset_context();
+  auto load_start = std::chrono::high_resolution_clock::now();
+  auto classes = load_classes_from_dex(dexfile, /* balloon */ false);
+  auto load_end = std::chrono::high_resolution_clock::now();
+  EXPECT_FALSE(classes.empty());
+
+  std::chrono::duration<double> lazy_time = lazy_end - lazy_start;
+  std::chrono::duration<double> bulk_time = bulk_end - bulk_start;
+  std::chrono::duration<double> load_time = load_end - load_start;
+  std::cout << "Lazy decoding: " << lazy_time.count() << "s" << std::endl
+            << "Bulk decoding: " << bulk_time.count() << "s" << std::endl
+            << "Loading all classes: " << load_time.count() << "s"
+            << std::endl;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/regex.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ProguardRegex.h"
+
+using namespace keep_rules;
+
+//==========
+// Compares the compiled class name matcher against boost::regex on a
+// synthetic rule set that mimics typical keep rules of a large app.
+//==========
+
+namespace {
+
+std::vector<std::string> make_class_names(size_t count) {
+  std::mt19937 gen(0);
+  const std::vector<std::string> packages = {
+      "com/facebook/", "com/facebook/redex/", "com/facebook/common/",
+      "androidx/core/", "androidx/fragment/app/", "com/google/common/",
+      "org/json/", "com/instagram/feed/"};
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    auto name = "L" + packages[gen() % packages.size()] + "Class" +
+                std::to_string(i);
+    if (gen() % 4 == 0) {
+      name += "$Inner" + std::to_string(gen() % 10);
+    }
+    names.push_back(name + ";");
+  }
+  return names;
+}
+
+std::vector<std::string> make_patterns(size_t count) {
+  std::mt19937 gen(1);
+  const std::vector<std::string> templates = {
+      "Lcom/facebook/**;",        "Lcom/facebook/redex/*;",
+      "Landroidx/**Fragment*;",   "Lcom/google/common/**$*;",
+      "L**Class1?;",              "Lorg/json/*;",
+      "Lcom/instagram/**/Class*;"};
+  std::vector<std::string> patterns;
+  patterns.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    patterns.push_back(templates[gen() % templates.size()]);
+  }
+  return patterns;
+}
+
+} // namespace
+
+TEST(ProguardMatcherPerfTest, compiledVsRegex) {
+  auto names = make_class_names(20000);
+  auto patterns = make_patterns(200);
+
+  size_t regex_matches = 0;
+  auto regex_start = std::chrono::high_resolution_clock::now();
+  for (const auto& pattern : patterns) {
+    boost::regex rx(proguard_parser::form_type_regex(pattern));
+    for (const auto& name : names) {
+      regex_matches += boost::regex_match(name, rx);
+    }
+  }
+  auto regex_end = std::chrono::high_resolution_clock::now();
+
+  size_t compiled_matches = 0;
+  auto compiled_start = std::chrono::high_resolution_clock::now();
+  for (const auto& pattern : patterns) {
+    proguard_parser::ClassNamePatternMatcher matcher(pattern);
+    for (const auto& name : names) {
+      compiled_matches += matcher.match(name);
+    }
+  }
+  auto compiled_end = std::chrono::high_resolution_clock::now();
+
+  EXPECT_EQ(regex_matches, compiled_matches);
+  double regex_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        regex_end - regex_start)
+                        .count();
+  double compiled_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           compiled_end - compiled_start)
+                           .count();
+  std::cout << "boost::regex: " << regex_ms
+            << "ms, compiled matcher: " << compiled_ms << "ms" << std::endl;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+#include "SubtypingIndex.h"
+#include "TypeUtil.h"
+
+//==========
+// Compares check-cast queries answered by the SubtypingIndex against
+// type::check_cast, which walks the hierarchy, on a synthetic hierarchy that
+// mimics the shape of a large app: shallow class trees with a few deep
+// chains, and interfaces with small super-interface DAGs.
+//==========
+
+class SubtypingIndexPerfTest : public RedexTest {};
+
+TEST_F(SubtypingIndexPerfTest, checkCastThroughput) {
+  const size_t num_interfaces = 2000;
+  const size_t num_classes = 50000;
+  const size_t num_queries = 2000000;
+  std::mt19937 gen(0);
+
+  Scope scope = create_empty_scope();
+  std::vector<DexType*> intfs;
+  for (size_t i = 0; i < num_interfaces; i++) {
+    auto type = DexType::make_type(("LI" + std::to_string(i) + ";").c_str());
+    std::vector<DexType*> supers;
+    if (!intfs.empty() && gen() % 2 == 0) {
+      supers.push_back(intfs[gen() % intfs.size()]);
+    }
+    scope.push_back(create_internal_class(type, type::java_lang_Object(),
+                                          supers,
+                                          ACC_PUBLIC | ACC_INTERFACE));
+    intfs.push_back(type);
+  }
+  std::vector<DexType*> classes{type::java_lang_Object()};
+  for (size_t i = 0; i < num_classes; i++) {
+    auto type = DexType::make_type(("LC" + std::to_string(i) + ";").c_str());
+    // Prefer recent classes as superclasses to get some deep chains.
+    auto super = gen() % 4 == 0
+                     ? classes[classes.size() - 1 - gen() % 8]
+                     : classes[gen() % classes.size()];
+    std::vector<DexType*> class_intfs;
+    for (size_t j = gen() % 3; j > 0; j--) {
+      class_intfs.push_back(intfs[gen() % intfs.size()]);
+    }
+    scope.push_back(create_internal_class(type, super, class_intfs));
+    classes.push_back(type);
+  }
+
+  std::vector<std::pair<DexType*, DexType*>> queries;
+  queries.reserve(num_queries);
+  for (size_t i = 0; i < num_queries; i++) {
+    auto base = gen() % 3 == 0 ? intfs[gen() % intfs.size()]
+                               : classes[gen() % classes.size()];
+    queries.emplace_back(classes[gen() % classes.size()], base);
+  }
+
+  auto build_start = std::chrono::high_resolution_clock::now();
+  SubtypingIndex index(scope);
+  auto build_end = std::chrono::high_resolution_clock::now();
+
+  size_t walk_hits = 0;
+  auto walk_start = std::chrono::high_resolution_clock::now();
+  for (const auto& q : queries) {
+    walk_hits += type::check_cast(q.first, q.second);
+  }
+  auto walk_end = std::chrono::high_resolution_clock::now();
+
+  size_t index_hits = 0;
+  auto index_start = std::chrono::high_resolution_clock::now();
+  for (const auto& q : queries) {
+    index_hits += *index.check_cast(q.first, q.second);
+  }
+  auto index_end = std::chrono::high_resolution_clock::now();
+
+  EXPECT_EQ(walk_hits, index_hits);
+  auto ms = [](auto start, auto end) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+        .count();
+  };
+  std::cout << "index build: " << ms(build_start, build_end)
+            << "ms, type::check_cast: " << ms(walk_start, walk_end)
+            << "ms, SubtypingIndex::check_cast: "
+            << ms(index_start, index_end) << "ms" << std::endl;
+}
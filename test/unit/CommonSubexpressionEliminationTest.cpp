@@ -33,7 +33,8 @@ void test(const Scope& scope,
           bool is_static = true,
           bool is_init_or_clinit = false,
           DexType* declaring_type = nullptr,
-          DexTypeList* args = DexTypeList::make_type_list({})) {
+          DexTypeList* args = DexTypeList::make_type_list({}),
+          size_t max_value_ids = cse_impl::MAX_VALUE_IDS) {
   auto field_a = DexField::make_field("LFoo;.a:I")->make_concrete(ACC_PUBLIC);
 
   auto field_b = DexField::make_field("LFoo;.b:I")->make_concrete(ACC_PUBLIC);
@@ -63,7 +64,8 @@ void test(const Scope& scope,
   shared_state.init_scope(scope);
   cse_impl::CommonSubexpressionElimination cse(&shared_state, code->cfg(),
                                                is_static, is_init_or_clinit,
-                                               declaring_type, args);
+                                               declaring_type, args,
+                                               max_value_ids);
   cse.patch();
   code->clear_cfg();
   walk::code(scope, [&](DexMethod*, IRCode& code) { code.clear_cfg(); });
@@ -98,6 +100,23 @@ TEST_F(CommonSubexpressionEliminationTest, simple) {
   test(Scope{type_class(type::java_lang_Object())}, code_str, expected_str, 1);
 }
 
+TEST_F(CommonSubexpressionEliminationTest, value_ids_budget) {
+  // Only the const gets a value id; the add-int values are unknown.
+  auto code_str = R"(
+    (
+      (const v0 0)
+      (add-int v1 v0 v0)
+      (add-int v2 v0 v0)
+    )
+  )";
+  auto expected_str = code_str;
+
+  test(Scope{type_class(type::java_lang_Object())}, code_str, expected_str, 0,
+       /* is_static */ true, /* is_init_or_clinit */ false,
+       /* declaring_type */ nullptr, DexTypeList::make_type_list({}),
+       /* max_value_ids */ 1);
+}
+
 TEST_F(CommonSubexpressionEliminationTest, pre_values) {
   // By not initializing v0, it will start out as 'top', and a pre-value will
   // be used internally to recover from that situation and still unify the
@@ -6,12 +6,61 @@
  */
 
 #include "DexLoader.h"
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexOutput.h"
+#include "DexPosition.h"
 #include "RedexTest.h"
+#include "RedexTestUtils.h"
+#include <fstream>
 #include <gtest/gtest.h>
 #include <stdint.h>
 
 class DexLoaderTest : public RedexTest {};
 
+namespace {
+
+/*
+ * Writes a dex file with a class of each of the given names, in a fresh
+ * context. Each class has an instance field that is named after the dex file.
+ */
+std::string write_dex(const redex::TempDir& tmp_dir,
+                      const std::string& dex_name,
+                      const std::vector<std::string>& class_names) {
+  delete g_redex;
+  g_redex = new RedexContext();
+  DexClasses classes;
+  for (const auto& class_name : class_names) {
+    auto type = DexType::make_type(class_name.c_str());
+    ClassCreator cc(type);
+    cc.set_super(type::java_lang_Object());
+    auto field = DexField::make_field(type, DexString::make_string(dex_name),
+                                      type::_int())
+                     ->make_concrete(ACC_PUBLIC);
+    cc.add_field(field);
+    classes.push_back(cc.create());
+  }
+
+  auto path = tmp_dir.path + "/" + dex_name + ".dex";
+  ConfigFiles conf(Json::nullValue, tmp_dir.path);
+  boost::filesystem::create_directories(tmp_dir.path + "/meta");
+  std::unique_ptr<PositionMapper> pos_mapper(PositionMapper::make(""));
+  write_classes_to_dex(RedexOptions(), path, &classes, nullptr, 0, 0, conf,
+                       pos_mapper.get(), nullptr, nullptr, nullptr,
+                       "dex\n035\0");
+  return path;
+}
+
+// Returns the dex file whose definition of the given class was loaded.
+std::string loaded_from(const char* class_name) {
+  auto cls = type_class(DexType::get_type(class_name));
+  always_assert(cls != nullptr);
+  always_assert(cls->get_ifields().size() == 1);
+  return cls->get_ifields()[0]->get_name()->str();
+}
+
+} // namespace
+
 TEST_F(DexLoaderTest, dex_header_item_size) {
   // https://source.android.com/devices/tech/dalvik/dex-format#type-codes
   EXPECT_EQ(0x70, sizeof(dex_header));
@@ -48,3 +97,61 @@ TEST_F(DexLoaderTest, align_ptr) {
   EXPECT_EQ(UINTPTR_MAX_ALIGNED, align_ptr(UINTPTR_MAX_ALIGNED - 1, 4));
   EXPECT_EQ(UINTPTR_MAX_ALIGNED, align_ptr(UINTPTR_MAX_ALIGNED - 0, 4));
 }
+
+TEST_F(DexLoaderTest, load_classes_from_dexes_resolves_duplicates_in_order) {
+  auto tmp_dir = redex::make_tmp_dir("redex_dex_loader_test_%%%%%%%%");
+  auto dex1 = write_dex(tmp_dir, "dex1", {"LA;", "LDup;", "LB;"});
+  auto dex2 = write_dex(tmp_dir, "dex2", {"LDup;", "LC;"});
+
+  // The first definition in the order of the dex files wins, however the
+  // classes get distributed across threads.
+  for (const auto& locations : {std::vector<std::string>{dex1, dex2},
+                                std::vector<std::string>{dex2, dex1}}) {
+    for (size_t i = 0; i < 10; i++) {
+      delete g_redex;
+      g_redex = new RedexContext(/* allow_class_duplicates */ true);
+      auto all_classes = load_classes_from_dexes(locations, nullptr);
+      ASSERT_EQ(all_classes.size(), 2);
+      bool dex1_first = locations[0] == dex1;
+      EXPECT_EQ(loaded_from("LDup;"), dex1_first ? "dex1" : "dex2");
+      std::vector<std::string> names1, names2;
+      for (auto cls : all_classes[dex1_first ? 0 : 1]) {
+        names1.push_back(cls->get_name()->str());
+      }
+      for (auto cls : all_classes[dex1_first ? 1 : 0]) {
+        names2.push_back(cls->get_name()->str());
+      }
+      if (dex1_first) {
+        EXPECT_EQ(names1, std::vector<std::string>({"LA;", "LDup;", "LB;"}));
+        EXPECT_EQ(names2, std::vector<std::string>({"LC;"}));
+      } else {
+        EXPECT_EQ(names1, std::vector<std::string>({"LA;", "LB;"}));
+        EXPECT_EQ(names2, std::vector<std::string>({"LDup;", "LC;"}));
+      }
+    }
+  }
+
+  // Without allowing duplicates, the later definition is always the one that
+  // gets rejected.
+  delete g_redex;
+  g_redex = new RedexContext();
+  EXPECT_THROW(load_classes_from_dexes({dex2, dex1}, nullptr),
+               aggregate_exception);
+  EXPECT_EQ(loaded_from("LDup;"), "dex2");
+}
+
+TEST_F(DexLoaderTest, load_classes_from_dexes_rejects_bad_magic) {
+  auto tmp_dir = redex::make_tmp_dir("redex_dex_loader_test_%%%%%%%%");
+  auto dex1 = write_dex(tmp_dir, "dex1", {"LA;"});
+  auto dex2 = write_dex(tmp_dir, "dex2", {"LB;"});
+  {
+    std::fstream fs(dex2, std::ios::in | std::ios::out | std::ios::binary);
+    fs.write("xxx", 3);
+  }
+
+  // A bad dex file gets reported as an error, not by terminating a worker.
+  delete g_redex;
+  g_redex = new RedexContext();
+  EXPECT_THROW(load_classes_from_dexes({dex1, dex2}, nullptr),
+               RedexException);
+}
@@ -6,8 +6,18 @@
  */
 
 #include "DexOutput.h"
+#include <boost/filesystem.hpp>
 #include <gtest/gtest.h>
 #include <json/json.h>
+#include <random>
+
+#include "Creators.h"
+#include "DexPosition.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+class DexOutputTest : public RedexTest {};
 
 TEST(DexOutput, checkMethodInstructionSizeLimit) {
 
@@ -24,3 +34,44 @@ TEST(DexOutput, checkMethodInstructionSizeLimit) {
       DexOutput::check_method_instruction_size_limit(conf, 65537, "method"),
       RedexException);
 }
+
+TEST(DexOutput, parallelSortMatchesSort) {
+  std::mt19937 gen(0);
+  // Also covers an odd number of chunks, and sizes below the chunk size.
+  for (size_t size : {0, 10, 4096 * 3 + 7, 100000}) {
+    std::vector<uint32_t> vec;
+    for (size_t i = 0; i < size; i++) {
+      vec.push_back(gen());
+    }
+    auto expected = vec;
+    std::sort(expected.begin(), expected.end());
+    parallel_sort(vec, std::less<uint32_t>());
+    EXPECT_EQ(expected, vec);
+  }
+}
+
+// Code items are encoded on worker threads. An oversized method must still
+// raise an exception on the calling thread.
+TEST_F(DexOutputTest, oversizedMethodThrows) {
+  ClassCreator cc(DexType::make_type("LFoo;"));
+  cc.set_super(type::java_lang_Object());
+  auto method = DexMethod::make_method("LFoo;.foo:()V")
+                    ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  method->set_code(assembler::ircode_from_string("((return-void))"));
+  cc.add_method(method);
+  DexClasses classes{cc.create()};
+  method->sync();
+
+  auto tmp_dir = redex::make_tmp_dir("redex_dex_output_test_%%%%%%%%");
+  boost::filesystem::create_directories(tmp_dir.path + "/meta");
+  // The header of a code item alone takes 16 bytes.
+  Json::Value json_cfg;
+  json_cfg["instruction_size_bitwidth_limit"] = 3;
+  ConfigFiles conf(json_cfg, tmp_dir.path);
+  std::unique_ptr<PositionMapper> pos_mapper(PositionMapper::make(""));
+  EXPECT_THROW(write_classes_to_dex(RedexOptions(), tmp_dir.path + "/out.dex",
+                                    &classes, nullptr, 0, 0, conf,
+                                    pos_mapper.get(), nullptr, nullptr,
+                                    nullptr, "dex\n035\0"),
+               RedexException);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "HierarchyService.h"
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "DexUtil.h"
+#include "RedexTest.h"
+
+namespace mog = method_override_graph;
+
+namespace {
+
+DexClass* create_class(const std::string& name, const DexType* super) {
+  ClassCreator cc(DexType::make_type(name.c_str()));
+  cc.set_super(const_cast<DexType*>(super));
+  return cc.create();
+}
+
+DexMethod* add_virtual_method(DexClass* cls, const std::string& name) {
+  auto method = DexMethod::make_method(show(cls->get_type()) + "." + name +
+                                       ":()V")
+                    ->make_concrete(ACC_PUBLIC, /* is_virtual */ true);
+  cls->add_method(method);
+  return method;
+}
+
+} // namespace
+
+class HierarchyServiceTest : public RedexTest {};
+
+TEST_F(HierarchyServiceTest, reuseUnchanged) {
+  auto a = create_class("LA;", type::java_lang_Object());
+  auto b = create_class("LB;", a->get_type());
+  Scope scope{a, b};
+
+  HierarchyService service(/* validate */ true);
+  auto ch = service.get_class_hierarchy(scope);
+  EXPECT_EQ(*ch, build_type_hierarchy(scope));
+  EXPECT_EQ(service.get_class_hierarchy(scope), ch);
+  auto graph = service.get_method_override_graph(scope);
+  EXPECT_EQ(service.get_method_override_graph(scope), graph);
+
+  const auto& stats = service.get_stats();
+  EXPECT_EQ(stats.full_builds, 2);
+  EXPECT_EQ(stats.reused, 2);
+  EXPECT_EQ(stats.incremental_updates, 0);
+}
+
+TEST_F(HierarchyServiceTest, updateSuperAndRemoveClass) {
+  auto a = create_class("LA;", type::java_lang_Object());
+  auto b = create_class("LB;", a->get_type());
+  auto c = create_class("LC;", b->get_type());
+  Scope scope{a, b, c};
+
+  HierarchyService service(/* validate */ true);
+  auto old_ch = service.get_class_hierarchy(scope);
+  auto old_ch_copy = *old_ch;
+
+  // Move C up, then drop B altogether.
+  c->set_super_class(a->get_type());
+  scope = {a, c};
+  auto ch = service.get_class_hierarchy(scope);
+  EXPECT_EQ(*ch, build_type_hierarchy(scope));
+  EXPECT_EQ(ch->count(b->get_type()), 0);
+  // Clients holding on to the old hierarchy don't observe the update.
+  EXPECT_EQ(*old_ch, old_ch_copy);
+
+  const auto& stats = service.get_stats();
+  EXPECT_EQ(stats.full_builds, 1);
+  EXPECT_EQ(stats.incremental_updates, 1);
+}
+
+TEST_F(HierarchyServiceTest, rebuildOverrideGraphOnMethodChange) {
+  auto a = create_class("LA;", type::java_lang_Object());
+  auto b = create_class("LB;", a->get_type());
+  auto a_foo = add_virtual_method(a, "foo");
+  Scope scope{a, b};
+
+  HierarchyService service(/* validate */ true);
+  auto graph = service.get_method_override_graph(scope);
+  EXPECT_TRUE(graph->get_node(a_foo).children.empty());
+
+  auto b_foo = add_virtual_method(b, "foo");
+  auto new_graph = service.get_method_override_graph(scope);
+  EXPECT_NE(new_graph, graph);
+  EXPECT_EQ(new_graph->get_node(a_foo).children,
+            std::unordered_set<const DexMethod*>{b_foo});
+
+  // The class hierarchy doesn't need any update for a new method.
+  auto ch = service.get_class_hierarchy(scope);
+  EXPECT_EQ(*ch, build_type_hierarchy(scope));
+  EXPECT_EQ(service.get_stats().incremental_updates, 0);
+}
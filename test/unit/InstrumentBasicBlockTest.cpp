@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <string>
+
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "Instrument.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+class InstrumentBasicBlockTest : public RedexTest {
+ public:
+  InstrumentBasicBlockTest() {
+    // The analysis class must look like it is in the primary dex. Its stats
+    // field is private, just like in the real analysis class.
+    ClassCreator analysis_creator(DexType::make_type("LAnalysis;"),
+                                  "/fake/classes.dex");
+    analysis_creator.set_super(type::java_lang_Object());
+    m_stats_field = DexField::make_field("LAnalysis;.sBasicBlockStats:[I")
+                        ->make_concrete(ACC_PRIVATE | ACC_STATIC | ACC_FINAL);
+    analysis_creator.add_field(m_stats_field);
+    auto clinit = DexMethod::make_method("LAnalysis;.<clinit>:()V")
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC |
+                                          ACC_CONSTRUCTOR,
+                                      false);
+    clinit->set_code(assembler::ircode_from_string(R"(
+      (
+        (const v0 0)
+        (new-array v0 "[I")
+        (move-result-pseudo-object v1)
+        (sput-object v1 "LAnalysis;.sBasicBlockStats:[I")
+        (return-void)
+      )
+    )"));
+    analysis_creator.add_method(clinit);
+    auto on_exit = DexMethod::make_method("LAnalysis;.onMethodExitBB:(IS)V")
+                       ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    on_exit->set_code(assembler::ircode_from_string(R"(
+      (
+        (load-param v0)
+        (load-param v1)
+        (return-void)
+      )
+    )"));
+    analysis_creator.add_method(on_exit);
+
+    // Blocks, in order: B0 (if-eqz), B1 (return-void), B2 (goto :l),
+    // B3 (return-void), B4 (goto :m). B4 executes exactly when B2 does.
+    ClassCreator target_creator(DexType::make_type("LTarget;"));
+    target_creator.set_super(type::java_lang_Object());
+    m_method = DexMethod::make_method("LTarget;.foo:(I)V")
+                   ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    m_method->set_code(assembler::ircode_from_string(R"(
+      (
+        (load-param v0)
+        (if-eqz v0 :a)
+        (return-void)
+        (:a)
+        (const v1 1)
+        (goto :l)
+        (:m)
+        (return-void)
+        (:l)
+        (const v1 2)
+        (goto :m)
+      )
+    )"));
+    target_creator.add_method(m_method);
+
+    DexStore store("classes");
+    store.add_classes({analysis_creator.create(), target_creator.create()});
+    m_stores.emplace_back(std::move(store));
+  }
+
+  // Runs the pass and returns the contents of the metadata file.
+  std::string run_pass(bool skip_equivalent_blocks) {
+    Json::Value pass_config;
+    pass_config["instrumentation_strategy"] = "basic_block_tracing";
+    pass_config["analysis_class_name"] = "LAnalysis;";
+    pass_config["analysis_method_name"] = "onMethodExitBB";
+    pass_config["whitelist"].append("LTarget;");
+    pass_config["only_cold_start_class"] = false;
+    pass_config["inline_bb_vector_updates"] = true;
+    pass_config["skip_equivalent_blocks"] = skip_equivalent_blocks;
+    Json::Value config;
+    config["redex"]["passes"].append("InstrumentPass");
+    config["InstrumentPass"] = pass_config;
+    config["instrument_pass_enabled"] = true;
+
+    boost::filesystem::create_directory(m_tmp_dir.path + "/meta");
+    ConfigFiles conf(config, m_tmp_dir.path);
+    InstrumentPass pass;
+    PassManager manager({&pass}, config);
+    manager.run_passes(m_stores, conf);
+
+    std::ifstream ifs(conf.metafile("redex-instrument-metadata.txt"));
+    return std::string(std::istreambuf_iterator<char>(ifs),
+                       std::istreambuf_iterator<char>());
+  }
+
+  size_t count_opcodes(IROpcode op) {
+    auto code = m_method->get_code();
+    return std::count_if(code->begin(), code->end(), [&](const auto& mie) {
+      return mie.type == MFLOW_OPCODE && mie.insn->opcode() == op;
+    });
+  }
+
+ protected:
+  DexMethod* m_method;
+  DexField* m_stats_field;
+
+ private:
+  DexStoresVector m_stores;
+  redex::TempDir m_tmp_dir =
+      redex::make_tmp_dir("redex_instrument_basic_block_%%%%%%%%");
+};
+
+TEST_F(InstrumentBasicBlockTest, inlineUpdates) {
+  auto registers_size = m_method->get_code()->get_registers_size();
+  EXPECT_EQ(run_pass(/* skip_equivalent_blocks */ false),
+            "1,LTarget;.foo:(I)V,5\n");
+
+  // Instrumented classes read the stats field directly.
+  EXPECT_TRUE(is_public(m_stats_field));
+  EXPECT_TRUE(is_public(type_class(DexType::get_type("LAnalysis;"))));
+
+  // Both exits write the bit vector to the stats array, without any call.
+  EXPECT_EQ(count_opcodes(OPCODE_INVOKE_STATIC), 0);
+  EXPECT_EQ(count_opcodes(OPCODE_SGET_OBJECT), 2);
+  EXPECT_EQ(count_opcodes(OPCODE_APUT), 2);
+  EXPECT_EQ(count_opcodes(OPCODE_OR_INT_LIT16), 5);
+  // One register for the bit vector, and three temps shared by the exits.
+  EXPECT_EQ(m_method->get_code()->get_registers_size(), registers_size + 4);
+}
+
+TEST_F(InstrumentBasicBlockTest, skipEquivalentBlocks) {
+  // B4 is skipped in favor of B2. B3 isn't skipped in favor of B4, as B4
+  // doesn't have a bit of its own.
+  EXPECT_EQ(run_pass(/* skip_equivalent_blocks */ true),
+            "1,LTarget;.foo:(I)V,5,\"4=2\"\n");
+  EXPECT_EQ(count_opcodes(OPCODE_OR_INT_LIT16), 4);
+}
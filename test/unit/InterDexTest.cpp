@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+#include <boost/filesystem.hpp>
+#include <string>
+#include <unordered_set>
+
+#include "ClassReferencesCache.h"
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexClass.h"
+#include "DexLimits.h"
+#include "IRAssembler.h"
+#include "InterDexPass.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+namespace {
+
+// Instructions that refer to the given number of otherwise unused types.
+std::string refer_to_types(const std::string& prefix, size_t num_types) {
+  std::string insns;
+  for (size_t i = 0; i < num_types; i++) {
+    insns += "(const-class \"L" + prefix + std::to_string(i) +
+             ";\") (move-result-pseudo-object v1) ";
+  }
+  return insns;
+}
+
+} // namespace
+
+class InterDexTest : public RedexTest {};
+
+// The cross-dex relocator moves static methods into new classes after the refs
+// of all classes were first gathered. This changes the types referred to by
+// the callers of those methods, which must be accounted for when filling the
+// dexes.
+TEST_F(InterDexTest, relocatedMethodsStayWithinTypeRefLimit) {
+  const size_t kTypeRefsLimit = 16;
+  const size_t kNumCallees = 6;
+  const size_t kNumCallers = 12;
+
+  // The callee class refers to enough types to fill a dex of its own, so that
+  // the relocated methods end up in other dexes and stay relocated.
+  std::vector<DexClass*> classes;
+  ClassCreator callee_creator(DexType::make_type("LCallee;"));
+  callee_creator.set_super(type::java_lang_Object());
+  auto big = DexMethod::make_method("LCallee;.big:()V")
+                 ->make_concrete(ACC_PUBLIC, true);
+  big->set_code(assembler::ircode_from_string(
+      "((load-param-object v0) " + refer_to_types("CalleeType", 12) +
+      "(return-void))"));
+  callee_creator.add_method(big);
+  std::string calls;
+  for (size_t i = 0; i < kNumCallees; i++) {
+    auto name = "LCallee;.foo" + std::to_string(i) + ":()V";
+    auto callee = DexMethod::make_method(name)->make_concrete(
+        ACC_PUBLIC | ACC_STATIC, false);
+    callee->set_code(assembler::ircode_from_string("((return-void))"));
+    callee_creator.add_method(callee);
+    calls += "(invoke-static () \"" + name + "\") ";
+  }
+  classes.push_back(callee_creator.create());
+
+  // Virtual methods aren't relocated, so the callers stay where they are.
+  for (size_t i = 0; i < kNumCallers; i++) {
+    auto caller_name = "LCaller" + std::to_string(i) + ";";
+    ClassCreator caller_creator(DexType::make_type(caller_name.c_str()));
+    caller_creator.set_super(type::java_lang_Object());
+    auto caller = DexMethod::make_method(caller_name + ".bar:()V")
+                      ->make_concrete(ACC_PUBLIC, true);
+    caller->set_code(assembler::ircode_from_string(
+        "((load-param-object v0) " +
+        refer_to_types("CallerType" + std::to_string(i) + "_", 2) + calls +
+        "(return-void))"));
+    caller_creator.add_method(caller);
+    classes.push_back(caller_creator.create());
+  }
+  DexStore store("classes");
+  store.add_classes(classes);
+  DexStoresVector stores;
+  stores.emplace_back(std::move(store));
+
+  auto tmp_dir = redex::make_tmp_dir("redex_interdex_test_%%%%%%%%");
+  boost::filesystem::create_directory(tmp_dir.path + "/meta");
+  Json::Value config;
+  config["apk_dir"] = tmp_dir.path;
+  config["redex"]["passes"].append("InterDexPass");
+  auto& interdex_config = config["InterDexPass"];
+  interdex_config["emit_canaries"] = false;
+  interdex_config["normal_primary_dex"] = true;
+  interdex_config["minimize_cross_dex_refs"] = true;
+  interdex_config["minimize_cross_dex_refs_relocate_static_methods"] = true;
+  interdex_config["max_relocated_methods_per_class"] = 1;
+  interdex_config["reserved_trefs"] =
+      Json::Int64(get_max_type_refs(0) - 1 - kTypeRefsLimit);
+
+  // The plugin registry was created by the registered InterDexPass.
+  interdex::InterDexPass pass(/* register_plugins */ false);
+  PassManager manager({&pass}, config);
+  manager.set_testing_mode();
+  ConfigFiles conf(config, tmp_dir.path);
+  manager.run_passes(stores, conf);
+
+  size_t num_relocated_classes = 0;
+  for (const auto& dex : stores[0].get_dexen()) {
+    std::unordered_set<DexType*> types;
+    for (auto cls : dex) {
+      if (cls->str().find("$Relocated") != std::string::npos) {
+        num_relocated_classes++;
+      }
+      interdex::ClassReferences refs(cls);
+      types.insert(refs.types.begin(), refs.types.end());
+    }
+    EXPECT_LT(types.size(), kTypeRefsLimit);
+  }
+  EXPECT_EQ(num_relocated_classes, kNumCallees);
+}
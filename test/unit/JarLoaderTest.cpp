@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+#include "DexClass.h"
+#include "JarLoader.h"
+#include "RedexContext.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+namespace {
+
+struct Member {
+  std::string name;
+  std::string desc;
+};
+
+struct ClassFile {
+  // The internal name, e.g. "com/foo/Bar".
+  std::string name;
+  std::vector<Member> fields;
+  std::vector<Member> methods;
+};
+
+void put16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back(v >> 8);
+  out.push_back(v & 0xff);
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+  put16(out, v >> 16);
+  put16(out, v & 0xffff);
+}
+
+// Little-endian, as used by the zip format.
+void put_le(std::vector<uint8_t>& out, uint32_t v, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) {
+    out.push_back((v >> (8 * i)) & 0xff);
+  }
+}
+
+std::vector<uint8_t> make_class_file(const ClassFile& cls) {
+  std::vector<std::string> utf8s;
+  auto utf8 = [&](const std::string& str) -> uint16_t {
+    utf8s.push_back(str);
+    // Each class name takes a UTF-8 entry and a class entry.
+    return utf8s.size() * 2 - 1;
+  };
+  auto self = utf8(cls.name);
+  auto super = utf8("java/lang/Object");
+  std::vector<std::pair<uint16_t, uint16_t>> fields, methods;
+  for (const auto& field : cls.fields) {
+    fields.emplace_back(utf8(field.name), utf8(field.desc));
+  }
+  for (const auto& method : cls.methods) {
+    methods.emplace_back(utf8(method.name), utf8(method.desc));
+  }
+
+  std::vector<uint8_t> out;
+  put32(out, 0xcafebabe);
+  put16(out, 0);
+  put16(out, 50);
+  put16(out, utf8s.size() * 2 + 1);
+  for (size_t i = 0; i < utf8s.size(); i++) {
+    out.push_back(1); // CONSTANT_Utf8
+    put16(out, utf8s[i].size());
+    out.insert(out.end(), utf8s[i].begin(), utf8s[i].end());
+    out.push_back(7); // CONSTANT_Class
+    put16(out, i * 2 + 1);
+  }
+  put16(out, 0x0021); // public super
+  put16(out, self + 1);
+  put16(out, super + 1);
+  put16(out, 0); // interfaces
+  for (const auto* members : {&fields, &methods}) {
+    put16(out, members->size());
+    for (const auto& member : *members) {
+      put16(out, 0x0001); // public
+      put16(out, member.first);
+      put16(out, member.second);
+      put16(out, 0); // attributes
+    }
+  }
+  put16(out, 0); // attributes
+  return out;
+}
+
+std::vector<uint8_t> deflate_raw(const std::vector<uint8_t>& in) {
+  z_stream stream{};
+  deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+               Z_DEFAULT_STRATEGY);
+  std::vector<uint8_t> out(deflateBound(&stream, in.size()));
+  stream.next_in = const_cast<Bytef*>(in.data());
+  stream.avail_in = in.size();
+  stream.next_out = out.data();
+  stream.avail_out = out.size();
+  deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+// Writes a jar with one entry per class, in order.
+void write_jar(const std::string& path, const std::vector<ClassFile>& classes) {
+  std::vector<uint8_t> out, cdir;
+  for (size_t i = 0; i < classes.size(); i++) {
+    auto name = classes[i].name + "_" + std::to_string(i) + ".class";
+    auto data = make_class_file(classes[i]);
+    auto compressed = deflate_raw(data);
+    uint32_t crc = crc32(0, data.data(), data.size());
+    uint32_t offset = out.size();
+
+    put_le(out, 0x04034b50, 4);
+    put_le(out, 20, 2); // version needed
+    put_le(out, 0, 2); // flags
+    put_le(out, 8, 2); // deflate
+    put_le(out, 0, 4); // time and date
+    put_le(out, crc, 4);
+    put_le(out, compressed.size(), 4);
+    put_le(out, data.size(), 4);
+    put_le(out, name.size(), 2);
+    put_le(out, 0, 2); // extra
+    out.insert(out.end(), name.begin(), name.end());
+    out.insert(out.end(), compressed.begin(), compressed.end());
+
+    put_le(cdir, 0x02014b50, 4);
+    put_le(cdir, 20, 2); // version made by
+    put_le(cdir, 20, 2); // version needed
+    put_le(cdir, 0, 2); // flags
+    put_le(cdir, 8, 2); // deflate
+    put_le(cdir, 0, 4); // time and date
+    put_le(cdir, crc, 4);
+    put_le(cdir, compressed.size(), 4);
+    put_le(cdir, data.size(), 4);
+    put_le(cdir, name.size(), 2);
+    put_le(cdir, 0, 2); // extra
+    put_le(cdir, 0, 2); // comment
+    put_le(cdir, 0, 2); // disk
+    put_le(cdir, 0, 2); // internal attributes
+    put_le(cdir, 0, 4); // external attributes
+    put_le(cdir, offset, 4);
+    cdir.insert(cdir.end(), name.begin(), name.end());
+  }
+  uint32_t cdir_offset = out.size();
+  out.insert(out.end(), cdir.begin(), cdir.end());
+  put_le(out, 0x06054b50, 4);
+  put_le(out, 0, 2); // disk
+  put_le(out, 0, 2); // disk with the central directory
+  put_le(out, classes.size(), 2);
+  put_le(out, classes.size(), 2);
+  put_le(out, cdir.size(), 4);
+  put_le(out, cdir_offset, 4);
+  put_le(out, 0, 2); // comment
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(out.data()), out.size());
+}
+
+// Describes the classes and their members, for comparisons across contexts.
+std::string describe(const Scope& scope) {
+  std::ostringstream out;
+  for (const DexClass* cls : scope) {
+    out << show(cls) << " : " << show(cls->get_super_class()) << "\n";
+    for (auto field : cls->get_all_fields()) {
+      out << "  " << show(field) << " " << field->get_access() << "\n";
+    }
+    for (auto method : cls->get_all_methods()) {
+      out << "  " << show(method) << " " << method->get_access() << "\n";
+    }
+  }
+  return out.str();
+}
+
+std::vector<std::string> list_dir(const std::string& dir) {
+  std::vector<std::string> files;
+  for (const auto& entry : boost::filesystem::directory_iterator(dir)) {
+    files.push_back(entry.path().string());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+} // namespace
+
+class JarLoaderTest : public RedexTest {
+ public:
+  std::string tmp_path(const std::string& name) const {
+    return m_tmp_dir.path + "/" + name;
+  }
+
+  // Loads the jar into a fresh context, through the cache.
+  std::string load_cached(const std::string& jar) {
+    delete g_redex;
+    g_redex = new RedexContext();
+    Scope scope;
+    EXPECT_TRUE(
+        load_jar_file(jar.c_str(), &scope, nullptr, tmp_path("cache")));
+    return describe(scope);
+  }
+
+ private:
+  redex::TempDir m_tmp_dir = redex::make_tmp_dir("redex_jar_loader_%%%%%%%%");
+};
+
+// Class files are parsed in parallel batches, but must be defined in jar
+// order, so that the first definition of a class wins, within a batch and
+// across batches.
+TEST_F(JarLoaderTest, duplicatesAcrossBatches) {
+  std::vector<ClassFile> classes;
+  classes.push_back({"Dup", {{"first", "I"}}, {}});
+  classes.push_back({"Dup", {{"second", "I"}}, {}});
+  for (size_t i = 0; i < 2500; i++) {
+    classes.push_back({"Foo" + std::to_string(i),
+                       {{"f", "I"}},
+                       {{"m", "(ILjava/lang/String;)V"}}});
+  }
+  classes.push_back({"Dup", {{"third", "I"}}, {}});
+  auto jar = tmp_path("classes.jar");
+  write_jar(jar, classes);
+
+  Scope scope;
+  ASSERT_TRUE(load_jar_file(jar.c_str(), &scope));
+  ASSERT_EQ(scope.size(), 2501);
+  for (size_t i = 0; i < 2500; i++) {
+    // Classes from jars are external, so only their const members are
+    // accessible.
+    const DexClass* cls = scope[i + 1];
+    EXPECT_EQ(cls->get_name()->str(), "LFoo" + std::to_string(i) + ";");
+    ASSERT_EQ(cls->get_ifields().size(), 1);
+    ASSERT_EQ(cls->get_vmethods().size(), 1);
+    EXPECT_EQ(show(cls->get_vmethods()[0]->get_proto()),
+              "(ILjava/lang/String;)V");
+  }
+  const DexClass* dup = type_class(DexType::get_type("LDup;"));
+  ASSERT_NE(dup, nullptr);
+  ASSERT_EQ(dup->get_ifields().size(), 1);
+  EXPECT_EQ(dup->get_ifields()[0]->get_name()->str(), "first");
+}
+
+// Members of duplicate classes are not parsed, so that they can't fail the
+// load, and don't intern anything.
+TEST_F(JarLoaderTest, malformedDuplicateIsIgnored) {
+  auto jar = tmp_path("classes.jar");
+  write_jar(jar, {{"Bar", {{"f", "I"}}, {}},
+                  {"Bar", {}, {{"unseenMethodName", "(V)V"}}}});
+
+  Scope scope;
+  ASSERT_TRUE(load_jar_file(jar.c_str(), &scope));
+  ASSERT_EQ(scope.size(), 1);
+  const DexClass* bar = scope[0];
+  EXPECT_EQ(bar->get_ifields().size(), 1);
+  EXPECT_EQ(DexString::get_string("unseenMethodName"), nullptr);
+
+  // A malformed class that isn't a duplicate still fails the load.
+  auto bad_jar = tmp_path("bad.jar");
+  write_jar(bad_jar, {{"Baz", {}, {{"m", "(V)V"}}}});
+  EXPECT_FALSE(load_jar_file(bad_jar.c_str(), &scope));
+}
+
+TEST_F(JarLoaderTest, cacheRoundTrip) {
+  auto jar = tmp_path("classes.jar");
+  write_jar(jar, {{"Foo", {{"f", "I"}}, {{"m", "(ILjava/lang/String;)V"}}},
+                  {"Bar", {{"g", "LFoo;"}, {"h", "[J"}}, {}}});
+
+  Scope scope;
+  ASSERT_TRUE(load_jar_file(jar.c_str(), &scope));
+  auto expected = describe(scope);
+
+  // The first load writes the cache, the second one reads it back.
+  EXPECT_EQ(load_cached(jar), expected);
+  auto cache_files = list_dir(tmp_path("cache"));
+  ASSERT_EQ(cache_files.size(), 1);
+  EXPECT_EQ(boost::filesystem::path(cache_files[0]).extension(), ".jarcache");
+  boost::filesystem::last_write_time(cache_files[0], 0);
+  EXPECT_EQ(load_cached(jar), expected);
+  EXPECT_EQ(boost::filesystem::last_write_time(cache_files[0]), 0);
+}
+
+// A cache file that can't be read is ignored, and replaced.
+TEST_F(JarLoaderTest, corruptedCache) {
+  auto jar = tmp_path("classes.jar");
+  write_jar(jar, {{"Foo", {{"f", "I"}}, {{"m", "(ILjava/lang/String;)V"}}},
+                  {"Bar", {{"g", "LFoo;"}}, {}}});
+  auto expected = load_cached(jar);
+  auto cache_files = list_dir(tmp_path("cache"));
+  ASSERT_EQ(cache_files.size(), 1);
+  auto cache_file = cache_files[0];
+  auto cache_size = boost::filesystem::file_size(cache_file);
+
+  boost::filesystem::resize_file(cache_file, cache_size / 2);
+  EXPECT_EQ(load_cached(jar), expected);
+  EXPECT_EQ(boost::filesystem::file_size(cache_file), cache_size);
+
+  // Garble the end of the class data, which refers to strings by index.
+  {
+    std::fstream file(cache_file,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(cache_size - 16);
+    std::string garbage(16, '\xff');
+    file.write(garbage.data(), garbage.size());
+  }
+  EXPECT_EQ(load_cached(jar), expected);
+}
+
+// A cache file for a jar with different contents, even of the same size,
+// must not be used.
+TEST_F(JarLoaderTest, changedJar) {
+  auto jar = tmp_path("classes.jar");
+  write_jar(jar, {{"Foo", {{"a", "I"}}, {}}});
+  auto old_size = boost::filesystem::file_size(jar);
+  auto old_classes = load_cached(jar);
+  auto old_cache_files = list_dir(tmp_path("cache"));
+  ASSERT_EQ(old_cache_files.size(), 1);
+
+  write_jar(jar, {{"Foo", {{"b", "I"}}, {}}});
+  ASSERT_EQ(boost::filesystem::file_size(jar), old_size);
+  auto new_classes = load_cached(jar);
+  EXPECT_NE(new_classes.find("LFoo;.b:I"), std::string::npos);
+  EXPECT_EQ(new_classes.find("LFoo;.a:I"), std::string::npos);
+  auto cache_files = list_dir(tmp_path("cache"));
+  ASSERT_EQ(cache_files.size(), 2);
+
+  // Even a stale cache file under the new jar's name is rejected.
+  for (const auto& cache_file : cache_files) {
+    if (cache_file != old_cache_files[0]) {
+      boost::filesystem::copy_file(
+          old_cache_files[0], cache_file,
+          boost::filesystem::copy_option::overwrite_if_exists);
+    }
+  }
+  EXPECT_EQ(load_cached(jar), new_classes);
+}
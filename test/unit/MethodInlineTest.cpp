@@ -594,3 +594,112 @@ TEST_F(MethodInlineTest,
   auto expected = assembler::ircode_from_string(expected_str);
   EXPECT_CODE_EQ(expected.get(), actual);
 }
+
+TEST_F(MethodInlineTest, bounded_concurrent_shrinking) {
+  MethodRefCache resolve_cache;
+  auto resolver = [&resolve_cache](DexMethodRef* method, MethodSearch search) {
+    return resolve_method(method, search, resolve_cache);
+  };
+
+  bool intra_dex = false;
+
+  DexStoresVector stores;
+  std::unordered_set<DexMethod*> candidates;
+  std::unordered_set<DexMethod*> expected_inlined;
+  auto foo_cls = create_a_class("Lfoo;");
+  {
+    DexStore store("root");
+    store.add_classes({});
+    store.add_classes({foo_cls});
+    stores.push_back(std::move(store));
+  }
+  // More distinct callees than shrinking slots, so that callees and the
+  // caller have to queue up for shrinking.
+  const size_t max_concurrent_shrinking = 2;
+  const size_t num_callees = 8;
+  std::vector<DexMethod*> callees;
+  DexMethod* foo_main;
+  {
+    create_runtime_exception_init();
+    std::vector<std::pair<DexMethod*, int32_t>> calls;
+    for (size_t i = 0; i < num_callees; i++) {
+      auto name = "check" + std::to_string(i);
+      auto check_method = make_precondition_method(foo_cls, name.c_str());
+      callees.push_back(check_method);
+      candidates.insert(check_method);
+      expected_inlined.insert(check_method);
+      calls.emplace_back(check_method, 1);
+      calls.emplace_back(check_method, 1);
+    }
+    // foo_main calls each check method twice.
+    foo_main = make_a_method_calls_others_with_arg(foo_cls, "foo_main", calls);
+  }
+  auto scope = build_class_scope(stores);
+  api::LevelChecker::init(0, scope);
+  inliner::InlinerConfig inliner_config;
+  inliner_config.populate(scope);
+  inliner_config.use_cfg_inliner = true;
+  inliner_config.throws_inline = true;
+  inliner_config.run_const_prop = true;
+  inliner_config.run_local_dce = true;
+  inliner_config.max_concurrent_shrinking = max_concurrent_shrinking;
+  for (auto callee : callees) {
+    callee->get_code()->build_cfg(true);
+  }
+  foo_main->get_code()->build_cfg(true);
+  MultiMethodInliner inliner(scope,
+                             stores,
+                             candidates,
+                             resolver,
+                             inliner_config,
+                             intra_dex ? IntraDex : InterDex);
+  inliner.inline_methods();
+  auto inlined = inliner.get_inlined();
+  EXPECT_EQ(inlined.size(), expected_inlined.size());
+  for (auto method : expected_inlined) {
+    EXPECT_EQ(inlined.count(method), 1);
+  }
+  // More methods got shrunk than there are slots, but never more than the
+  // bound at the same time.
+  EXPECT_GT(inliner.get_methods_shrunk(), max_concurrent_shrinking);
+  EXPECT_GT(inliner.get_info().peak_live_shrinking, 0);
+  EXPECT_LE(inliner.get_info().peak_live_shrinking, max_concurrent_shrinking);
+
+  const auto& expected_str = R"(
+    (
+      (.pos:dbg_0 "Lfoo;.foo_main:()V" UnknownSource 0)
+      (return-void)
+    )
+  )";
+  foo_main->get_code()->clear_cfg();
+  auto actual = foo_main->get_code();
+  auto expected = assembler::ircode_from_string(expected_str);
+  EXPECT_CODE_EQ(expected.get(), actual);
+}
+
+TEST_F(MethodInlineTest, summary_cache_invalidated_by_code_change) {
+  auto foo_cls = create_a_class("Lfoo;");
+  auto method = make_a_method(foo_cls, "bar", 1);
+  method->get_code()->build_cfg(true);
+
+  auto version = inliner::SummaryCache::get_code_version(method);
+  EXPECT_EQ(version, inliner::SummaryCache::get_code_version(method));
+
+  auto& summary_cache = inliner::SummaryCache::get();
+  summary_cache.set_callee_cost(method, version, boost::none, {3, 0});
+  auto cached = summary_cache.get_callee_cost(method, version, boost::none);
+  ASSERT_TRUE(cached);
+  EXPECT_EQ(cached->cost, 3);
+  EXPECT_FALSE(summary_cache.get_callee_cost(method, version,
+                                             std::string("0:1")));
+
+  for (auto& mie : cfg::InstructionIterable(method->get_code()->cfg())) {
+    if (mie.insn->opcode() == OPCODE_CONST) {
+      mie.insn->set_literal(2);
+    }
+  }
+  auto new_version = inliner::SummaryCache::get_code_version(method);
+  EXPECT_NE(version, new_version);
+  EXPECT_FALSE(summary_cache.get_callee_cost(method, new_version, boost::none));
+  method->get_code()->clear_cfg();
+}
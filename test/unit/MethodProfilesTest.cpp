@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodProfiles.h"
+
+#include <fstream>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+using namespace method_profiles;
+using ::testing::HasSubstr;
+
+namespace {
+
+// Enough lines to span several of the chunks that get parsed in parallel.
+constexpr size_t kNumPaddingLines = 100000;
+
+std::string make_line(const std::string& name, const std::string& appear100) {
+  return "0," + name + "," + appear100 + ",1,1.0,1,50.0,21";
+}
+
+// Writes a stats file with the given main section lines, each followed by
+// padding lines for LFoo;.a:()V, which are dropped as that method comes
+// first.
+std::string write_profile(const redex::TempDir& tmp_dir,
+                          const std::vector<std::string>& lines) {
+  auto path = tmp_dir.path + "/method_stats.csv";
+  std::ofstream ofs(path);
+  ofs << "index,name,appear100,appear#,avg_call,avg_order,avg_rank100,"
+         "min_api_level\n";
+  ofs << make_line("LFoo;.a:()V", "10.0") << "\n";
+  for (const auto& line : lines) {
+    ofs << line << "\n";
+    for (size_t i = 0; i < kNumPaddingLines; ++i) {
+      ofs << make_line("LFoo;.a:()V", "20.0") << "\n";
+    }
+  }
+  return path;
+}
+
+} // namespace
+
+class MethodProfilesTest : public RedexTest {
+ public:
+  MethodProfilesTest() {
+    m_a = DexMethod::make_method("LFoo;.a:()V");
+    m_b = DexMethod::make_method("LFoo;.b:()V");
+    m_c = DexMethod::make_method("LFoo;.c:()V");
+  }
+
+ protected:
+  redex::TempDir m_tmp_dir =
+      redex::make_tmp_dir("redex_method_profiles_test_%%%%%%%%");
+  DexMethodRef* m_a;
+  DexMethodRef* m_b;
+  DexMethodRef* m_c;
+};
+
+TEST_F(MethodProfilesTest, firstEntryWins) {
+  auto path = write_profile(m_tmp_dir, {make_line("LFoo;.b:()V", "30.0"),
+                                        make_line("LFoo;.b:()V", "40.0"),
+                                        make_line("LBar;.d:()V", "50.0")});
+  MethodProfiles profiles;
+  profiles.initialize({path});
+  EXPECT_EQ(profiles.size(), 2);
+  EXPECT_EQ(profiles.get_method_stat("", m_a)->appear_percent, 10.0);
+  EXPECT_EQ(profiles.get_method_stat("", m_b)->appear_percent, 30.0);
+  EXPECT_EQ(profiles.unresolved_size(), 1);
+
+  // The method may only come into existence later, e.g. after a rename.
+  auto d = DexMethod::make_method("LBar;.d:()V");
+  profiles.process_unresolved_lines();
+  EXPECT_EQ(profiles.size(), 3);
+  EXPECT_EQ(profiles.get_method_stat("", d)->appear_percent, 50.0);
+  EXPECT_EQ(profiles.unresolved_size(), 0);
+}
+
+TEST_F(MethodProfilesTest, stopsAtFirstBadLine) {
+  // The line with an unknown extra column fails to parse, so the lines after
+  // it are ignored, even in later chunks.
+  auto path = write_profile(m_tmp_dir, {make_line("LFoo;.b:()V", "30.0"),
+                                        make_line("LFoo;.b:()V", "30.0") + ",x",
+                                        make_line("LFoo;.c:()V", "40.0")});
+  MethodProfiles profiles;
+  profiles.initialize({path});
+  EXPECT_EQ(profiles.size(), 2);
+  EXPECT_TRUE(profiles.get_method_stat("", m_b));
+  EXPECT_FALSE(profiles.get_method_stat("", m_c));
+}
+
+TEST_F(MethodProfilesTest, throwsOnFirstMalformedCell) {
+  // A malformed cell raises an exception, however the chunks get distributed
+  // across threads. The lines before it have been added by then.
+  auto path = write_profile(m_tmp_dir, {make_line("LFoo;.b:()V", "30.0"),
+                                        make_line("LFoo;.c:()V", "bad1"),
+                                        make_line("LFoo;.c:()V", "bad2")});
+  MethodProfiles profiles;
+  try {
+    profiles.initialize({path});
+    FAIL() << "Expected a RedexException";
+  } catch (const RedexException& e) {
+    EXPECT_THAT(e.what(), HasSubstr("bad1"));
+  }
+  EXPECT_EQ(profiles.size(), 2);
+  EXPECT_TRUE(profiles.get_method_stat("", m_b));
+  EXPECT_FALSE(profiles.get_method_stat("", m_c));
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "Pass.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+
+namespace {
+
+class NoOpPass : public Pass {
+ public:
+  NoOpPass() : Pass("NoOpPass") {}
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override {}
+};
+
+// Changes the proto of a method ref in place, keeping the ref itself.
+class ChangeProtoPass : public Pass {
+ public:
+  ChangeProtoPass(const std::string& name,
+                  DexMethodRef* method,
+                  DexProto* proto)
+      : Pass(name), m_method(method), m_proto(proto) {}
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override {
+    m_method->change(DexMethodSpec(nullptr, nullptr, m_proto),
+                     /* rename_on_collision */ false);
+  }
+
+ private:
+  DexMethodRef* m_method;
+  DexProto* m_proto;
+};
+
+} // namespace
+
+class PassManagerTypeCheckerTest : public RedexTest {};
+
+// A pass that changes a callee's proto in place, without touching the code of
+// its callers, must still cause the callers to be re-checked.
+TEST_F(PassManagerTypeCheckerTest, recheckAfterInPlaceRefChange) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+
+  auto callee = DexMethod::make_method("LBar;.bar:(I)V");
+  auto int_proto = callee->get_proto();
+  auto object_proto = DexProto::make_proto(
+      type::_void(), DexTypeList::make_type_list({type::java_lang_Object()}));
+
+  ClassCreator creator(DexType::make_type("LFoo;"));
+  creator.set_super(type::java_lang_Object());
+  auto method = DexMethod::make_method("LFoo;.foo:()V")
+                    ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 1)
+      (invoke-static (v0) "LBar;.bar:(I)V")
+      (return-void)
+    )
+  )"));
+  creator.add_method(method);
+  DexStore store("classes");
+  store.add_classes({creator.create()});
+  DexStoresVector stores;
+  stores.emplace_back(std::move(store));
+
+  // The first pass lets the type checker remember foo as checked. The second
+  // one makes foo ill-typed, as it now passes an int where an object is
+  // expected. The third one restores the proto, so that only the type
+  // checker run after the second pass can catch the error.
+  NoOpPass no_op_pass;
+  ChangeProtoPass break_pass("BreakProtoPass", callee, object_proto);
+  ChangeProtoPass restore_pass("RestoreProtoPass", callee, int_proto);
+  PassManager manager({&no_op_pass, &break_pass, &restore_pass});
+  ConfigFiles config(Json::nullValue);
+  EXPECT_EXIT(manager.run_passes(stores, config),
+              ::testing::ExitedWithCode(EXIT_FAILURE),
+              "Inconsistency found in Dex code for LFoo;.foo:\\(\\)V");
+}
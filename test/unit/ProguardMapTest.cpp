@@ -15,6 +15,7 @@
 #include "RedexTest.h"
 
 using ::testing::AllOf;
+using ::testing::HasSubstr;
 using ::testing::Pointee;
 using ::testing::SizeIs;
 using ::testing::UnorderedElementsAre;
@@ -341,3 +342,51 @@ TEST_F(ProguardMapTest, DeobfuscateFramesWithoutLineRange) {
 
   EXPECT_CODE_EQ(code.get(), expected_code.get());
 }
+
+TEST_F(ProguardMapTest, MembersSpanningChunks) {
+  // Large enough to be parsed in several chunks, with the members of the last
+  // class far away from its header, and types referring to later classes.
+  std::ostringstream map;
+  map << "com.foo.Big -> A:\n";
+  for (size_t i = 0; i < 100000; ++i) {
+    map << "    com.foo.Later f" << i << " -> f" << i << "\n";
+  }
+  for (size_t i = 0; i < 10000; ++i) {
+    map << "    " << i << ":" << i << ":void m() -> m\n";
+  }
+  map << "com.foo.Later -> B:\n";
+  std::stringstream ss(map.str());
+  ProguardMap pm(ss);
+  EXPECT_EQ("LA;.f0:LB;",
+            pm.translate_field("Lcom/foo/Big;.f0:Lcom/foo/Later;"));
+  EXPECT_EQ("LA;.f99999:LB;",
+            pm.translate_field("Lcom/foo/Big;.f99999:Lcom/foo/Later;"));
+  EXPECT_EQ("LA;.m:()V", pm.translate_method("Lcom/foo/Big;.m:()V"));
+  const auto& lines = pm.method_lines("LA;.m:()V");
+  ASSERT_THAT(lines, SizeIs(10000));
+  for (size_t i = 0; i < lines.size(); ++i) {
+    EXPECT_EQ(i, lines[i]->start);
+  }
+  EXPECT_EQ("LB;", pm.translate_class("Lcom/foo/Later;"));
+}
+
+TEST_F(ProguardMapTest, BogusLinesSpanningChunks) {
+  // The first bogus line in file order gets reported, however the chunks get
+  // distributed across threads.
+  std::ostringstream map;
+  map << "com.foo.Big -> A:\n";
+  for (size_t i = 0; i < 100000; ++i) {
+    map << "    int f" << i << " -> f" << i << "\n";
+    if (i == 50000) {
+      map << "first bogus line\n";
+    }
+  }
+  map << "second bogus line\n";
+  std::stringstream ss(map.str());
+  try {
+    ProguardMap pm(ss);
+    FAIL() << "Expected a RedexException";
+  } catch (const RedexException& e) {
+    EXPECT_THAT(e.what(), HasSubstr("first bogus line"));
+  }
+}
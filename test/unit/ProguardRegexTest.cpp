@@ -270,3 +270,62 @@ TEST(ProguardRegexTest, types) {
     EXPECT_EQ("Lalpha/**/beta;", descriptor);
   }
 }
+
+TEST(ProguardRegexTest, class_name_pattern_matcher) {
+  std::vector<std::string> patterns = {
+      "Lcom/facebook/Alpha;",   "Lcom/facebook/*;",     "Lcom/facebook/**;",
+      "L*;",                    "L**;",                 "Lcom/*/Alpha;",
+      "Lcom/**/Alpha;",         "Lcom/facebook/A?pha;", "Lcom/**$*;",
+      "L**Alpha*;",             "Lcom/*/*/*;",          "Lcom/facebook/**/*;",
+      "[Lcom/facebook/*;",      "Lcom/facebook/***;",   "Lcom/facebook/.*;",
+      "Lcom/fac*book/**Beta;",  "Lcom/facebook/Alph;",  "L?*/**;",
+  };
+  std::vector<std::string> names = {
+      "Lcom/facebook/Alpha;",
+      "Lcom/facebook/Alpha$Inner;",
+      "Lcom/facebook/redex/Alpha;",
+      "Lcom/facebook/redex/Beta;",
+      "Lcom/facebook/Aapha;",
+      "Lcom/facebook/A/pha;",
+      "Lcom/Alpha;",
+      "Lcom/x/Alpha;",
+      "Lcom/x/y/z;",
+      "Lcom/x/y/z/w;",
+      "Lcom/fac/book/Beta;",
+      "Lcom/facebook;",
+      "[Lcom/facebook/Alpha;",
+      "LAlpha;",
+      "I",
+      "",
+  };
+  for (const auto& pattern : patterns) {
+    proguard_parser::ClassNamePatternMatcher matcher(pattern);
+    boost::regex rx(proguard_parser::form_type_regex(pattern));
+    for (const auto& name : names) {
+      EXPECT_EQ(boost::regex_match(name, rx), matcher.match(name))
+          << pattern << " vs. " << name;
+      if (matcher.match(name)) {
+        EXPECT_EQ(0, name.compare(0, matcher.literal_prefix().size(),
+                                  matcher.literal_prefix()));
+      }
+    }
+  }
+
+  {
+    proguard_parser::ClassNamePatternMatcher matcher("Lcom/facebook/**;");
+    EXPECT_TRUE(matcher.is_compiled());
+    EXPECT_EQ("Lcom/facebook/", matcher.literal_prefix());
+  }
+  {
+    proguard_parser::ClassNamePatternMatcher matcher("L*;");
+    EXPECT_TRUE(matcher.is_compiled());
+    EXPECT_EQ("L", matcher.literal_prefix());
+    EXPECT_TRUE(matcher.match("Lcom/facebook/Alpha;"));
+  }
+  {
+    // Patterns that need more than simple wildcards use a regex.
+    proguard_parser::ClassNamePatternMatcher matcher("Lcom/facebook/***;");
+    EXPECT_FALSE(matcher.is_compiled());
+    EXPECT_EQ("", matcher.literal_prefix());
+  }
+}
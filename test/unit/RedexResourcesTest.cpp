@@ -46,3 +46,37 @@ TEST(RedexResources, ReadXmlTagsAndAttributes) {
   auto no_ns_vals = multimap_values_to_set(attribute_values, "onClick");
   EXPECT_EQ(no_ns_vals.size(), 0);
 }
+
+TEST(RedexResources, GetResourcesByNamePrefix) {
+  std::map<std::string, std::vector<uint32_t>> name_to_ids = {
+      {"a", {1}},         {"abc", {2, 3}}, {"abd", {4}},
+      {"ab_suffix", {5}}, {"b", {6}},      {"ba", {7}},
+  };
+  EXPECT_EQ(get_resources_by_name_prefix({"ab"}, name_to_ids),
+            std::unordered_set<uint32_t>({2, 3, 4, 5}));
+  EXPECT_EQ(get_resources_by_name_prefix({"a", "ba"}, name_to_ids),
+            std::unordered_set<uint32_t>({1, 2, 3, 4, 5, 7}));
+  EXPECT_EQ(get_resources_by_name_prefix({"abc", "abc"}, name_to_ids),
+            std::unordered_set<uint32_t>({2, 3}));
+  EXPECT_EQ(get_resources_by_name_prefix({""}, name_to_ids),
+            std::unordered_set<uint32_t>({1, 2, 3, 4, 5, 6, 7}));
+  EXPECT_TRUE(get_resources_by_name_prefix({"c", "abe"}, name_to_ids).empty());
+}
+
+TEST(RedexResources, GetGlobalStrings) {
+  ResourcesArscFile arsc_file(std::getenv("test_arsc_path"));
+  const auto& global_strings = arsc_file.get_global_strings();
+  ASSERT_EQ(global_strings.size(), 1);
+  ASSERT_TRUE(global_strings[0]);
+  EXPECT_EQ(*global_strings[0], "Hello, world");
+  // Later calls return the same cached strings.
+  EXPECT_EQ(&arsc_file.get_global_strings(), &global_strings);
+
+  EXPECT_EQ(arsc_file.get_resource_strings_by_name("a_string"),
+            std::vector<std::string>({"Hello, world"}));
+  EXPECT_TRUE(arsc_file.get_resource_strings_by_name("no_such_name").empty());
+
+  EXPECT_EQ(get_resources_by_name_prefix({"test_"}, arsc_file.name_to_ids)
+                .size(),
+            2);
+}
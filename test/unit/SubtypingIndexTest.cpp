@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+#include "SubtypingIndex.h"
+#include "TypeUtil.h"
+
+/**
+ * interface I1 {}
+ * interface I2 extends I1 {}
+ * interface I3 {}
+ * class A {}
+ *   class B extends A implements I2 {}
+ *     class C extends B {}
+ *     class D extends B implements I3 {}
+ *   class E extends A {}
+ * // external unknown type
+ * class Odd1 extends Odd implements I3 {}
+ *   class Odd2 extends Odd1 {}
+ */
+class SubtypingIndexTest : public RedexTest {
+ protected:
+  void SetUp() override {
+    auto const intf_flag = ACC_PUBLIC | ACC_INTERFACE;
+    m_scope = create_empty_scope();
+    auto obj_t = type::java_lang_Object();
+
+    auto i1_t = DexType::make_type("LI1;");
+    m_scope.push_back(create_internal_class(i1_t, obj_t, {}, intf_flag));
+    auto i2_t = DexType::make_type("LI2;");
+    m_scope.push_back(create_internal_class(i2_t, obj_t, {i1_t}, intf_flag));
+    auto i3_t = DexType::make_type("LI3;");
+    m_scope.push_back(create_internal_class(i3_t, obj_t, {}, intf_flag));
+
+    auto a_t = DexType::make_type("LA;");
+    m_scope.push_back(create_internal_class(a_t, obj_t, {}));
+    auto b_t = DexType::make_type("LB;");
+    m_scope.push_back(create_internal_class(b_t, a_t, {i2_t}));
+    auto c_t = DexType::make_type("LC;");
+    m_scope.push_back(create_internal_class(c_t, b_t, {}));
+    auto d_t = DexType::make_type("LD;");
+    m_scope.push_back(create_internal_class(d_t, b_t, {i3_t}));
+    auto e_t = DexType::make_type("LE;");
+    m_scope.push_back(create_internal_class(e_t, a_t, {}));
+
+    auto odd_t = DexType::make_type("LOdd;");
+    auto odd1_t = DexType::make_type("LOdd1;");
+    m_scope.push_back(create_internal_class(odd1_t, odd_t, {i3_t}));
+    auto odd2_t = DexType::make_type("LOdd2;");
+    m_scope.push_back(create_internal_class(odd2_t, odd1_t, {}));
+
+    m_types = {obj_t, i1_t, i2_t, i3_t, a_t,    b_t,
+               c_t,   d_t,  e_t,  odd_t, odd1_t, odd2_t};
+  }
+
+  Scope m_scope;
+  std::vector<DexType*> m_types;
+};
+
+TEST_F(SubtypingIndexTest, check_cast_agrees_with_type_util) {
+  SubtypingIndex index(m_scope);
+  for (auto type : m_types) {
+    for (auto base_type : m_types) {
+      auto res = index.check_cast(type, base_type);
+      ASSERT_TRUE(res) << show(type) << " -> " << show(base_type);
+      EXPECT_EQ(*res, type::check_cast(type, base_type))
+          << show(type) << " -> " << show(base_type);
+    }
+  }
+}
+
+TEST_F(SubtypingIndexTest, is_subclass) {
+  SubtypingIndex index(m_scope);
+  auto a_t = DexType::get_type("LA;");
+  auto c_t = DexType::get_type("LC;");
+  auto e_t = DexType::get_type("LE;");
+  auto odd_t = DexType::get_type("LOdd;");
+  auto odd2_t = DexType::get_type("LOdd2;");
+  EXPECT_TRUE(index.is_subclass(a_t, a_t));
+  EXPECT_TRUE(index.is_subclass(a_t, c_t));
+  EXPECT_TRUE(index.is_subclass(type::java_lang_Object(), e_t));
+  EXPECT_FALSE(index.is_subclass(c_t, a_t));
+  EXPECT_FALSE(index.is_subclass(e_t, c_t));
+  EXPECT_TRUE(index.is_subclass(odd_t, odd2_t));
+  EXPECT_FALSE(index.is_subclass(type::java_lang_Object(), odd2_t));
+  // Interfaces are not part of the class trees.
+  EXPECT_FALSE(index.is_subclass(DexType::get_type("LI1;"), c_t));
+}
+
+TEST_F(SubtypingIndexTest, unindexed_types) {
+  SubtypingIndex index(m_scope);
+  auto a_array_t = DexType::make_type("[LA;");
+  EXPECT_FALSE(index.check_cast(a_array_t, type::java_lang_Object()));
+  EXPECT_FALSE(index.check_cast(DexType::make_type("LUnknown;"),
+                                type::java_lang_Object()));
+  // Unknown base types are fine, as long as the type itself is indexed.
+  auto res = index.check_cast(DexType::get_type("LC;"), a_array_t);
+  ASSERT_TRUE(res);
+  EXPECT_FALSE(*res);
+}
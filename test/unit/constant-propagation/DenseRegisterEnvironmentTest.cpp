@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DenseRegisterEnvironment.h"
+
+#include <gtest/gtest.h>
+#include <random>
+
+#include "ConstantAbstractDomain.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+using Domain = sparta::ConstantAbstractDomain<int>;
+using DenseEnv = DenseRegisterEnvironment<Domain>;
+using PatriciaEnv = sparta::PatriciaTreeMapAbstractEnvironment<reg_t, Domain>;
+
+namespace {
+
+const std::vector<reg_t> kRegs = {0, 1, 2, 5, 31, 63, 64, 100, RESULT_REGISTER};
+
+void expect_same(const DenseEnv& dense, const PatriciaEnv& patricia) {
+  EXPECT_EQ(patricia.is_bottom(), dense.is_bottom());
+  EXPECT_EQ(patricia.is_top(), dense.is_top());
+  for (auto reg : kRegs) {
+    EXPECT_EQ(patricia.get(reg), dense.get(reg)) << "register " << reg;
+  }
+}
+
+} // namespace
+
+TEST(DenseRegisterEnvironmentTest, basicOperations) {
+  DenseEnv env;
+  EXPECT_TRUE(env.is_top());
+  EXPECT_TRUE(env.get(3).is_top());
+
+  env.set(3, Domain(1)).set(RESULT_REGISTER, Domain(2));
+  EXPECT_TRUE(env.is_value());
+  EXPECT_EQ(Domain(1), env.get(3));
+  EXPECT_EQ(Domain(2), env.get(RESULT_REGISTER));
+
+  // Writes to a copy don't affect the original.
+  DenseEnv copy = env;
+  copy.set(3, Domain(4));
+  EXPECT_EQ(Domain(1), env.get(3));
+  EXPECT_EQ(Domain(4), copy.get(3));
+
+  auto joined = env.join(copy);
+  EXPECT_TRUE(joined.get(3).is_top());
+  EXPECT_EQ(Domain(2), joined.get(RESULT_REGISTER));
+
+  auto met = env.meet(copy);
+  EXPECT_TRUE(met.is_bottom());
+
+  env.set(3, Domain::top()).set(RESULT_REGISTER, Domain::top());
+  EXPECT_TRUE(env.is_top());
+  EXPECT_TRUE(env.equals(DenseEnv::top()));
+
+  env.set(0, Domain::bottom());
+  EXPECT_TRUE(env.is_bottom());
+  EXPECT_TRUE(env.get(0).is_bottom());
+}
+
+// Random sequences of operations must give the same results as the
+// equivalent Patricia tree environment.
+TEST(DenseRegisterEnvironmentTest, matchesPatriciaTreeEnvironment) {
+  std::mt19937 gen(0);
+  auto random_env = [&](DenseEnv* dense, PatriciaEnv* patricia) {
+    for (auto reg : kRegs) {
+      switch (gen() % 4) {
+      case 0:
+        continue;
+      case 1:
+        dense->set(reg, Domain::top());
+        patricia->set(reg, Domain::top());
+        break;
+      default: {
+        Domain value(gen() % 3);
+        dense->set(reg, value);
+        patricia->set(reg, value);
+        break;
+      }
+      }
+    }
+  };
+
+  for (size_t i = 0; i < 1000; i++) {
+    DenseEnv d1, d2;
+    PatriciaEnv p1, p2;
+    random_env(&d1, &p1);
+    random_env(&d2, &p2);
+    if (gen() % 8 == 0) {
+      d2 = d1;
+      p2 = p1;
+      random_env(&d2, &p2);
+    }
+    expect_same(d1, p1);
+    expect_same(d2, p2);
+    EXPECT_EQ(p1.leq(p2), d1.leq(d2));
+    EXPECT_EQ(p1.equals(p2), d1.equals(d2));
+
+    expect_same(d1.join(d2), p1.join(p2));
+    expect_same(d1.widening(d2), p1.widening(p2));
+    expect_same(d1.meet(d2), p1.meet(p2));
+    expect_same(d1.narrowing(d2), p1.narrowing(p2));
+    expect_same(d1.join(DenseEnv::bottom()), p1.join(PatriciaEnv::bottom()));
+    expect_same(DenseEnv::bottom().join(d2), PatriciaEnv::bottom().join(p2));
+    expect_same(d1.meet(DenseEnv::top()), p1.meet(PatriciaEnv::top()));
+
+    // The operands must not have been affected by any of the above.
+    expect_same(d1, p1);
+    expect_same(d2, p2);
+  }
+}
@@ -255,35 +255,41 @@ void load_classes_from_dexes_and_metadata(
     std::vector<dex_stats_t>& input_dexes_stats) {
   always_assert_log(!stores.empty(),
                     "Cannot load classes into empty DexStoresVector");
+  // Collect the dex files of all stores first, so that all of them get loaded
+  // at once.
+  std::vector<std::string> dex_paths;
+  std::vector<size_t> dex_store_indices;
+  std::vector<DexStore> new_stores;
   for (const auto& filename : dex_files) {
     if (filename.size() >= 5 &&
         filename.compare(filename.size() - 4, 4, ".dex") == 0) {
-      assert_dex_magic_consistency(stores[0].get_dex_magic(),
-                                   load_dex_magic_from_dex(filename.c_str()));
-      dex_stats_t dex_stats;
-      DexClasses classes = load_classes_from_dex(filename.c_str(), &dex_stats);
-      input_totals += dex_stats;
-      input_dexes_stats.push_back(dex_stats);
-      stores[0].add_classes(std::move(classes));
+      dex_paths.push_back(filename);
+      dex_store_indices.push_back(0);
     } else {
       DexMetadata store_metadata;
       store_metadata.parse(filename);
-      DexStore store(store_metadata);
       for (const auto& file_path : store_metadata.get_files()) {
-        assert_dex_magic_consistency(
-            stores[0].get_dex_magic(),
-            load_dex_magic_from_dex(file_path.c_str()));
-        dex_stats_t dex_stats;
-        DexClasses classes =
-            load_classes_from_dex(file_path.c_str(), &dex_stats);
-
-        input_totals += dex_stats;
-        input_dexes_stats.push_back(dex_stats);
-        store.add_classes(std::move(classes));
+        dex_paths.push_back(file_path);
+        dex_store_indices.push_back(stores.size() + new_stores.size());
       }
-      stores.emplace_back(std::move(store));
+      new_stores.emplace_back(store_metadata);
     }
   }
+  for (const auto& dex_path : dex_paths) {
+    assert_dex_magic_consistency(stores[0].get_dex_magic(),
+                                 load_dex_magic_from_dex(dex_path.c_str()));
+  }
+
+  std::vector<dex_stats_t> dexes_stats;
+  auto dexes_classes = load_classes_from_dexes(dex_paths, &dexes_stats);
+  for (auto& store : new_stores) {
+    stores.emplace_back(std::move(store));
+  }
+  for (size_t i = 0; i < dex_paths.size(); i++) {
+    input_totals += dexes_stats[i];
+    input_dexes_stats.push_back(dexes_stats[i]);
+    stores[dex_store_indices[i]].add_classes(std::move(dexes_classes[i]));
+  }
 }
 
 /**
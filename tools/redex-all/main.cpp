@@ -831,10 +831,13 @@ void redex_frontend(ConfigFiles& conf, /* input */
   args.entry_data["jars"] = Json::arrayValue;
   if (!library_jars.empty()) {
     Timer t("Load library jars");
+    // Parsed library jars can be cached across runs.
+    auto jar_cache_dir = json_config.get("jar_cache_dir", std::string());
 
     for (const auto& library_jar : library_jars) {
       TRACE(MAIN, 1, "LIBRARY JAR: %s", library_jar.c_str());
-      if (!load_jar_file(library_jar.c_str(), &external_classes)) {
+      if (!load_jar_file(library_jar.c_str(), &external_classes,
+                         /* attr_hook */ nullptr, jar_cache_dir)) {
         // Try again with the basedir
         std::string basedir_path = pg_config.basedirectory + "/" + library_jar;
         if (!load_jar_file(basedir_path.c_str())) {